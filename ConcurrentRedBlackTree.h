@@ -0,0 +1,776 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "NodePool.h"
+#include "RedBlackTree.h"
+
+#ifndef REDBLACKTREE_CONCURRENTREDBLACKTREE_H
+#define REDBLACKTREE_CONCURRENTREDBLACKTREE_H
+
+/**
+ * \brief       Reader/writer spin lock small enough to put in every node.
+ *
+ * \details     One word: the top bit marks a writer, the rest count
+ *          readers. Waiters spin a few rounds and then yield, so a latch
+ *          held by a preempted thread doesn't burn a whole time slice.
+ *          Readers don't wait for queued writers; latches are only held
+ *          for a few levels of a descent.
+ */
+class NodeLatch
+{
+public:
+    void lock()
+    {
+        for(unsigned spins = 0;; spins++)
+        {
+            std::uint32_t expected = 0;
+            if(this->state.compare_exchange_weak(expected, WRITER, std::memory_order_acquire, std::memory_order_relaxed))
+                return;
+            privateBackOff(spins);
+        }
+    }
+
+    void unlock() {this->state.store(0, std::memory_order_release);}
+
+    void lock_shared()
+    {
+        for(unsigned spins = 0;; spins++)
+        {
+            std::uint32_t readers = this->state.load(std::memory_order_relaxed);
+            if((readers & WRITER) == 0 &&
+               this->state.compare_exchange_weak(readers, readers + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return;
+            privateBackOff(spins);
+        }
+    }
+
+    void unlock_shared() {this->state.fetch_sub(1, std::memory_order_release);}
+
+private:
+    static constexpr std::uint32_t WRITER = 0x80000000;
+
+    static void privateBackOff(unsigned spins)
+    {
+        if(spins >= 64)
+            std::this_thread::yield();
+    }
+
+    std::atomic<std::uint32_t> state{0};
+};
+
+/**
+ * \brief       Links, latch and color of a ConcurrentNode. The tree's head
+ *          sentinel is one of these, with the root as its right child.
+ */
+template <typename kType, typename dType>
+class ConcurrentNode;
+
+template <typename kType, typename dType>
+class ConcurrentNodeBase
+{
+public:
+    ConcurrentNode<kType, dType>* link[2] = {nullptr, nullptr};
+    mutable NodeLatch latch;
+    Color color = Color::red;
+};
+
+/**
+ * \brief       Node of a ConcurrentRedBlackTree. No parent link: every
+ *          update runs top down, so nothing ever walks up. link[0] is the
+ *          left child, link[1] the right.
+ *
+ * @tparam kType Key value type.
+ * @tparam dType Data value type.
+ */
+template <typename kType, typename dType>
+class ConcurrentNode : public ConcurrentNodeBase<kType, dType>
+{
+public:
+    kType key;
+    dType data;
+
+    ConcurrentNode(kType key, dType data) : key(std::move(key)), data(std::move(data)) {}
+};
+
+/**
+ * \brief       Red black tree that any number of threads may search, insert
+ *          into and remove from at once.
+ *
+ * \details     Every node has its own latch and every operation descends by
+ *          lock coupling: it takes a node's latch before letting go of the
+ *          parent's, so it only ever holds a small window of the path.
+ *          Searches take latches shared. Updates take them exclusively and
+ *          rebalance on the way down instead of on the way back up: insert
+ *          splits nodes with two red children before passing them, remove
+ *          pushes a red node down ahead of itself, so every rotation and
+ *          recolor stays inside the window (the top-down algorithms from
+ *          Guibas and Sedgewick). Two updates only wait for each other
+ *          while their windows overlap. Near the root every operation
+ *          passes through the same few nodes, but only briefly, so the
+ *          operations pipeline down the tree instead of queueing for it.
+ *
+ *          A node's color and links only change while its parent is
+ *          latched too, so an update reads the colors of a latched node's
+ *          children without latching them, and latches a child only to
+ *          change it. Latches are always taken parent before child, so
+ *          nothing can deadlock. A node is freed right after it is unlinked: anyone
+ *          reaching it would have to hold its parent, which the remover
+ *          holds.
+ *
+ *          Nodes are carved out of POOL_STRIPES NodePools, each behind its
+ *          own latch. A thread always allocates from and frees to the same
+ *          stripe, so threads rarely meet there, and nodes stay as dense
+ *          as a RedBlackTree's instead of carrying malloc headers.
+ *
+ * @tparam kType Key value type.
+ * @tparam dType Data value type.
+ * @tparam Compare Ordering of the keys, as for RedBlackTree.
+ */
+template<typename kType, typename dType, typename Compare = DefaultCompare<kType>>
+class ConcurrentRedBlackTree
+{
+private:
+    using Base = ConcurrentNodeBase<kType, dType>;
+    using Node = ConcurrentNode<kType, dType>;
+
+    /**
+     * \brief       Exclusive latches held by one update, released when it
+     *          ends. A descent holds at most its window plus the children
+     *          and nephews it is changing.
+     */
+    class HeldLatches
+    {
+    public:
+        HeldLatches() = default;
+        HeldLatches(const HeldLatches&) = delete;
+        HeldLatches& operator=(const HeldLatches&) = delete;
+
+        ~HeldLatches()
+        {
+            for(unsigned i = 0; i < this->count; i++)
+                this->nodes[i]->latch.unlock();
+        }
+
+        /**
+         * \brief       Latches node unless it is null or already held.
+         */
+        void lock(Base* node)
+        {
+            if(node == nullptr)
+                return;
+            for(unsigned i = 0; i < this->count; i++)
+                if(this->nodes[i] == node)
+                    return;
+
+            node->latch.lock();
+            this->nodes[this->count++] = node;
+        }
+
+        /**
+         * \brief       Releases every held latch but the ones in keep.
+         */
+        void keepOnly(std::initializer_list<const Base*> keep)
+        {
+            unsigned kept = 0;
+            for(unsigned i = 0; i < this->count; i++)
+            {
+                if(std::find(keep.begin(), keep.end(), this->nodes[i]) != keep.end())
+                    this->nodes[kept++] = this->nodes[i];
+                else
+                    this->nodes[i]->latch.unlock();
+            }
+            this->count = kept;
+        }
+
+        /**
+         * \brief       Releases node's latch.
+         */
+        void unlock(Base* node)
+        {
+            for(unsigned i = 0; i < this->count; i++)
+            {
+                if(this->nodes[i] == node)
+                {
+                    node->latch.unlock();
+                    this->nodes[i] = this->nodes[--this->count];
+                    return;
+                }
+            }
+        }
+
+    private:
+        Base* nodes[16];
+        unsigned count = 0;
+    };
+
+    /**
+     * One NodePool and the latch guarding it.
+     */
+    struct alignas(64) PoolStripe
+    {
+        NodeLatch latch;
+        NodePool pool{sizeof(Node)};
+    };
+
+    /**
+     * Number of pool stripes threads are spread over.
+     */
+    static constexpr unsigned POOL_STRIPES = 16;
+
+    /**
+     * True if comp returns an ordering instead of a bool.
+     */
+    static constexpr bool THREE_WAY = !std::is_convertible_v<std::invoke_result_t<const Compare&, const kType&, const kType&>, bool>;
+
+    /**
+     * Key ordering, takes no space when the comparator is empty.
+     */
+    [[no_unique_address]] Compare comp;
+
+    /**
+     * Pools every node is allocated from.
+     */
+    PoolStripe stripes[POOL_STRIPES];
+
+    /**
+     * Sentinel above the root, link[1] is the root. Every operation starts
+     * by latching it, so replacing the root needs no special case.
+     */
+    Base head;
+
+    /**
+     * Entries in the tree, updated after each successful insert/remove.
+     */
+    std::atomic<unsigned long long> totalNodes{0};
+
+    /**
+     * \brief       Negative if a < b, zero if equal, positive if a > b.
+     */
+    int privateCompare(const kType& a, const kType& b) const;
+
+    /**
+     * \brief       Null safe color test, null nodes are black.
+     */
+    static bool privateIsRed(const Base* node);
+
+    /**
+     * \brief       Rotates top towards dir (0 left, 1 right), recoloring the
+     *          old top red and the new one black. Returns the new top for
+     *          the caller to hang where top was.
+     */
+    static Node* privateSingleRotate(Node* top, bool dir);
+
+    /**
+     * \brief       Rotates top's !dir child away from dir, then top towards
+     *          dir, lifting the inner grandchild to the top.
+     */
+    static Node* privateDoubleRotate(Node* top, bool dir);
+
+    /**
+     * \brief       Shared lock coupled descent to the entry with key sKey.
+     *          Returns it with its latch held shared, or nullptr.
+     */
+    Node* privateFindShared(const kType& sKey) const;
+
+    /**
+     * \brief       Shared lock coupled descent to the smallest entry with a
+     *          key above (or, with inclusive, equal to) sKey. Returns it with
+     *          its latch held shared, or nullptr.
+     */
+    Node* privateLowerBoundShared(const kType& sKey, bool inclusive) const;
+
+    /**
+     * \brief       Stripe of the calling thread. Threads are numbered in
+     *          the order they first get here and take turns.
+     */
+    PoolStripe& privateStripe();
+
+    /**
+     * \brief       Builds a node from the calling thread's stripe.
+     */
+    Node* createLeaf(kType key, dType data);
+
+    /**
+     * \brief       Destroys node and returns it to the calling thread's
+     *          stripe.
+     */
+    void destroyLeaf(Node* node);
+
+    /**
+     * \brief       Destroys root and everything below it. Their blocks go
+     *          back with the pools.
+     */
+    static void privateDestroyTree(Node* root);
+
+public:
+    /**
+     * \brief       Constructs an empty tree.
+     */
+    ConcurrentRedBlackTree() = default;
+
+    /**
+     * \brief       Constructs an empty tree ordered by comp.
+     *
+     * @param comp Comparator instance used for every key comparison.
+     */
+    explicit ConcurrentRedBlackTree(const Compare& comp) : comp(comp) {}
+
+    /**
+     * \brief       Destroys every node. No other thread may still be using
+     *          the tree.
+     */
+    ~ConcurrentRedBlackTree();
+
+    ConcurrentRedBlackTree(const ConcurrentRedBlackTree&) = delete;
+    ConcurrentRedBlackTree& operator=(const ConcurrentRedBlackTree&) = delete;
+
+    /**
+     * \brief       Returns the total entries of the tree. Only a moment's
+     *          value while other threads update.
+     */
+    unsigned long long getTotalSize() const {return this->totalNodes.load(std::memory_order_relaxed);}
+
+    /**
+     * \details     Same as RedBlackTree::insert, safe to call from any
+     *          thread.
+     *
+     * @param key Key value of node being inserted.
+     * @param data Data value of node being inserted.
+     * @return Bool if inserting into the tree was successful.
+     */
+    bool insert(kType key, dType data);
+
+    /**
+     * \details     Same as RedBlackTree::remove, safe to call from any
+     *          thread.
+     *
+     * @param key Key value of the node being removed.
+     * @return Bool if the key was in the tree and got removed.
+     */
+    bool remove(const kType& key);
+
+    /**
+     * \details     Same as RedBlackTree::search, safe to call from any
+     *          thread. The data is copied out while the node is latched.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @param dataPtr Pointer to data type that is to be copied into.
+     * @return Bool depending if search key is in the tree.
+     */
+    bool search(const kType& sKey, dType* dataPtr) const;
+
+    /**
+     * \details     True if sKey is in the tree.
+     */
+    bool contains(const kType& sKey) const;
+
+    /**
+     * \details     Calls visitor(key, data) on every entry with
+     *          lo <= key <= hi, in key order. Each entry is found by its own
+     *          descent and copied out before visitor runs, O(log n) per
+     *          entry, so no latch is held across calls and updates go on
+     *          meanwhile: the scan sees every entry that stays in the range
+     *          throughout, entries added or removed during it may or may
+     *          not show up. If visitor returns bool, returning false stops.
+     *
+     * @return Number of entries visited.
+     */
+    template<typename Visitor>
+    unsigned long long scan(const kType& lo, const kType& hi, Visitor&& visitor) const;
+};
+
+template<typename kType, typename dType, typename Compare>
+ConcurrentRedBlackTree<kType, dType, Compare>::~ConcurrentRedBlackTree()
+{
+    privateDestroyTree(this->head.link[1]);
+}
+
+template<typename kType, typename dType, typename Compare>
+void ConcurrentRedBlackTree<kType, dType, Compare>::privateDestroyTree(Node* root)
+{
+    if(root == nullptr)
+        return;
+
+    privateDestroyTree(root->link[0]);
+    privateDestroyTree(root->link[1]);
+    root->~Node();
+}
+
+template<typename kType, typename dType, typename Compare>
+typename ConcurrentRedBlackTree<kType, dType, Compare>::PoolStripe& ConcurrentRedBlackTree<kType, dType, Compare>::privateStripe()
+{
+    static std::atomic<unsigned> threads{0};
+    static thread_local unsigned stripe = threads.fetch_add(1, std::memory_order_relaxed) % POOL_STRIPES;
+    return this->stripes[stripe];
+}
+
+template<typename kType, typename dType, typename Compare>
+ConcurrentNode<kType, dType>* ConcurrentRedBlackTree<kType, dType, Compare>::createLeaf(kType key, dType data)
+{
+    PoolStripe& stripe = privateStripe();
+    stripe.latch.lock();
+    void* block;
+    try {
+        block = stripe.pool.allocate(sizeof(Node));
+    }
+    catch(...) {
+        stripe.latch.unlock();
+        throw;
+    }
+    stripe.latch.unlock();
+
+    try {
+        return new (block) Node(std::move(key), std::move(data));
+    }
+    catch(...) {
+        stripe.latch.lock();
+        stripe.pool.deallocate(block, sizeof(Node));
+        stripe.latch.unlock();
+        throw;
+    }
+}
+
+template<typename kType, typename dType, typename Compare>
+void ConcurrentRedBlackTree<kType, dType, Compare>::destroyLeaf(Node* node)
+{
+    node->~Node();
+
+    PoolStripe& stripe = privateStripe();
+    stripe.latch.lock();
+    stripe.pool.deallocate(node, sizeof(Node));
+    stripe.latch.unlock();
+}
+
+template<typename kType, typename dType, typename Compare>
+int ConcurrentRedBlackTree<kType, dType, Compare>::privateCompare(const kType& a, const kType& b) const
+{
+    if constexpr(THREE_WAY)
+    {
+        auto order = this->comp(a, b);
+        return order < 0 ? -1 : order > 0 ? 1 : 0;
+    }
+    else
+    {
+        return this->comp(a, b) ? -1 : this->comp(b, a) ? 1 : 0;
+    }
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ConcurrentRedBlackTree<kType, dType, Compare>::privateIsRed(const Base* node)
+{
+    return node != nullptr && node->color == Color::red;
+}
+
+template<typename kType, typename dType, typename Compare>
+ConcurrentNode<kType, dType>* ConcurrentRedBlackTree<kType, dType, Compare>::privateSingleRotate(Node* top, bool dir)
+{
+    Node* pivot = top->link[!dir];
+    top->link[!dir] = pivot->link[dir];
+    pivot->link[dir] = top;
+    top->color = Color::red;
+    pivot->color = Color::black;
+    return pivot;
+}
+
+template<typename kType, typename dType, typename Compare>
+ConcurrentNode<kType, dType>* ConcurrentRedBlackTree<kType, dType, Compare>::privateDoubleRotate(Node* top, bool dir)
+{
+    top->link[!dir] = privateSingleRotate(top->link[!dir], !dir);
+    return privateSingleRotate(top, dir);
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ConcurrentRedBlackTree<kType, dType, Compare>::insert(kType key, dType data)
+{
+    HeldLatches held;
+    held.lock(&this->head);
+
+    if(this->head.link[1] == nullptr)
+    {
+        this->head.link[1] = createLeaf(std::move(key), std::move(data));
+        this->head.link[1]->color = Color::black;
+        this->totalNodes.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Window: q the current node, p its parent, g the grandparent and t
+    // above g, where a rotation at g gets hung.
+    Base* t = &this->head;
+    Node* g = nullptr;
+    Node* p = nullptr;
+    Node* q = this->head.link[1];
+    bool dir = false;
+    bool last = false;
+    bool inserted = false;
+    held.lock(q);
+
+    for(;;)
+    {
+        if(q == nullptr)
+        {
+            // No one can reach the new leaf before p is released.
+            q = createLeaf(std::move(key), std::move(data));
+            p->link[dir] = q;
+            inserted = true;
+        }
+        else
+        {
+            if(privateIsRed(q->link[0]) && privateIsRed(q->link[1]))
+            {
+                held.lock(q->link[0]);
+                held.lock(q->link[1]);
+                q->color = p == nullptr ? Color::black : Color::red;
+                q->link[0]->color = Color::black;
+                q->link[1]->color = Color::black;
+            }
+        }
+
+        // The split (or the new red leaf) left two reds in a row.
+        if(privateIsRed(q) && privateIsRed(p))
+        {
+            bool side = t->link[1] == g;
+            if(q == p->link[last])
+                t->link[side] = privateSingleRotate(g, !last);
+            else
+                t->link[side] = privateDoubleRotate(g, !last);
+        }
+
+        if(inserted)
+            break;
+
+        int order = privateCompare(key, q->key);
+        if(order == 0)
+            break;
+
+        last = dir;
+        dir = order > 0;
+        if(g != nullptr)
+            t = g;
+        g = p;
+        p = q;
+        q = q->link[dir];
+        held.lock(q);
+        held.keepOnly({t, g, p, q});
+    }
+
+    if(inserted)
+        this->totalNodes.fetch_add(1, std::memory_order_relaxed);
+    return inserted;
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ConcurrentRedBlackTree<kType, dType, Compare>::remove(const kType& key)
+{
+    HeldLatches held;
+    held.lock(&this->head);
+    held.lock(this->head.link[1]);
+
+    // Window: q the current node, p its parent, g the grandparent. f is the
+    // node holding key once passed; the descent goes on to its predecessor.
+    Base* g = nullptr;
+    Base* p = nullptr;
+    Base* q = &this->head;
+    Node* f = nullptr;
+    bool dir = true;
+
+    while(q->link[dir] != nullptr)
+    {
+        bool last = dir;
+        g = p;
+        p = q;
+        q = q->link[dir];
+        held.lock(q);
+        held.keepOnly({g, p, q, f});
+
+        Node* node = static_cast<Node*>(q);
+
+        int order = privateCompare(node->key, key);
+        dir = order < 0;
+        if(order == 0)
+            f = node;
+
+        // Make sure the next step starts from a red node.
+        if(privateIsRed(node) || privateIsRed(node->link[dir]))
+            continue;
+
+        if(privateIsRed(node->link[!dir]))
+        {
+            held.lock(node->link[!dir]);
+            Node* top = privateSingleRotate(node, dir);
+            p->link[last] = top;
+            p = top;
+            continue;
+        }
+
+        // p's other child. The head has none, so parent is a real node.
+        Node* sibling = p->link[!last];
+        if(sibling == nullptr)
+            continue;
+
+        held.lock(sibling);
+        if(!privateIsRed(sibling->link[0]) && !privateIsRed(sibling->link[1]))
+        {
+            p->color = Color::black;
+            sibling->color = Color::red;
+            node->color = Color::red;
+        }
+        else
+        {
+            held.lock(sibling->link[0]);
+            held.lock(sibling->link[1]);
+            Node* parent = static_cast<Node*>(p);
+            bool side = g->link[1] == parent;
+            Node* top = privateIsRed(sibling->link[last]) ? privateDoubleRotate(parent, last) : privateSingleRotate(parent, last);
+            g->link[side] = top;
+
+            node->color = Color::red;
+            top->color = g == &this->head ? Color::black : Color::red;
+            top->link[0]->color = Color::black;
+            top->link[1]->color = Color::black;
+        }
+    }
+
+    if(f == nullptr)
+        return false;
+
+    // q is f or f's predecessor, red or the root, with at most one child.
+    Node* gone = static_cast<Node*>(q);
+    if(f != gone)
+    {
+        f->key = std::move(gone->key);
+        f->data = std::move(gone->data);
+    }
+    p->link[p->link[1] == gone] = gone->link[gone->link[0] == nullptr];
+
+    // Anyone reaching gone would have to hold p first.
+    held.unlock(gone);
+    destroyLeaf(gone);
+
+    // The head is only still latched if it is p.
+    if(p == &this->head && this->head.link[1] != nullptr)
+        this->head.link[1]->color = Color::black;
+
+    this->totalNodes.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare>
+ConcurrentNode<kType, dType>* ConcurrentRedBlackTree<kType, dType, Compare>::privateFindShared(const kType& sKey) const
+{
+    const Base* parent = &this->head;
+    parent->latch.lock_shared();
+    Node* node = parent->link[1];
+
+    while(node != nullptr)
+    {
+        node->latch.lock_shared();
+        parent->latch.unlock_shared();
+
+        int order = privateCompare(sKey, node->key);
+        if(order == 0)
+            return node;
+
+        parent = node;
+        node = node->link[order > 0];
+    }
+
+    parent->latch.unlock_shared();
+    return nullptr;
+}
+
+template<typename kType, typename dType, typename Compare>
+ConcurrentNode<kType, dType>* ConcurrentRedBlackTree<kType, dType, Compare>::privateLowerBoundShared(const kType& sKey, bool inclusive) const
+{
+    // best stays latched until a better candidate turns up below it.
+    Node* best = nullptr;
+    const Base* parent = &this->head;
+    parent->latch.lock_shared();
+    Node* node = parent->link[1];
+
+    while(node != nullptr)
+    {
+        node->latch.lock_shared();
+        if(parent != best)
+            parent->latch.unlock_shared();
+
+        int order = privateCompare(node->key, sKey);
+        if(order > 0 || (inclusive && order == 0))
+        {
+            if(best != nullptr)
+                best->latch.unlock_shared();
+            best = node;
+            if(order == 0)
+                return best;
+        }
+
+        parent = node;
+        node = node->link[order <= 0 && !(inclusive && order == 0)];
+    }
+
+    if(parent != best)
+        parent->latch.unlock_shared();
+    return best;
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ConcurrentRedBlackTree<kType, dType, Compare>::search(const kType& sKey, dType* dataPtr) const
+{
+    Node* node = privateFindShared(sKey);
+    if(node == nullptr)
+        return false;
+
+    *dataPtr = node->data;
+    node->latch.unlock_shared();
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ConcurrentRedBlackTree<kType, dType, Compare>::contains(const kType& sKey) const
+{
+    Node* node = privateFindShared(sKey);
+    if(node == nullptr)
+        return false;
+
+    node->latch.unlock_shared();
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename Visitor>
+unsigned long long ConcurrentRedBlackTree<kType, dType, Compare>::scan(const kType& lo, const kType& hi, Visitor&& visitor) const
+{
+    unsigned long long visited = 0;
+
+    for(Node* node = privateLowerBoundShared(lo, true); node != nullptr;)
+    {
+        if(privateCompare(node->key, hi) > 0)
+        {
+            node->latch.unlock_shared();
+            break;
+        }
+
+        std::pair<kType, dType> entry(node->key, node->data);
+        node->latch.unlock_shared();
+        visited++;
+
+        if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, const dType&>, bool>)
+        {
+            if(!visitor(static_cast<const kType&>(entry.first), static_cast<const dType&>(entry.second)))
+                break;
+        }
+        else
+        {
+            visitor(static_cast<const kType&>(entry.first), static_cast<const dType&>(entry.second));
+        }
+
+        node = privateLowerBoundShared(entry.first, false);
+    }
+
+    return visited;
+}
+
+#endif //REDBLACKTREE_CONCURRENTREDBLACKTREE_H
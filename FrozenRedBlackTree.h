@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "RedBlackTree.h"
+
+#ifndef REDBLACKTREE_FROZENREDBLACKTREE_H
+#define REDBLACKTREE_FROZENREDBLACKTREE_H
+
+/**
+ * \brief       Read only copy of a RedBlackTree laid out in two flat arrays
+ *          in Eytzinger (breadth first) order.
+ *
+ * \details     Entry k (1-based) has its children at 2k and 2k + 1, so a
+ *          lookup walks a perfectly balanced implicit tree without following
+ *          a single pointer. The top levels share a handful of cache lines
+ *          that stay hot, and the 16 possible positions four levels below k
+ *          sit next to each other at 16k, so each step prefetches the line
+ *          it will need four steps later. On trees far larger than the cache
+ *          that hides most of the memory latency a pointer chasing descent
+ *          pays at every level.
+ *
+ *          The descent has no data dependent branch: each level only adds
+ *          the outcome of one comparison to the index, and where the search
+ *          left the tree tells which entry is the lower bound. For
+ *          arithmetic keys under the default ordering the comparison is a
+ *          plain <, which compiles to a conditional move.
+ *
+ *          Keys and data are kept in separate arrays, so a descent only
+ *          touches keys. Walking the entries in key order steps through the
+ *          implicit tree in order, O(1) amortized per entry.
+ *
+ *          Built with RedBlackTree::freeze or the constructor below, in O(n),
+ *          and never changed afterwards; build a new one to pick up changes.
+ *
+ * @tparam kType Key value type. Must be copyable.
+ * @tparam dType Data value type. Must be copyable.
+ * @tparam Compare Same ordering as the tree it was frozen from.
+ */
+template<typename kType, typename dType, typename Compare = DefaultCompare<kType>>
+class FrozenRedBlackTree
+{
+private:
+    /**
+     * True if comp returns an ordering instead of a bool.
+     */
+    static constexpr bool THREE_WAY = !std::is_convertible_v<std::invoke_result_t<const Compare&, const kType&, const kType&>, bool>;
+
+    /**
+     * True if the keys can be compared with a plain <.
+     */
+    static constexpr bool PLAIN_LESS = std::is_arithmetic_v<kType> && (std::is_same_v<Compare, ThreeWayCompare> || std::is_same_v<Compare, std::less<kType>>);
+
+    /**
+     * Positions four levels down from k start at PREFETCH_STRIDE * k.
+     */
+    static constexpr std::size_t PREFETCH_STRIDE = 16;
+
+    /**
+     * Key ordering, takes no space when the comparator is empty.
+     */
+    [[no_unique_address]] Compare comp;
+
+    /**
+     * Keys in Eytzinger order, entry k at keys[k - 1].
+     */
+    std::vector<kType> keys;
+
+    /**
+     * Data of the entry at the same position in keys.
+     */
+    std::vector<dType> values;
+
+    template<typename A, typename B>
+    bool privateLess(const A& a, const B& b) const;
+
+    /**
+     * \brief       Same as RedBlackTree::privateLookupKey: sKey itself for
+     *          transparent comparators, else sKey converted to kType once.
+     */
+    template<typename K>
+    static decltype(auto) privateLookupKey(const K& key);
+
+    /**
+     * \brief       Position of the smallest key not less than sKey (1-based),
+     *          0 if there is none.
+     */
+    template<typename K>
+    std::size_t privateLowerBound(const K& sKey) const;
+
+    /**
+     * \brief       Position of the smallest key greater than sKey (1-based),
+     *          0 if there is none.
+     */
+    template<typename K>
+    std::size_t privateUpperBound(const K& sKey) const;
+
+    /**
+     * \brief       Position of sKey, 0 if it isn't there.
+     */
+    template<typename K>
+    std::size_t privateSearch(const K& sKey) const;
+
+    /**
+     * \brief       Position of the smallest key of an implicit tree of count
+     *          entries, 0 if it is empty.
+     */
+    static std::size_t privateFirst(std::size_t count);
+
+    /**
+     * \brief       Position following k in key order, 0 after the last one.
+     */
+    static std::size_t privateNext(std::size_t k, std::size_t count);
+
+    static void privatePrefetch(const void* address);
+
+public:
+    /**
+     * \brief       Forward iterator over the entries in key order.
+     */
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<kType, dType>;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::pair<const kType&, const dType&>;
+
+        /**
+         * Holds the reference pair so operator-> has something to point at.
+         */
+        class pointer
+        {
+        public:
+            explicit pointer(reference entry) : entry(entry) {}
+            const reference* operator->() const {return &this->entry;}
+        private:
+            reference entry;
+        };
+
+        const_iterator() = default;
+
+        reference operator*() const {return reference(this->tree->keys[this->k - 1], this->tree->values[this->k - 1]);}
+        pointer operator->() const {return pointer(**this);}
+
+        const_iterator& operator++()
+        {
+            this->k = privateNext(this->k, this->tree->keys.size());
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b) {return a.k == b.k;}
+
+    private:
+        friend class FrozenRedBlackTree;
+
+        const_iterator(std::size_t k, const FrozenRedBlackTree* tree) : k(k), tree(tree) {}
+
+        std::size_t k = 0;
+        const FrozenRedBlackTree* tree = nullptr;
+    };
+
+    using iterator = const_iterator;
+
+    /**
+     * \brief       Constructs an empty frozen tree.
+     */
+    FrozenRedBlackTree() = default;
+
+    /**
+     * \brief       Copies every entry of tree, O(n).
+     *
+     * @param tree Tree to freeze. Only read, and it may be changed or
+     *          destroyed afterwards.
+     */
+    template<bool OrderStatistics, typename Augment>
+    explicit FrozenRedBlackTree(const RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>& tree);
+
+    /**
+     * \brief       Returns the total entries of the tree.
+     */
+    unsigned long long getTotalSize() const {return this->keys.size();}
+
+    /**
+     * \details     Same as RedBlackTree::search: copies the data of sKey into
+     *          dataPtr if it is there.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @param dataPtr Pointer to data type that is to be copied into.
+     * @return Bool depending if search key is in the tree.
+     */
+    template<typename K> requires LookupKey<K, kType, Compare>
+    bool search(const K& sKey, dType* dataPtr) const;
+
+    /**
+     * \details     Pointer to the data of sKey, nullptr if it isn't there.
+     *          Valid as long as the frozen tree.
+     */
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const dType* find(const K& sKey) const;
+
+    template<typename K> requires LookupKey<K, kType, Compare>
+    bool contains(const K& sKey) const {return privateSearch(privateLookupKey(sKey)) != 0;}
+
+    const_iterator begin() const {return const_iterator(privateFirst(this->keys.size()), this);}
+    const_iterator end() const {return const_iterator(0, this);}
+
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator lower_bound(const K& sKey) const {return const_iterator(privateLowerBound(privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator upper_bound(const K& sKey) const {return const_iterator(privateUpperBound(privateLookupKey(sKey)), this);}
+
+    /**
+     * \details     Same as RedBlackTree::scan: calls visitor(key, data) on
+     *          every entry with lo <= key <= hi, in key order. If visitor
+     *          returns bool, returning false stops the scan.
+     *
+     * @param lo Smallest key to visit.
+     * @param hi Largest key to visit.
+     * @param visitor Callable taking (const kType&, const dType&).
+     * @return Number of entries visited.
+     */
+    template<typename K, typename Visitor> requires LookupKey<K, kType, Compare>
+    unsigned long long scan(const K& lo, const K& hi, Visitor&& visitor) const;
+};
+
+template<typename kType, typename dType, typename Compare>
+template<bool OrderStatistics, typename Augment>
+FrozenRedBlackTree<kType, dType, Compare>::FrozenRedBlackTree(const RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>& tree)
+    : comp(tree.comp)
+{
+    std::vector<std::pair<const kType*, const dType*>> sorted;
+    if(const unsigned long long size = tree.privateKnownSize(); size != tree.UNKNOWN_SIZE)
+        sorted.reserve(size);
+    for(auto [key, data] : tree)
+        sorted.emplace_back(&key, &data);
+
+    // Walking the positions in key order hands out the sorted ranks, then
+    // the entries are copied in position order.
+    const std::size_t count = sorted.size();
+    std::vector<std::size_t> rank(count);
+    std::size_t k = privateFirst(count);
+    for(std::size_t i = 0; i < count; i++, k = privateNext(k, count))
+        rank[k - 1] = i;
+
+    this->keys.reserve(count);
+    this->values.reserve(count);
+    for(std::size_t position = 0; position < count; position++)
+    {
+        this->keys.push_back(*sorted[rank[position]].first);
+        this->values.push_back(*sorted[rank[position]].second);
+    }
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename A, typename B>
+bool FrozenRedBlackTree<kType, dType, Compare>::privateLess(const A& a, const B& b) const
+{
+    if constexpr(PLAIN_LESS && std::is_same_v<A, kType> && std::is_same_v<B, kType>)
+        return a < b;
+    else if constexpr(THREE_WAY)
+        return this->comp(a, b) < 0;
+    else
+        return this->comp(a, b);
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename K>
+decltype(auto) FrozenRedBlackTree<kType, dType, Compare>::privateLookupKey(const K& key)
+{
+    if constexpr(std::is_same_v<K, kType> || HeterogeneousKey<K, kType, Compare>)
+        return (key);
+    else
+        return kType(key);
+}
+
+template<typename kType, typename dType, typename Compare>
+void FrozenRedBlackTree<kType, dType, Compare>::privatePrefetch(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename K>
+std::size_t FrozenRedBlackTree<kType, dType, Compare>::privateLowerBound(const K& sKey) const
+{
+    const std::size_t count = this->keys.size();
+    const kType* keys = this->keys.data();
+
+    // Right when the key is less, left otherwise, until k falls off the
+    // bottom. The lower bound is where the path last went left: strip the
+    // trailing right turns and that left turn.
+    std::size_t k = 1;
+    while(k <= count)
+    {
+        privatePrefetch(keys + std::min(PREFETCH_STRIDE * k, count) - 1);
+        k = 2 * k + (privateLess(keys[k - 1], sKey) ? 1 : 0);
+    }
+    return k >> (std::countr_one(k) + 1);
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename K>
+std::size_t FrozenRedBlackTree<kType, dType, Compare>::privateUpperBound(const K& sKey) const
+{
+    const std::size_t count = this->keys.size();
+    const kType* keys = this->keys.data();
+
+    std::size_t k = 1;
+    while(k <= count)
+    {
+        privatePrefetch(keys + std::min(PREFETCH_STRIDE * k, count) - 1);
+        k = 2 * k + (privateLess(sKey, keys[k - 1]) ? 0 : 1);
+    }
+    return k >> (std::countr_one(k) + 1);
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename K>
+std::size_t FrozenRedBlackTree<kType, dType, Compare>::privateSearch(const K& sKey) const
+{
+    std::size_t k = privateLowerBound(sKey);
+    return k != 0 && !privateLess(sKey, this->keys[k - 1]) ? k : 0;
+}
+
+template<typename kType, typename dType, typename Compare>
+std::size_t FrozenRedBlackTree<kType, dType, Compare>::privateFirst(std::size_t count)
+{
+    if(count == 0)
+        return 0;
+
+    std::size_t k = 1;
+    while(2 * k <= count)
+        k *= 2;
+    return k;
+}
+
+template<typename kType, typename dType, typename Compare>
+std::size_t FrozenRedBlackTree<kType, dType, Compare>::privateNext(std::size_t k, std::size_t count)
+{
+    // Leftmost of the right subtree if there is one, else up past every
+    // right child and one more.
+    if(2 * k + 1 <= count)
+    {
+        k = 2 * k + 1;
+        while(2 * k <= count)
+            k *= 2;
+        return k;
+    }
+
+    return k >> (std::countr_one(k) + 1);
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename K> requires LookupKey<K, kType, Compare>
+bool FrozenRedBlackTree<kType, dType, Compare>::search(const K& sKey, dType* dataPtr) const
+{
+    std::size_t k = privateSearch(privateLookupKey(sKey));
+    if(k == 0)
+        return false;
+
+    *dataPtr = this->values[k - 1];
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename K> requires LookupKey<K, kType, Compare>
+const dType* FrozenRedBlackTree<kType, dType, Compare>::find(const K& sKey) const
+{
+    std::size_t k = privateSearch(privateLookupKey(sKey));
+    return k != 0 ? &this->values[k - 1] : nullptr;
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename K, typename Visitor> requires LookupKey<K, kType, Compare>
+unsigned long long FrozenRedBlackTree<kType, dType, Compare>::scan(const K& lo, const K& hi, Visitor&& visitor) const
+{
+    decltype(auto) high = privateLookupKey(hi);
+    const std::size_t count = this->keys.size();
+    unsigned long long visited = 0;
+
+    for(std::size_t k = privateLowerBound(privateLookupKey(lo)); k != 0 && !privateLess(high, this->keys[k - 1]); k = privateNext(k, count))
+    {
+        visited++;
+        if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, const dType&>, bool>)
+        {
+            if(!visitor(this->keys[k - 1], this->values[k - 1]))
+                break;
+        }
+        else
+        {
+            visitor(this->keys[k - 1], this->values[k - 1]);
+        }
+    }
+
+    return visited;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+FrozenRedBlackTree<kType, dType, Compare> RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::freeze() const
+{
+    return FrozenRedBlackTree<kType, dType, Compare>(*this);
+}
+
+#endif //REDBLACKTREE_FROZENREDBLACKTREE_H
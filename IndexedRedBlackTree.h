@@ -0,0 +1,801 @@
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "RedBlackTree.h"
+
+#ifndef REDBLACKTREE_INDEXEDREDBLACKTREE_H
+#define REDBLACKTREE_INDEXEDREDBLACKTREE_H
+
+/**
+ * Index standing in for nullptr in an IndexedRedBlackTree.
+ */
+constexpr std::uint32_t INDEXED_NULL = 0xFFFFFFFF;
+
+/**
+ * \brief       Node of an IndexedRedBlackTree. Same shape as Node, but the
+ *          links are 32 bit positions in the tree's node vector instead of
+ *          pointers.
+ *
+ * @tparam kType Key value type.
+ * @tparam dType Data value type.
+ */
+template <typename kType, typename dType>
+class IndexedNode
+{
+public:
+    kType key;
+    dType data;
+    std::uint32_t left = INDEXED_NULL;
+    std::uint32_t right = INDEXED_NULL;
+    std::uint32_t parent = INDEXED_NULL;
+    Color color = Color::red;
+};
+
+static_assert(sizeof(IndexedNode<int, int>) == 3 * sizeof(std::uint32_t) + 2 * sizeof(int) + sizeof(Color), "IndexedNode<int, int> should be three indices plus key, data and color.");
+
+/**
+ * \brief       Red black tree whose nodes live in one contiguous vector and
+ *          link to each other with 32 bit indices.
+ *
+ * \details     Same insert/remove/search interface and the same rotation,
+ *          insert fix-up and delete cases as RedBlackTree, only written
+ *          against indices. For RedBlackTree<int, int> a node shrinks from
+ *          32 to 24 bytes on 64 bit targets.
+ *
+ *          Since no node holds an address, the whole tree is the node vector
+ *          plus a few counters. Copying the tree is a flat copy of that
+ *          vector (a memcpy for trivially copyable keys and data), which
+ *          makes it cheap to checkpoint.
+ *
+ *          Removed nodes go on a free list threaded through left and are
+ *          reused by the next insert, so indices never move. The tree holds
+ *          at most 2^32 - 1 nodes.
+ *
+ * @tparam kType Key value type.
+ * @tparam dType Data value type.
+ */
+template<typename kType, typename dType>
+class IndexedRedBlackTree
+{
+private:
+    /**
+     * Every node of the tree, including freed ones waiting for reuse.
+     */
+    std::vector<IndexedNode<kType, dType>> nodes;
+
+    /**
+     * top root of the tree
+     */
+    std::uint32_t root = INDEXED_NULL;
+
+    /**
+     * Head of the free list. Freed nodes are chained through left.
+     */
+    std::uint32_t freeList = INDEXED_NULL;
+
+    /**
+     * counter for totalNodes. Increments/decrements on insert/remove success.
+     */
+    unsigned long long totalNodes = 0;
+
+    IndexedNode<kType, dType>& at(std::uint32_t index) {return this->nodes[index];}
+    const IndexedNode<kType, dType>& at(std::uint32_t index) const {return this->nodes[index];}
+
+    /**
+     * \brief       Creates a node with key and data, reusing a freed slot if
+     *          there is one. Returns its index.
+     *
+     * \note        May grow the node vector, so references into it don't
+     *          survive this call. Indices do.
+     */
+    std::uint32_t createLeaf(kType key, dType data);
+
+    /**
+     * \brief       Puts an unlinked node on the free list.
+     */
+    void destroyLeaf(std::uint32_t node);
+
+    /**
+     * \brief       Returns the sibling (if there is) of node. Else INDEXED_NULL.
+     */
+    std::uint32_t getSibling(std::uint32_t node) const;
+
+    /**
+     * \brief       Adjusts the tree after node was inserted as a red leaf.
+     *          Same cases as RedBlackTree::privateInsertAdjustTree.
+     */
+    void privateInsertAdjustTree(std::uint32_t node);
+
+    /**
+     * \brief       Standard BST unlink of a node with at most one child.
+     */
+    void privateDeleteBST(std::uint32_t root);
+
+    /**
+     * \brief       Deletes root from the tree and rebalances. Same steps and
+     *          cases 0-4 as RedBlackTree::privateDelete.
+     */
+    void privateDelete(std::uint32_t root);
+
+    void privateLeftRotate(std::uint32_t root);
+    void privateRightRotate(std::uint32_t root);
+
+    std::uint32_t privateFindSmallest(std::uint32_t root) const;
+
+    /**
+     * \brief       Returns the index holding key, or INDEXED_NULL.
+     */
+    std::uint32_t privateSearch(const kType& key) const;
+
+    /**
+     * \brief       isValid for the subtree at root, whose keys must lie
+     *          strictly between low and high where those are not
+     *          INDEXED_NULL.
+     *
+     * @param blackHeight Set to the black nodes on every path down from root.
+     * @param count Set to the nodes of the subtree.
+     */
+    bool privateIsValid(std::uint32_t root, std::uint32_t low, std::uint32_t high, unsigned& blackHeight, unsigned long long& count) const;
+
+    bool privateCheckCaseZero(std::uint32_t x) const;
+    bool privateCheckCaseOne(std::uint32_t x, std::uint32_t w) const;
+    bool privateCheckCaseTwo(std::uint32_t x, std::uint32_t w) const;
+    bool privateCheckCaseThree(std::uint32_t x, std::uint32_t w, std::uint32_t parent) const;
+    bool privateCheckCaseFour(std::uint32_t x, std::uint32_t w, std::uint32_t parent) const;
+
+    void privateCaseZero(std::uint32_t x);
+    void privateCaseOne(std::uint32_t x, std::uint32_t w, std::uint32_t parent);
+    void privateCaseTwo(std::uint32_t x, std::uint32_t w, std::uint32_t parent);
+    void privateCaseThree(std::uint32_t x, std::uint32_t w, std::uint32_t parent);
+    void privateCaseFour(std::uint32_t x, std::uint32_t w, std::uint32_t parent);
+public:
+    /**
+     * \brief       Constructs an empty tree.
+     */
+    IndexedRedBlackTree();
+
+    /**
+     * \brief       Constructs a tree with one initial node.
+     *
+     * @param rootKey Key value of the data entry.
+     * @param rootData Data value for that key entry.
+     */
+    IndexedRedBlackTree(kType rootKey, dType rootData);
+
+    /**
+     * \brief       Returns the total entries of the tree.
+     */
+    unsigned long long getTotalSize() const {return this->totalNodes;}
+
+    /**
+     * \brief       Makes room for count nodes without growing the vector.
+     */
+    void reserve(std::size_t count) {this->nodes.reserve(count);}
+
+    /**
+     * \details     Attempts an insertion into the tree. Returns false if the
+     *          key is already in the tree.
+     *
+     * @param key Key value of node being inserted.
+     * @param data Data value of node being inserted.
+     * @return Bool if inserting into the tree was successful.
+     */
+    bool insert(kType key, dType data);
+
+    /**
+     * \details     Attempts to remove an item from the tree.
+     *
+     * @param key Key of the entry to remove.
+     * @return Bool if the key was in the tree.
+     */
+    bool remove(kType key);
+
+    /**
+     * \details     Searches the tree for sKey. If found, copies its data
+     *          into dataPtr and returns true.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @param dataPtr Pointer to data type that is to be copied into.
+     * @return Bool depending if search key is in the tree.
+     */
+    bool search(const kType& sKey, dType* dataPtr) const;
+
+    /**
+     * \brief       Checks key order, parent links, the red black rules and
+     *          the tree size kept. O(n), for tests and debugging.
+     *
+     * @return True if every check passes.
+     */
+    bool isValid() const;
+};
+
+template<typename kType, typename dType>
+IndexedRedBlackTree<kType, dType>::IndexedRedBlackTree() {}
+
+template<typename kType, typename dType>
+IndexedRedBlackTree<kType, dType>::IndexedRedBlackTree(kType rootKey, dType rootData)
+{
+    this->root = createLeaf(rootKey, rootData);
+    at(this->root).color = Color::black;
+    this->totalNodes = 1;
+}
+
+template<typename kType, typename dType>
+std::uint32_t IndexedRedBlackTree<kType, dType>::createLeaf(kType key, dType data)
+{
+    std::uint32_t leaf;
+
+    if(this->freeList != INDEXED_NULL)
+    {
+        leaf = this->freeList;
+        this->freeList = at(leaf).left;
+
+        at(leaf).key = key;
+        at(leaf).data = data;
+        at(leaf).left = INDEXED_NULL;
+        at(leaf).right = INDEXED_NULL;
+        at(leaf).parent = INDEXED_NULL;
+        at(leaf).color = Color::red;
+    }
+    else
+    {
+        if(this->nodes.size() >= INDEXED_NULL)
+            throw std::length_error("IndexedRedBlackTree can't hold more than 2^32 - 1 nodes.");
+
+        leaf = static_cast<std::uint32_t>(this->nodes.size());
+        this->nodes.push_back(IndexedNode<kType, dType>{key, data});
+    }
+
+    return leaf;
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::destroyLeaf(std::uint32_t node)
+{
+    at(node).left = this->freeList;
+    at(node).right = INDEXED_NULL;
+    at(node).parent = INDEXED_NULL;
+    this->freeList = node;
+}
+
+template<typename kType, typename dType>
+std::uint32_t IndexedRedBlackTree<kType, dType>::getSibling(std::uint32_t node) const
+{
+    std::uint32_t parent = at(node).parent;
+
+    if(parent != INDEXED_NULL) {
+        if(at(parent).left == node)
+            return at(parent).right;
+        else if(at(parent).right == node)
+            return at(parent).left;
+    }
+
+    return INDEXED_NULL;
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateInsertAdjustTree(std::uint32_t node)
+{
+    // Stops as soon as no red node has a red parent: O(1) amortized.
+    while(node != this->root && node != INDEXED_NULL)
+    {
+        std::uint32_t parent = at(node).parent;
+
+        // Nothing to fix. A red root is blackened below.
+        if(at(node).color != Color::red || at(parent).color != Color::red || parent == this->root)
+            break;
+
+        std::uint32_t grandparent = at(parent).parent;
+        std::uint32_t uncle = at(grandparent).left == parent ? at(grandparent).right : at(grandparent).left;
+
+        // Red uncle: recolor and carry the red up to grandparent.
+        if(uncle != INDEXED_NULL && at(uncle).color == Color::red)
+        {
+            at(uncle).color = Color::black;
+            at(parent).color = Color::black;
+            at(grandparent).color = Color::red;
+            node = grandparent;
+            continue;
+        }
+
+        // Black or no uncle: one or two rotations finish the fix-up.
+        if(at(parent).left == node)
+        {
+            // right left case
+            if(at(grandparent).right == parent)
+            {
+                privateRightRotate(parent);
+                privateLeftRotate(grandparent);
+                at(node).color = Color::black;
+                at(at(node).right).color = Color::red;
+                at(at(node).left).color = Color::red;
+            }
+            // left left case
+            else
+            {
+                privateRightRotate(grandparent);
+                at(parent).color = Color::black;
+                at(at(parent).right).color = Color::red;
+                at(at(parent).left).color = Color::red;
+            }
+        }
+        else
+        {
+            // Left Right Case.
+            if(at(grandparent).left == parent)
+            {
+                privateLeftRotate(parent);
+                privateRightRotate(grandparent);
+                at(node).color = Color::black;
+                at(at(node).right).color = Color::red;
+                at(at(node).left).color = Color::red;
+            }
+            // right right case
+            else
+            {
+                privateLeftRotate(grandparent);
+                at(parent).color = Color::black;
+                at(at(parent).right).color = Color::red;
+                at(at(parent).left).color = Color::red;
+            }
+        }
+        break;
+    }
+
+    // Set root to black!
+    at(this->root).color = Color::black;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::insert(kType key, dType data)
+{
+    std::uint32_t parent = INDEXED_NULL;
+    std::uint32_t current = this->root;
+
+    // Find the leaf position first, only create the node if the key is new.
+    while(current != INDEXED_NULL)
+    {
+        if(at(current).key == key)
+            return false;
+
+        parent = current;
+        current = at(current).key < key ? at(current).right : at(current).left;
+    }
+
+    std::uint32_t node = createLeaf(key, data);
+    at(node).parent = parent;
+
+    if(parent == INDEXED_NULL)
+        this->root = node;
+    else if(at(parent).key < key)
+        at(parent).right = node;
+    else
+        at(parent).left = node;
+
+    this->totalNodes++;
+    privateInsertAdjustTree(node);
+
+    return true;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::privateCheckCaseZero(std::uint32_t x) const
+{
+    return x != INDEXED_NULL && at(x).color == Color::red;
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateCaseZero(std::uint32_t x)
+{
+    at(x).color = Color::black;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::privateCheckCaseOne(std::uint32_t x, std::uint32_t w) const
+{
+    return (x == INDEXED_NULL || at(x).color == Color::black) && w != INDEXED_NULL && at(w).color == Color::red;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::privateCheckCaseTwo(std::uint32_t x, std::uint32_t w) const
+{
+    return (x == INDEXED_NULL || at(x).color == Color::black)                                       &&
+           (w != INDEXED_NULL && at(w).color == Color::black)                                       &&
+           (at(w).right == INDEXED_NULL || at(at(w).right).color == Color::black)                   &&
+           (at(w).left == INDEXED_NULL || at(at(w).left).color == Color::black);
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::privateCheckCaseThree(std::uint32_t x, std::uint32_t w, std::uint32_t parent) const
+{
+    if((x == INDEXED_NULL || at(x).color == Color::black) && w != INDEXED_NULL && at(w).color == Color::black && parent != INDEXED_NULL)
+    {
+        std::uint32_t wLeft = at(w).left;
+        std::uint32_t wRight = at(w).right;
+
+        if(at(parent).left == x && wLeft != INDEXED_NULL && at(wLeft).color == Color::red && (wRight == INDEXED_NULL || at(wRight).color == Color::black))
+            return true;
+        if(at(parent).right == x && wRight != INDEXED_NULL && at(wRight).color == Color::red && (wLeft == INDEXED_NULL || at(wLeft).color == Color::black))
+            return true;
+    }
+
+    return false;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::privateCheckCaseFour(std::uint32_t x, std::uint32_t w, std::uint32_t parent) const
+{
+    if((x == INDEXED_NULL || at(x).color == Color::black) && w != INDEXED_NULL && parent != INDEXED_NULL)
+    {
+        std::uint32_t wLeft = at(w).left;
+        std::uint32_t wRight = at(w).right;
+
+        if(at(parent).right == x && wLeft != INDEXED_NULL && at(wLeft).color == Color::red)
+            return true;
+        if(at(parent).left == x && wRight != INDEXED_NULL && at(wRight).color == Color::red)
+            return true;
+    }
+
+    return false;
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateCaseOne(std::uint32_t x, std::uint32_t w, std::uint32_t parent)
+{
+    // Color w black, parent of x red.
+    at(w).color = Color::black;
+    at(parent).color = Color::red;
+
+    if(at(parent).left == x) {
+        privateLeftRotate(parent);
+        w = at(parent).right;
+    }
+    else {
+        privateRightRotate(parent);
+        w = at(parent).left;
+    }
+
+    bool xBlack = x == INDEXED_NULL || at(x).color == Color::black;
+    bool wBlack = w == INDEXED_NULL || at(w).color == Color::black;
+
+    // CASE 2.
+    if(xBlack && wBlack &&
+       (w == INDEXED_NULL || ((at(w).right == INDEXED_NULL || at(at(w).right).color == Color::black) &&
+                              (at(w).left == INDEXED_NULL || at(at(w).left).color == Color::black))))
+    {
+        privateCaseTwo(x, w, parent);
+    }
+    // CASE 3.
+    else if(xBlack && wBlack && privateCheckCaseThree(x, w, parent))
+    {
+        privateCaseThree(x, w, parent);
+    }
+    // CASE 4.
+    else if(xBlack && w != INDEXED_NULL &&
+            ((at(w).left != INDEXED_NULL && at(at(w).left).color == Color::red) ||
+             (at(w).right != INDEXED_NULL && at(at(w).right).color == Color::red)))
+    {
+        privateCaseFour(x, w, parent);
+    }
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateCaseTwo(std::uint32_t x, std::uint32_t w, std::uint32_t parent)
+{
+    if(w != INDEXED_NULL)
+        at(w).color = Color::red;
+
+    x = parent;
+    w = getSibling(x);
+    parent = at(x).parent;
+
+    if(at(x).color == Color::red)
+    {
+        at(x).color = Color::black;
+    }
+    else
+    {
+        if(privateCheckCaseOne(x, w))
+            privateCaseOne(x, w, parent);
+        else if(privateCheckCaseTwo(x, w))
+            privateCaseTwo(x, w, parent);
+        else if(privateCheckCaseThree(x, w, parent))
+            privateCaseThree(x, w, parent);
+        else if(privateCheckCaseFour(x, w, parent))
+            privateCaseFour(x, w, parent);
+    }
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateCaseThree(std::uint32_t x, std::uint32_t w, std::uint32_t parent)
+{
+    // Color w's red child black, w red and rotate w away from x.
+    if(at(parent).left == x)
+    {
+        at(at(w).left).color = Color::black;
+        at(w).color = Color::red;
+        privateRightRotate(w);
+        w = at(parent).right;
+    }
+    else
+    {
+        at(at(w).right).color = Color::black;
+        at(w).color = Color::red;
+        privateLeftRotate(w);
+        w = at(parent).left;
+    }
+
+    if(privateCheckCaseFour(x, w, parent))
+        privateCaseFour(x, w, parent);
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateCaseFour(std::uint32_t x, std::uint32_t w, std::uint32_t parent)
+{
+    if(w == INDEXED_NULL || parent == INDEXED_NULL)
+        return;
+
+    // Color w the same color as x->parent, parent black.
+    at(w).color = at(parent).color;
+    at(parent).color = Color::black;
+
+    // Color w's child black now depending on if x is left or right.
+    if(at(parent).left == x) {
+        if(at(w).right != INDEXED_NULL)
+            at(at(w).right).color = Color::black;
+        privateLeftRotate(parent);
+    }
+    else
+    {
+        if(at(w).left != INDEXED_NULL)
+            at(at(w).left).color = Color::black;
+        privateRightRotate(parent);
+    }
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateDeleteBST(std::uint32_t root)
+{
+    std::uint32_t parent = at(root).parent;
+    std::uint32_t child = at(root).left != INDEXED_NULL ? at(root).left : at(root).right;
+
+    if(child != INDEXED_NULL)
+        at(child).parent = parent;
+
+    if(parent == INDEXED_NULL)
+        this->root = child;
+    else if(at(parent).left == root)
+        at(parent).left = child;
+    else
+        at(parent).right = child;
+
+    at(root).parent = INDEXED_NULL;
+    at(root).left = INDEXED_NULL;
+    at(root).right = INDEXED_NULL;
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateDelete(std::uint32_t root)
+{
+    std::uint32_t x = INDEXED_NULL;
+    std::uint32_t xParent = INDEXED_NULL;
+    std::uint32_t w = INDEXED_NULL;
+    std::uint32_t replacementNode = INDEXED_NULL;
+    Color deletedColor;
+    Color replacementColor;
+
+    // case that root is leaf or has only one child.
+    if(at(root).left == INDEXED_NULL || at(root).right == INDEXED_NULL)
+    {
+        xParent = at(root).parent;
+        x = at(root).left != INDEXED_NULL ? at(root).left : at(root).right;
+        replacementNode = x;
+        deletedColor = at(root).color;
+        replacementColor = x != INDEXED_NULL ? at(x).color : Color::black;
+
+        privateDeleteBST(root);
+
+        if(x != INDEXED_NULL && deletedColor == Color::black && replacementColor == Color::red)
+            at(x).color = Color::black;
+
+        destroyLeaf(root);
+    }
+    // else its two children
+    else
+    {
+        std::uint32_t successor = privateFindSmallest(at(root).right);
+        x = at(successor).right;
+        deletedColor = at(root).color;
+        replacementColor = at(successor).color;
+
+        at(root).key = at(successor).key;
+        at(root).data = at(successor).data;
+        at(root).color = at(successor).color;
+
+        replacementNode = root;
+
+        xParent = at(successor).parent;
+        privateDeleteBST(successor);
+        destroyLeaf(successor);
+    }
+
+    // Set W now since we're beyond delete.
+    if(xParent != INDEXED_NULL)
+        w = at(xParent).left == x ? at(xParent).right : at(xParent).left;
+
+    // Deleted red and replacement red or nothing: done.
+    if((replacementNode == INDEXED_NULL || replacementColor == Color::red) && deletedColor == Color::red)
+    {
+        return;
+    }
+    // Deleted black and replacement red: done.
+    else if(deletedColor == Color::black && replacementColor == Color::red)
+    {
+        at(replacementNode).color = Color::black;
+        return;
+    }
+
+    // Deleted red and replacement black, color the replacement red first.
+    if(deletedColor == Color::red && replacementColor == Color::black)
+        at(replacementNode).color = Color::red;
+
+    if(privateCheckCaseZero(x))
+        privateCaseZero(x);
+    else if(privateCheckCaseOne(x, w))
+        privateCaseOne(x, w, xParent);
+    else if(privateCheckCaseTwo(x, w))
+        privateCaseTwo(x, w, xParent);
+    else if(privateCheckCaseThree(x, w, xParent))
+        privateCaseThree(x, w, xParent);
+    else if(privateCheckCaseFour(x, w, xParent))
+        privateCaseFour(x, w, xParent);
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::remove(kType key)
+{
+    std::uint32_t node = privateSearch(key);
+
+    if(node == INDEXED_NULL)
+        return false;
+
+    privateDelete(node);
+    this->totalNodes--;
+    return true;
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateLeftRotate(std::uint32_t root)
+{
+    std::uint32_t pivot = at(root).right;
+
+    if(pivot != INDEXED_NULL)
+    {
+        std::uint32_t parent = at(root).parent;
+
+        at(root).right = at(pivot).left;
+
+        if(at(pivot).left != INDEXED_NULL)
+            at(at(pivot).left).parent = root;
+
+        at(pivot).left = root;
+        at(pivot).parent = parent;
+
+        if(parent != INDEXED_NULL && at(parent).left == root)
+            at(parent).left = pivot;
+        else if(parent != INDEXED_NULL && at(parent).right == root)
+            at(parent).right = pivot;
+
+        at(root).parent = pivot;
+
+        if(this->root == root)
+        {
+            this->root = pivot;
+        }
+    }
+}
+
+template<typename kType, typename dType>
+void IndexedRedBlackTree<kType, dType>::privateRightRotate(std::uint32_t root)
+{
+    std::uint32_t pivot = at(root).left;
+
+    if(pivot != INDEXED_NULL)
+    {
+        std::uint32_t parent = at(root).parent;
+
+        at(root).left = at(pivot).right;
+
+        if(at(pivot).right != INDEXED_NULL)
+            at(at(pivot).right).parent = root;
+
+        at(pivot).right = root;
+        at(pivot).parent = parent;
+
+        if(parent != INDEXED_NULL && at(parent).left == root)
+            at(parent).left = pivot;
+        else if(parent != INDEXED_NULL && at(parent).right == root)
+            at(parent).right = pivot;
+
+        at(root).parent = pivot;
+
+        if(this->root == root)
+        {
+            this->root = pivot;
+        }
+    }
+}
+
+template<typename kType, typename dType>
+std::uint32_t IndexedRedBlackTree<kType, dType>::privateFindSmallest(std::uint32_t root) const
+{
+    while(at(root).left != INDEXED_NULL)
+        root = at(root).left;
+
+    return root;
+}
+
+template<typename kType, typename dType>
+std::uint32_t IndexedRedBlackTree<kType, dType>::privateSearch(const kType& key) const
+{
+    std::uint32_t current = this->root;
+
+    while(current != INDEXED_NULL && !(at(current).key == key))
+        current = at(current).key < key ? at(current).right : at(current).left;
+
+    return current;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::search(const kType& sKey, dType* dataPtr) const
+{
+    std::uint32_t result = privateSearch(sKey);
+
+    if(result == INDEXED_NULL)
+        return false;
+
+    *dataPtr = at(result).data;
+    return true;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::privateIsValid(std::uint32_t root, std::uint32_t low, std::uint32_t high, unsigned& blackHeight, unsigned long long& count) const
+{
+    blackHeight = 0;
+    count = 0;
+    if(root == INDEXED_NULL)
+        return true;
+
+    if((low != INDEXED_NULL && !(at(low).key < at(root).key)) || (high != INDEXED_NULL && !(at(root).key < at(high).key)))
+        return false;
+
+    for(std::uint32_t child : {at(root).left, at(root).right})
+    {
+        if(child != INDEXED_NULL && (at(child).parent != root || (at(root).color == Color::red && at(child).color == Color::red)))
+            return false;
+    }
+
+    unsigned leftHeight = 0;
+    unsigned rightHeight = 0;
+    unsigned long long leftCount = 0;
+    unsigned long long rightCount = 0;
+    if(!privateIsValid(at(root).left, low, root, leftHeight, leftCount) || !privateIsValid(at(root).right, root, high, rightHeight, rightCount) || leftHeight != rightHeight)
+        return false;
+
+    count = leftCount + rightCount + 1;
+    blackHeight = leftHeight + (at(root).color == Color::black ? 1 : 0);
+    return true;
+}
+
+template<typename kType, typename dType>
+bool IndexedRedBlackTree<kType, dType>::isValid() const
+{
+    if(this->root != INDEXED_NULL && (at(this->root).parent != INDEXED_NULL || at(this->root).color != Color::black))
+        return false;
+
+    unsigned blackHeight = 0;
+    unsigned long long count = 0;
+    return privateIsValid(this->root, INDEXED_NULL, INDEXED_NULL, blackHeight, count) && count == this->totalNodes;
+}
+
+#endif //REDBLACKTREE_INDEXEDREDBLACKTREE_H
@@ -0,0 +1,815 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifndef REDBLACKTREE_NODEPOOL_H
+#define REDBLACKTREE_NODEPOOL_H
+
+/**
+ * \brief       Fixed size block allocator the tree carves its nodes out of.
+ *
+ * \details     Instead of going to the global allocator for every node, the
+ *          pool grabs large chunks and hands out equally sized blocks from
+ *          them. Blocks given back with deallocate are reused before a new
+ *          chunk is touched, and a chunk goes back to the system as soon as
+ *          none of its blocks is in use any more.
+ *
+ *          A chunk is made of pages of getPageSize bytes, each aligned to
+ *          its size and starting with a pointer to its chunk, so any block
+ *          finds the chunk it came from. Chunks start at one page and double
+ *          up to MAX_PAGES_PER_CHUNK, so small trees don't pay for a huge
+ *          chunk. Every chunk counts its own blocks in use and keeps its own
+ *          free list.
+ *
+ *          A block may be given back through any pool of the same block
+ *          size, not only the one that handed it out. That is how a tree
+ *          splits into two without moving nodes: the half that gets a new
+ *          pool frees the blocks it took along into their chunk's remote
+ *          list, an atomic stack the owning pool takes them from later.
+ *          Once one half is dropped, every chunk only it used goes away:
+ *          at once if the pool owning it was dropped too, on the owner's
+ *          next allocation otherwise.
+ *
+ * \note        A pool is not thread safe. One pool per tree. Pools whose
+ *          blocks went into one tree may be used from different threads.
+ */
+class NodePool
+{
+private:
+    /**
+     * Overlay used for blocks sitting on a free list.
+     */
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    static constexpr std::size_t MIN_PAGE_SIZE = 4096;
+    static constexpr std::size_t MIN_BLOCKS_PER_PAGE = 32;
+    static constexpr std::size_t MAX_PAGES_PER_CHUNK = 64;
+
+    /**
+     * Room the chunk pointer takes at the start of every page.
+     */
+    static constexpr std::size_t PAGE_HEADER = alignof(std::max_align_t) > sizeof(void*) ? alignof(std::max_align_t) : sizeof(void*);
+
+    /**
+     * Identity of a pool that outlives moves and merges, so chunks can tell
+     * whether a block comes home or is freed from somewhere else. Held once
+     * by the pool it belongs to and once by every chunk created under it;
+     * the last one to let go deletes it.
+     */
+    struct Owner
+    {
+        std::atomic<NodePool*> pool;
+        std::atomic<std::size_t> holders{1};
+        std::atomic<std::size_t> remoteFrees{0};
+
+        explicit Owner(NodePool* pool) : pool(pool) {}
+    };
+
+    /**
+     * Bookkeeping of one allocation blocks are carved out of. live and the
+     * lists are only touched by the owning pool; other pools only push onto
+     * remoteFree and count up remoteFreed. Blocks in use are live minus
+     * remoteFreed. Once no pool owns the chunk, remoteFreed is pushed below
+     * zero by live, and whoever brings it back to zero frees the chunk.
+     */
+    struct Chunk
+    {
+        unsigned char* memory;
+        std::size_t bytes;
+        std::size_t pageSize;
+        Owner* owner;
+
+        std::atomic<FreeBlock*> remoteFree{nullptr};
+        std::atomic<std::ptrdiff_t> remoteFreed{0};
+
+        FreeBlock* localFree = nullptr;
+        unsigned char* cursor = nullptr;
+        unsigned char* pageEnd = nullptr;
+        std::size_t live = 0;
+
+        Chunk* prev = nullptr;
+        Chunk* next = nullptr;
+        Chunk* prevAvailable = nullptr;
+        Chunk* nextAvailable = nullptr;
+        bool available = false;
+    };
+
+    Owner* owner = nullptr;
+    std::vector<Owner*> adopted;
+    Chunk* chunks = nullptr;
+    Chunk* availableChunks = nullptr;
+    Chunk* current = nullptr;
+    std::size_t blockSize = 0;
+    std::size_t pageSize = 0;
+    std::size_t blocksPerPage = 0;
+    std::size_t nextChunkPages = 1;
+    std::size_t reservedBytes = 0;
+    std::size_t remoteSeen = 0;
+    std::size_t opsToScan = 0;
+
+    /**
+     * \brief       Rounds a requested size up so every block stays aligned
+     *          for any node type and can hold a FreeBlock.
+     */
+    static std::size_t privateRoundBlockSize(std::size_t bytes);
+
+    /**
+     * \brief       Picks blockSize and the page size that goes with it.
+     */
+    void privateSetBlockSize(std::size_t bytes);
+
+    /**
+     * \brief       Chunk of the page block lies in.
+     */
+    Chunk* privateChunkOf(void* block) const;
+
+    /**
+     * \brief       Allocates a chunk of pages pages, links it into chunks
+     *          and writes the chunk pointer at the start of every page.
+     */
+    Chunk* privateNewChunk(std::size_t pages);
+
+    /**
+     * \brief       Unlinks chunk, which has no block in use, and frees it.
+     */
+    void privateReleaseChunk(Chunk* chunk);
+
+    /**
+     * \brief       Frees chunk and lets go of its owner. Called once no
+     *          pool lists the chunk and nothing in it is in use.
+     */
+    static void privateFreeChunk(Chunk* chunk);
+
+    /**
+     * \brief       Lets go of one hold on owner, deleting it with the last.
+     */
+    static void privateDropOwner(Owner* owner);
+
+    /**
+     * \brief       Moves blocks other pools gave back into chunk's own free
+     *          list.
+     */
+    static void privateCollectRemote(Chunk* chunk);
+
+    /**
+     * \brief       True if chunk has a block left to hand out.
+     */
+    static bool privateHasRoom(const Chunk* chunk);
+
+    void privateMakeAvailable(Chunk* chunk);
+    void privateMakeUnavailable(Chunk* chunk);
+
+    /**
+     * \brief       Takes the block at chunk's cursor and moves the cursor
+     *          on, skipping the header of the next page.
+     */
+    void* privateBump(Chunk* chunk);
+
+    /**
+     * \brief       Allocates once the current chunk is out of blocks.
+     */
+    void* privateAllocateSlow();
+
+    /**
+     * \brief       Goes over every chunk once enough blocks were given back
+     *          through other pools, releasing those left empty. Amortized
+     *          O(1) per block given back. Checked every blocksPerPage
+     *          allocations and frees.
+     */
+    void privateScanIfDue();
+
+    /**
+     * \brief       Hands every chunk to nobody and frees those with nothing
+     *          in use. The pool is left empty.
+     */
+    void privateAbandon();
+public:
+    /**
+     * \brief       Run of blocks for building a whole tree at once, from
+     *          allocateRun. Block i lies in page i / perPage.
+     */
+    struct Run
+    {
+        std::vector<unsigned char*> pages;
+        std::size_t perPage = 0;
+        std::size_t blockSize = 0;
+
+        void* operator[](std::size_t i) const {return this->pages[i / this->perPage] + i % this->perPage * this->blockSize;}
+    };
+
+    /**
+     * \brief       Constructs an empty pool.
+     *
+     * @param blockSize Size in bytes of every block. If 0, the size of the
+     *          first allocation decides it.
+     */
+    explicit NodePool(std::size_t blockSize = 0);
+    ~NodePool();
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    /**
+     * \brief       Takes over every chunk of other. Blocks handed out by
+     *          other stay valid and now belong to this pool.
+     */
+    NodePool(NodePool&& other) noexcept;
+    NodePool& operator=(NodePool&& other) noexcept;
+
+    /**
+     * \brief       Returns a block of at least bytes size. Requests larger
+     *          than the block size fall back to the global allocator.
+     *
+     * @param bytes Size of the object going into the block.
+     * @return Pointer to uninitialized storage.
+     */
+    void* allocate(std::size_t bytes);
+
+    /**
+     * \brief       Returns count blocks in chunks of their own, in order,
+     *          e.g. for building a whole tree at once. Each block can later
+     *          be given back with deallocate on its own.
+     *
+     * @param count Number of blocks. The block size must be set already.
+     */
+    Run allocateRun(std::size_t count);
+
+    /**
+     * \brief       Gives back the first count blocks of run, with nothing
+     *          constructed in them.
+     */
+    void deallocateRun(const Run& run, std::size_t count);
+
+    /**
+     * \brief       Gives a block back. If this pool doesn't own the block's
+     *          chunk, it goes on the chunk's remote list.
+     *
+     * @param block Block previously returned by allocate of this or any
+     *          pool of the same block size.
+     * @param bytes Same size that was passed to allocate.
+     */
+    void deallocate(void* block, std::size_t bytes);
+
+    /**
+     * \brief       Takes over the chunks and free blocks of other, which is
+     *          left empty. Both pools may have handed out blocks; all of them
+     *          now belong to this pool.
+     *
+     * @param other Pool with the same block size.
+     */
+    void merge(NodePool&& other);
+
+    /**
+     * \brief       Drops every chunk, as if the pool was new. Only once no
+     *          block handed out by this pool is in use through it any more;
+     *          chunks still holding blocks of other trees go away with the
+     *          last of those.
+     */
+    void reset();
+
+    /**
+     * \brief       Gives back the chunk blocks are currently handed out
+     *          from too if none of its blocks is in use. Every other chunk
+     *          goes as soon as it empties anyway.
+     */
+    void trim();
+
+    std::size_t getBlockSize() const {return this->blockSize;}
+    std::size_t getPageSize() const {return this->pageSize;}
+
+    /**
+     * \brief       Bytes of all chunks owned, whether handed out or free.
+     */
+    std::size_t getReservedBytes() const {return this->reservedBytes;}
+};
+
+inline NodePool::NodePool(std::size_t blockSize)
+{
+    if(blockSize != 0)
+        privateSetBlockSize(blockSize);
+}
+
+inline NodePool::~NodePool()
+{
+    privateAbandon();
+}
+
+inline NodePool::NodePool(NodePool&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+inline NodePool& NodePool::operator=(NodePool&& other) noexcept
+{
+    if(this != &other)
+    {
+        privateAbandon();
+
+        this->owner = other.owner;
+        this->adopted = std::move(other.adopted);
+        this->chunks = other.chunks;
+        this->availableChunks = other.availableChunks;
+        this->current = other.current;
+        this->blockSize = other.blockSize;
+        this->pageSize = other.pageSize;
+        this->blocksPerPage = other.blocksPerPage;
+        this->nextChunkPages = other.nextChunkPages;
+        this->reservedBytes = other.reservedBytes;
+        this->remoteSeen = other.remoteSeen;
+        this->opsToScan = other.opsToScan;
+
+        if(this->owner != nullptr)
+            this->owner->pool.store(this, std::memory_order_relaxed);
+        for(Owner* taken : this->adopted)
+            taken->pool.store(this, std::memory_order_relaxed);
+
+        other.owner = nullptr;
+        other.adopted.clear();
+        other.chunks = nullptr;
+        other.availableChunks = nullptr;
+        other.current = nullptr;
+        other.nextChunkPages = 1;
+        other.reservedBytes = 0;
+        other.remoteSeen = 0;
+        other.opsToScan = 0;
+    }
+    return *this;
+}
+
+inline std::size_t NodePool::privateRoundBlockSize(std::size_t bytes)
+{
+    const std::size_t align = alignof(std::max_align_t);
+
+    if(bytes < sizeof(FreeBlock))
+        bytes = sizeof(FreeBlock);
+
+    return (bytes + align - 1) / align * align;
+}
+
+inline void NodePool::privateSetBlockSize(std::size_t bytes)
+{
+    this->blockSize = privateRoundBlockSize(bytes);
+    this->pageSize = std::bit_ceil(std::max(MIN_PAGE_SIZE, PAGE_HEADER + MIN_BLOCKS_PER_PAGE * this->blockSize));
+    this->blocksPerPage = (this->pageSize - PAGE_HEADER) / this->blockSize;
+}
+
+inline NodePool::Chunk* NodePool::privateChunkOf(void* block) const
+{
+    auto page = reinterpret_cast<std::uintptr_t>(block) & ~(std::uintptr_t)(this->pageSize - 1);
+    return *reinterpret_cast<Chunk**>(page);
+}
+
+inline NodePool::Chunk* NodePool::privateNewChunk(std::size_t pages)
+{
+    if(this->owner == nullptr)
+        this->owner = new Owner(this);
+
+    const std::size_t bytes = pages * this->pageSize;
+    auto chunk = new Chunk;
+    try {
+        chunk->memory = static_cast<unsigned char*>(::operator new(bytes, std::align_val_t(this->pageSize)));
+    }
+    catch(...) {
+        delete chunk;
+        throw;
+    }
+
+    chunk->bytes = bytes;
+    chunk->pageSize = this->pageSize;
+    chunk->owner = this->owner;
+    this->owner->holders.fetch_add(1, std::memory_order_relaxed);
+
+    for(std::size_t page = 0; page < pages; page++)
+        *reinterpret_cast<Chunk**>(chunk->memory + page * this->pageSize) = chunk;
+    chunk->cursor = chunk->memory + PAGE_HEADER;
+    chunk->pageEnd = chunk->memory + this->pageSize;
+
+    chunk->next = this->chunks;
+    if(this->chunks != nullptr)
+        this->chunks->prev = chunk;
+    this->chunks = chunk;
+    this->reservedBytes += bytes;
+    return chunk;
+}
+
+inline void NodePool::privateFreeChunk(Chunk* chunk)
+{
+    Owner* chunkOwner = chunk->owner;
+    ::operator delete(chunk->memory, std::align_val_t(chunk->pageSize));
+    delete chunk;
+    privateDropOwner(chunkOwner);
+}
+
+inline void NodePool::privateDropOwner(Owner* owner)
+{
+    if(owner->holders.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete owner;
+}
+
+inline void NodePool::privateReleaseChunk(Chunk* chunk)
+{
+    privateMakeUnavailable(chunk);
+    if(chunk->prev != nullptr)
+        chunk->prev->next = chunk->next;
+    else
+        this->chunks = chunk->next;
+    if(chunk->next != nullptr)
+        chunk->next->prev = chunk->prev;
+    if(this->current == chunk)
+        this->current = nullptr;
+
+    this->reservedBytes -= chunk->bytes;
+    privateFreeChunk(chunk);
+}
+
+inline void NodePool::privateCollectRemote(Chunk* chunk)
+{
+    if(chunk->remoteFree.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    // Count first: a block is pushed before it is counted, so every block
+    // counted here is on the list taken below.
+    chunk->live -= (std::size_t)chunk->remoteFreed.exchange(0, std::memory_order_acq_rel);
+    FreeBlock* taken = chunk->remoteFree.exchange(nullptr, std::memory_order_acquire);
+
+    while(taken != nullptr)
+    {
+        FreeBlock* next = taken->next;
+        taken->next = chunk->localFree;
+        chunk->localFree = taken;
+        taken = next;
+    }
+}
+
+inline bool NodePool::privateHasRoom(const Chunk* chunk)
+{
+    return chunk->localFree != nullptr || chunk->cursor != nullptr;
+}
+
+inline void NodePool::privateMakeAvailable(Chunk* chunk)
+{
+    if(chunk->available)
+        return;
+
+    chunk->available = true;
+    chunk->prevAvailable = nullptr;
+    chunk->nextAvailable = this->availableChunks;
+    if(this->availableChunks != nullptr)
+        this->availableChunks->prevAvailable = chunk;
+    this->availableChunks = chunk;
+}
+
+inline void NodePool::privateMakeUnavailable(Chunk* chunk)
+{
+    if(!chunk->available)
+        return;
+
+    chunk->available = false;
+    if(chunk->prevAvailable != nullptr)
+        chunk->prevAvailable->nextAvailable = chunk->nextAvailable;
+    else
+        this->availableChunks = chunk->nextAvailable;
+    if(chunk->nextAvailable != nullptr)
+        chunk->nextAvailable->prevAvailable = chunk->prevAvailable;
+}
+
+inline void* NodePool::privateBump(Chunk* chunk)
+{
+    void* block = chunk->cursor;
+    chunk->cursor += this->blockSize;
+
+    if(chunk->cursor + this->blockSize > chunk->pageEnd)
+    {
+        if(chunk->pageEnd == chunk->memory + chunk->bytes)
+            chunk->cursor = nullptr;
+        else
+        {
+            chunk->cursor = chunk->pageEnd + PAGE_HEADER;
+            chunk->pageEnd += this->pageSize;
+        }
+    }
+
+    chunk->live++;
+    return block;
+}
+
+inline void* NodePool::allocate(std::size_t bytes)
+{
+    if(this->blockSize == 0)
+        privateSetBlockSize(bytes);
+    else if(bytes > this->blockSize)
+        return ::operator new(bytes);
+
+    if(++this->opsToScan >= this->blocksPerPage)
+        privateScanIfDue();
+
+    Chunk* chunk = this->current;
+    if(chunk != nullptr)
+    {
+        // Reuse a freed block first.
+        if(chunk->localFree != nullptr)
+        {
+            FreeBlock* block = chunk->localFree;
+            chunk->localFree = block->next;
+            chunk->live++;
+            return block;
+        }
+
+        if(chunk->cursor != nullptr)
+            return privateBump(chunk);
+    }
+
+    return privateAllocateSlow();
+}
+
+inline void* NodePool::privateAllocateSlow()
+{
+    if(this->current != nullptr)
+    {
+        privateCollectRemote(this->current);
+        if(privateHasRoom(this->current))
+            return allocate(this->blockSize);
+    }
+
+    privateScanIfDue();
+
+    while(this->availableChunks != nullptr)
+    {
+        Chunk* chunk = this->availableChunks;
+        privateMakeUnavailable(chunk);
+        privateCollectRemote(chunk);
+        if(privateHasRoom(chunk))
+        {
+            this->current = chunk;
+            return allocate(this->blockSize);
+        }
+    }
+
+    this->current = privateNewChunk(this->nextChunkPages);
+    if(this->nextChunkPages < MAX_PAGES_PER_CHUNK)
+        this->nextChunkPages *= 2;
+
+    return privateBump(this->current);
+}
+
+inline NodePool::Run NodePool::allocateRun(std::size_t count)
+{
+    Run run;
+    run.perPage = this->blocksPerPage;
+    run.blockSize = this->blockSize;
+
+    if(count == 0)
+        return run;
+
+    const std::size_t pages = (count + this->blocksPerPage - 1) / this->blocksPerPage;
+    run.pages.reserve(pages);
+
+    // Whole chunks of their own, so the current chunk keeps its cursor and
+    // nothing left in it is lost.
+    try {
+        for(std::size_t page = 0; page < pages; page += MAX_PAGES_PER_CHUNK)
+        {
+            const std::size_t chunkPages = std::min(MAX_PAGES_PER_CHUNK, pages - page);
+            const std::size_t blocks = std::min(count - page * this->blocksPerPage, chunkPages * this->blocksPerPage);
+            Chunk* chunk = privateNewChunk(chunkPages);
+
+            for(std::size_t i = 0; i < chunkPages; i++)
+                run.pages.push_back(chunk->memory + i * this->pageSize + PAGE_HEADER);
+
+            chunk->live = blocks;
+            const std::size_t lastPage = (blocks - 1) / this->blocksPerPage;
+            const std::size_t usedInLast = blocks - lastPage * this->blocksPerPage;
+            if(usedInLast < this->blocksPerPage)
+            {
+                chunk->cursor = chunk->memory + lastPage * this->pageSize + PAGE_HEADER + usedInLast * this->blockSize;
+                chunk->pageEnd = chunk->memory + (lastPage + 1) * this->pageSize;
+            }
+            else if(lastPage + 1 < chunkPages)
+            {
+                chunk->cursor = chunk->memory + (lastPage + 1) * this->pageSize + PAGE_HEADER;
+                chunk->pageEnd = chunk->memory + (lastPage + 2) * this->pageSize;
+            }
+            else
+                chunk->cursor = nullptr;
+
+            if(chunk->cursor != nullptr)
+                privateMakeAvailable(chunk);
+        }
+    }
+    catch(...) {
+        deallocateRun(run, std::min(count, run.pages.size() * this->blocksPerPage));
+        throw;
+    }
+
+    return run;
+}
+
+inline void NodePool::deallocateRun(const Run& run, std::size_t count)
+{
+    for(std::size_t i = 0; i < count; i++)
+        deallocate(run[i], this->blockSize);
+}
+
+inline void NodePool::deallocate(void* block, std::size_t bytes)
+{
+    if(block == nullptr)
+        return;
+
+    if(bytes > this->blockSize)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    Chunk* chunk = privateChunkOf(block);
+    auto freeBlock = static_cast<FreeBlock*>(block);
+
+    if(chunk->owner->pool.load(std::memory_order_relaxed) == this)
+    {
+        freeBlock->next = chunk->localFree;
+        chunk->localFree = freeBlock;
+        chunk->live--;
+
+        if(chunk != this->current)
+        {
+            if(chunk->live == (std::size_t)chunk->remoteFreed.load(std::memory_order_acquire))
+                privateReleaseChunk(chunk);
+            else
+                privateMakeAvailable(chunk);
+        }
+
+        if(++this->opsToScan >= this->blocksPerPage)
+            privateScanIfDue();
+        return;
+    }
+
+    // Not ours: the owner, if any, picks it up later. Nothing of the chunk
+    // may be touched after remoteFreed is counted up, it may be gone then.
+    chunk->owner->remoteFrees.fetch_add(1, std::memory_order_relaxed);
+
+    FreeBlock* head = chunk->remoteFree.load(std::memory_order_relaxed);
+    do {
+        freeBlock->next = head;
+    } while(!chunk->remoteFree.compare_exchange_weak(head, freeBlock, std::memory_order_release, std::memory_order_relaxed));
+
+    if(chunk->remoteFreed.fetch_add(1, std::memory_order_acq_rel) == -1)
+        privateFreeChunk(chunk);
+}
+
+inline void NodePool::privateScanIfDue()
+{
+    this->opsToScan = 0;
+
+    std::size_t remoteFrees = this->owner != nullptr ? this->owner->remoteFrees.load(std::memory_order_relaxed) : 0;
+    for(Owner* taken : this->adopted)
+        remoteFrees += taken->remoteFrees.load(std::memory_order_relaxed);
+
+    std::size_t chunkCount = this->reservedBytes / this->pageSize;
+    if(remoteFrees - this->remoteSeen < std::max(this->blocksPerPage, chunkCount))
+        return;
+    this->remoteSeen = remoteFrees;
+
+    for(Chunk* chunk = this->chunks; chunk != nullptr;)
+    {
+        Chunk* next = chunk->next;
+        if(chunk != this->current)
+        {
+            privateCollectRemote(chunk);
+            if(chunk->live == (std::size_t)chunk->remoteFreed.load(std::memory_order_acquire))
+                privateReleaseChunk(chunk);
+            else if(privateHasRoom(chunk))
+                privateMakeAvailable(chunk);
+        }
+        chunk = next;
+    }
+}
+
+inline void NodePool::merge(NodePool&& other)
+{
+    if(this == &other)
+        return;
+
+    if(this->blockSize == 0)
+    {
+        this->blockSize = other.blockSize;
+        this->pageSize = other.pageSize;
+        this->blocksPerPage = other.blocksPerPage;
+    }
+
+    // Other's chunks keep pointing at its owners, which now stand for this
+    // pool. Owners no chunk points at any more are let go.
+    std::size_t remoteFrees = 0;
+    auto adopt = [this, &remoteFrees](Owner* taken) {
+        if(taken->holders.load(std::memory_order_acquire) == 1)
+        {
+            delete taken;
+            return;
+        }
+        taken->pool.store(this, std::memory_order_relaxed);
+        remoteFrees += taken->remoteFrees.load(std::memory_order_relaxed);
+        this->adopted.push_back(taken);
+    };
+
+    std::vector<Owner*> owners = std::move(this->adopted);
+    this->adopted.clear();
+    this->adopted.reserve(owners.size() + other.adopted.size() + 1);
+    for(Owner* taken : owners)
+        adopt(taken);
+    for(Owner* taken : other.adopted)
+        adopt(taken);
+    if(other.owner != nullptr)
+        adopt(other.owner);
+    if(this->owner != nullptr)
+        remoteFrees += this->owner->remoteFrees.load(std::memory_order_relaxed);
+    this->remoteSeen = remoteFrees;
+
+    while(other.chunks != nullptr)
+    {
+        Chunk* chunk = other.chunks;
+        other.chunks = chunk->next;
+        chunk->prev = nullptr;
+        chunk->next = this->chunks;
+        if(this->chunks != nullptr)
+            this->chunks->prev = chunk;
+        this->chunks = chunk;
+
+        this->reservedBytes += chunk->bytes;
+
+        // Other's current chunk may be empty, and nothing frees it later.
+        chunk->available = false;
+        privateCollectRemote(chunk);
+        if(chunk->live == (std::size_t)chunk->remoteFreed.load(std::memory_order_acquire))
+            privateReleaseChunk(chunk);
+        else if(privateHasRoom(chunk))
+            privateMakeAvailable(chunk);
+    }
+
+    other.owner = nullptr;
+    other.adopted.clear();
+    other.availableChunks = nullptr;
+    other.current = nullptr;
+    other.nextChunkPages = 1;
+    other.reservedBytes = 0;
+    other.remoteSeen = 0;
+    other.opsToScan = 0;
+}
+
+inline void NodePool::privateAbandon()
+{
+    while(this->chunks != nullptr)
+    {
+        Chunk* chunk = this->chunks;
+        this->chunks = chunk->next;
+
+        // Blocks of other trees may still be in use; the last of them to
+        // be freed brings remoteFreed back to zero.
+        const auto live = (std::ptrdiff_t)chunk->live;
+        if(chunk->remoteFreed.fetch_sub(live, std::memory_order_acq_rel) == live)
+            privateFreeChunk(chunk);
+    }
+
+    if(this->owner != nullptr)
+    {
+        this->owner->pool.store(nullptr, std::memory_order_relaxed);
+        privateDropOwner(this->owner);
+    }
+    for(Owner* taken : this->adopted)
+    {
+        taken->pool.store(nullptr, std::memory_order_relaxed);
+        privateDropOwner(taken);
+    }
+
+    this->owner = nullptr;
+    this->adopted.clear();
+    this->availableChunks = nullptr;
+    this->current = nullptr;
+    this->nextChunkPages = 1;
+    this->reservedBytes = 0;
+    this->remoteSeen = 0;
+    this->opsToScan = 0;
+}
+
+inline void NodePool::reset()
+{
+    privateAbandon();
+}
+
+inline void NodePool::trim()
+{
+    if(this->current == nullptr)
+        return;
+
+    privateCollectRemote(this->current);
+    if(this->current->live == (std::size_t)this->current->remoteFreed.load(std::memory_order_acquire))
+        privateReleaseChunk(this->current);
+}
+
+#endif //REDBLACKTREE_NODEPOOL_H
@@ -0,0 +1,597 @@
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "RedBlackTree.h"
+
+#ifndef REDBLACKTREE_PERSISTENTREDBLACKTREE_H
+#define REDBLACKTREE_PERSISTENTREDBLACKTREE_H
+
+/**
+ * \brief       Node of a PersistentRedBlackTree. Nodes are shared between
+ *          versions and never change once a version holds them, so there is
+ *          no parent link; child[0] is the left child, child[1] the right.
+ *
+ * @tparam kType Key value type.
+ * @tparam dType Data value type.
+ */
+template <typename kType, typename dType>
+class PersistentNode
+{
+public:
+    kType key;
+    dType data;
+    std::shared_ptr<const PersistentNode> child[2];
+    Color color = Color::red;
+
+    PersistentNode(kType key, dType data) : key(std::move(key)), data(std::move(data)) {}
+};
+
+/**
+ * \brief       Red black tree whose versions share structure, so copying one
+ *          is O(1) and an old copy stays readable while the new one changes.
+ *
+ * \details     insert and remove never touch a node in place. They copy the
+ *          nodes on the root-to-leaf path (plus the odd sibling the fix-up
+ *          recolors), O(log n) of them, and link the copies to the untouched
+ *          subtrees. A copy of the tree, or snapshot(), just shares the root
+ *          and keeps seeing the entries it had when it was taken. Nodes are
+ *          reference counted, so a node is freed once the last version
+ *          reaching it is gone.
+ *
+ *          Separate tree objects may be used from separate threads, even
+ *          when they share nodes: a writer can keep updating its tree while
+ *          readers walk snapshots it handed out. A single tree object is no
+ *          more thread safe than a RedBlackTree; take the snapshot on the
+ *          writer's thread.
+ *
+ *          Every path copy copies keys and data, so keep them cheap to copy
+ *          (or make dType a shared_ptr) for large values.
+ *
+ * @tparam kType Key value type.
+ * @tparam dType Data value type.
+ * @tparam Compare Ordering of the keys, as for RedBlackTree.
+ */
+template<typename kType, typename dType, typename Compare = DefaultCompare<kType>>
+class PersistentRedBlackTree
+{
+private:
+    using Link = std::shared_ptr<const PersistentNode<kType, dType>>;
+
+    /**
+     * Node copied by the current operation, not yet shared with any other
+     * version, so still safe to change.
+     */
+    using Copy = std::shared_ptr<PersistentNode<kType, dType>>;
+
+    /**
+     * True if comp returns an ordering instead of a bool.
+     */
+    static constexpr bool THREE_WAY = !std::is_convertible_v<std::invoke_result_t<const Compare&, const kType&, const kType&>, bool>;
+
+    /**
+     * Key ordering, takes no space when the comparator is empty.
+     */
+    [[no_unique_address]] Compare comp;
+
+    /**
+     * top root of the tree
+     */
+    Link root;
+
+    /**
+     * counter for totalNodes. Increments/decrements on insert/remove success.
+     */
+    unsigned long long totalNodes = 0;
+
+    /**
+     * \brief       Negative if a < b, zero if equal, positive if a > b.
+     *          One comparison for three-way comparators, two for bool ones.
+     */
+    int privateCompare(const kType& a, const kType& b) const;
+
+    /**
+     * \brief       Null safe color test, null nodes are black.
+     */
+    static bool privateIsRed(const Link& node);
+
+    /**
+     * \brief       Private copy of node the current operation may change.
+     */
+    static Copy privateCopy(const Link& node);
+
+    /**
+     * \brief       Rotates top towards dir (0 left, 1 right), pivot being
+     *          top->child[!dir]. Both must be copies. The caller hangs pivot
+     *          where top was.
+     */
+    static void privateRotate(const Copy& top, const Copy& pivot, bool dir);
+
+    /**
+     * \brief       Hangs node in the slot of path[k]: the root for k == 0,
+     *          else the dirs[k - 1] child of path[k - 1].
+     */
+    void privateAttach(const std::vector<Copy>& path, const std::vector<bool>& dirs, std::size_t k, Link node);
+
+public:
+    /**
+     * \brief       Forward iterator over the entries in key order.
+     *
+     * \details     Nodes have no parent link, so the iterator carries the
+     *          stack of ancestors still to visit, O(log n) of them. A full
+     *          walk is O(1) amortized per step. The iterator reads the
+     *          version it came from, which has to stay alive and unchanged;
+     *          iterate a snapshot to keep writing meanwhile.
+     */
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<kType, dType>;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::pair<const kType&, const dType&>;
+
+        /**
+         * Holds the reference pair so operator-> has something to point at.
+         */
+        class pointer
+        {
+        public:
+            explicit pointer(reference entry) : entry(entry) {}
+            const reference* operator->() const {return &this->entry;}
+        private:
+            reference entry;
+        };
+
+        const_iterator() = default;
+
+        reference operator*() const {return reference(this->stack.back()->key, this->stack.back()->data);}
+        pointer operator->() const {return pointer(**this);}
+
+        const_iterator& operator++()
+        {
+            const PersistentNode<kType, dType>* node = this->stack.back();
+            this->stack.pop_back();
+            pushLeftSpine(node->child[1].get());
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b)
+        {
+            return (a.stack.empty() ? nullptr : a.stack.back()) == (b.stack.empty() ? nullptr : b.stack.back());
+        }
+
+    private:
+        friend class PersistentRedBlackTree;
+
+        void pushLeftSpine(const PersistentNode<kType, dType>* node)
+        {
+            for(; node != nullptr; node = node->child[0].get())
+                this->stack.push_back(node);
+        }
+
+        /**
+         * Top is the current node, below it the ancestors whose turn
+         * comes after it.
+         */
+        std::vector<const PersistentNode<kType, dType>*> stack;
+    };
+
+    using iterator = const_iterator;
+
+    /**
+     * \brief       Constructs an empty tree.
+     */
+    PersistentRedBlackTree() = default;
+
+    /**
+     * \brief       Constructs an empty tree ordered by comp.
+     *
+     * @param comp Comparator instance used for every key comparison.
+     */
+    explicit PersistentRedBlackTree(const Compare& comp) : comp(comp) {}
+
+    /**
+     * \brief       Copies share every node, O(1). Later changes to either
+     *          side are not seen by the other.
+     */
+    PersistentRedBlackTree(const PersistentRedBlackTree&) = default;
+    PersistentRedBlackTree& operator=(const PersistentRedBlackTree&) = default;
+    PersistentRedBlackTree(PersistentRedBlackTree&&) noexcept = default;
+    PersistentRedBlackTree& operator=(PersistentRedBlackTree&&) noexcept = default;
+
+    /**
+     * \brief       Returns the current version, O(1). Same as copying.
+     */
+    PersistentRedBlackTree snapshot() const {return *this;}
+
+    /**
+     * \brief       Returns the total entries of the tree.
+     */
+    unsigned long long getTotalSize() const {return this->totalNodes;}
+
+    /**
+     * \details     Same as RedBlackTree::insert. Copies the search path,
+     *          O(log n) nodes; on a collision nothing is copied.
+     *
+     * @param key Key value of node being inserted.
+     * @param data Data value of node being inserted.
+     * @return Bool if inserting into the tree was successful.
+     */
+    bool insert(kType key, dType data);
+
+    /**
+     * \details     Same as RedBlackTree::remove. Copies the search path down
+     *          to the removed node's successor, O(log n) nodes.
+     *
+     * @param key Key value of the node being removed.
+     * @return Bool if the key was in the tree and got removed.
+     */
+    bool remove(const kType& key);
+
+    /**
+     * \details     Same as RedBlackTree::search.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @param dataPtr Pointer to data type that is to be copied into.
+     * @return Bool depending if search key is in the tree.
+     */
+    bool search(const kType& sKey, dType* dataPtr) const;
+
+    /**
+     * \details     Looks up sKey and hands back a pointer to its data. The
+     *          pointer stays valid while any version holding that entry, as
+     *          it is now, is alive.
+     *
+     * @return Pointer to the data of sKey, nullptr if it isn't in the tree.
+     */
+    const dType* find(const kType& sKey) const;
+
+    /**
+     * \details     True if sKey is in the tree.
+     */
+    bool contains(const kType& sKey) const {return find(sKey) != nullptr;}
+
+    const_iterator begin() const;
+    const_iterator end() const {return const_iterator();}
+
+    /**
+     * \details     First entry with key >= sKey, end() if there is none.
+     */
+    const_iterator lower_bound(const kType& sKey) const;
+
+    /**
+     * \details     Calls visitor(key, data) on every entry with
+     *          lo <= key <= hi, in key order, O(log n + k). If visitor
+     *          returns bool, returning false stops the scan.
+     *
+     * @return Number of entries visited.
+     */
+    template<typename Visitor>
+    unsigned long long scan(const kType& lo, const kType& hi, Visitor&& visitor) const;
+};
+
+template<typename kType, typename dType, typename Compare>
+int PersistentRedBlackTree<kType, dType, Compare>::privateCompare(const kType& a, const kType& b) const
+{
+    if constexpr(THREE_WAY)
+    {
+        auto order = this->comp(a, b);
+        return order < 0 ? -1 : order > 0 ? 1 : 0;
+    }
+    else
+    {
+        return this->comp(a, b) ? -1 : this->comp(b, a) ? 1 : 0;
+    }
+}
+
+template<typename kType, typename dType, typename Compare>
+bool PersistentRedBlackTree<kType, dType, Compare>::privateIsRed(const Link& node)
+{
+    return node != nullptr && node->color == Color::red;
+}
+
+template<typename kType, typename dType, typename Compare>
+typename PersistentRedBlackTree<kType, dType, Compare>::Copy PersistentRedBlackTree<kType, dType, Compare>::privateCopy(const Link& node)
+{
+    return std::make_shared<PersistentNode<kType, dType>>(*node);
+}
+
+template<typename kType, typename dType, typename Compare>
+void PersistentRedBlackTree<kType, dType, Compare>::privateRotate(const Copy& top, const Copy& pivot, bool dir)
+{
+    top->child[!dir] = pivot->child[dir];
+    pivot->child[dir] = top;
+}
+
+template<typename kType, typename dType, typename Compare>
+void PersistentRedBlackTree<kType, dType, Compare>::privateAttach(const std::vector<Copy>& path, const std::vector<bool>& dirs, std::size_t k, Link node)
+{
+    if(k == 0)
+        this->root = std::move(node);
+    else
+        path[k - 1]->child[dirs[k - 1]] = std::move(node);
+}
+
+template<typename kType, typename dType, typename Compare>
+bool PersistentRedBlackTree<kType, dType, Compare>::insert(kType key, dType data)
+{
+    // Find the slot first, so a collision copies nothing.
+    std::vector<const PersistentNode<kType, dType>*> found;
+    std::vector<bool> dirs;
+    for(auto node = this->root.get(); node != nullptr;)
+    {
+        int order = privateCompare(key, node->key);
+        if(order == 0)
+            return false;
+
+        found.push_back(node);
+        dirs.push_back(order > 0);
+        node = node->child[order > 0].get();
+    }
+
+    // Copy the path top down; path[i] is the copy of found[i], then the leaf.
+    std::vector<Copy> path;
+    path.reserve(found.size() + 1);
+    for(std::size_t i = 0; i < found.size(); i++)
+    {
+        path.push_back(std::make_shared<PersistentNode<kType, dType>>(*found[i]));
+        privateAttach(path, dirs, i, path[i]);
+    }
+    path.push_back(std::make_shared<PersistentNode<kType, dType>>(std::move(key), std::move(data)));
+    privateAttach(path, dirs, found.size(), path.back());
+    this->totalNodes++;
+
+    // Same cases as RedBlackTree::privateInsertAdjustTree, with the path
+    // standing in for the parent links.
+    std::size_t i = path.size() - 1;
+    while(i >= 2 && path[i - 1]->color == Color::red)
+    {
+        const Copy parent = path[i - 1];
+        const Copy grand = path[i - 2];
+        const bool side = dirs[i - 2];
+
+        if(privateIsRed(grand->child[!side]))
+        {
+            Copy uncle = privateCopy(grand->child[!side]);
+            uncle->color = Color::black;
+            grand->child[!side] = uncle;
+            parent->color = Color::black;
+            grand->color = Color::red;
+            i -= 2;
+            continue;
+        }
+
+        Copy top = parent;
+        if(dirs[i - 1] != side)
+        {
+            privateRotate(parent, path[i], side);
+            grand->child[side] = path[i];
+            top = path[i];
+        }
+
+        privateRotate(grand, top, !side);
+        privateAttach(path, dirs, i - 2, top);
+        top->color = Color::black;
+        grand->color = Color::red;
+        break;
+    }
+
+    // The root is a copy made above (or the rotated top), never shared yet.
+    if(this->root->color == Color::red)
+        std::const_pointer_cast<PersistentNode<kType, dType>>(this->root)->color = Color::black;
+
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare>
+bool PersistentRedBlackTree<kType, dType, Compare>::remove(const kType& key)
+{
+    std::vector<const PersistentNode<kType, dType>*> found;
+    std::vector<bool> dirs;
+    auto node = this->root.get();
+    for(;;)
+    {
+        if(node == nullptr)
+            return false;
+
+        int order = privateCompare(key, node->key);
+        found.push_back(node);
+        if(order == 0)
+            break;
+
+        dirs.push_back(order > 0);
+        node = node->child[order > 0].get();
+    }
+
+    // With two children, the successor's entry moves up into the removed
+    // node and the successor, which has no left child, goes instead.
+    const std::size_t target = found.size() - 1;
+    if(node->child[0] != nullptr && node->child[1] != nullptr)
+    {
+        dirs.push_back(true);
+        for(node = node->child[1].get(); node != nullptr; node = node->child[0].get())
+        {
+            found.push_back(node);
+            dirs.push_back(false);
+        }
+        dirs.pop_back();
+    }
+
+    // Copy every node above the one that goes; it is only unlinked.
+    const PersistentNode<kType, dType>* gone = found.back();
+    std::vector<Copy> path;
+    path.reserve(found.size());
+    for(std::size_t i = 0; i + 1 < found.size(); i++)
+    {
+        path.push_back(std::make_shared<PersistentNode<kType, dType>>(*found[i]));
+        privateAttach(path, dirs, i, path[i]);
+    }
+
+    if(target < path.size())
+    {
+        path[target]->key = gone->key;
+        path[target]->data = gone->data;
+    }
+
+    // x takes gone's slot, k.
+    std::size_t k = path.size();
+    Link x = gone->child[gone->child[0] != nullptr ? 0 : 1];
+    const Color goneColor = gone->color;
+    privateAttach(path, dirs, k, x);
+    this->totalNodes--;
+
+    if(goneColor == Color::black)
+    {
+        if(privateIsRed(x))
+        {
+            Copy black = privateCopy(x);
+            black->color = Color::black;
+            privateAttach(path, dirs, k, black);
+        }
+        else
+        {
+            // Same cases as RedBlackTree::privateCaseOne..Four; x is the
+            // doubly black slot dirs[k - 1] of path[k - 1].
+            while(k > 0)
+            {
+                const Copy parent = path[k - 1];
+                const bool side = dirs[k - 1];
+                Copy sibling = privateCopy(parent->child[!side]);
+                parent->child[!side] = sibling;
+
+                if(sibling->color == Color::red)
+                {
+                    sibling->color = Color::black;
+                    parent->color = Color::red;
+                    privateRotate(parent, sibling, side);
+                    privateAttach(path, dirs, k - 1, sibling);
+                    path.insert(path.begin() + (std::ptrdiff_t)(k - 1), sibling);
+                    dirs.insert(dirs.begin() + (std::ptrdiff_t)(k - 1), side);
+                    k++;
+                    continue;
+                }
+
+                if(!privateIsRed(sibling->child[0]) && !privateIsRed(sibling->child[1]))
+                {
+                    sibling->color = Color::red;
+                    if(parent->color == Color::red)
+                    {
+                        parent->color = Color::black;
+                        break;
+                    }
+                    k--;
+                    continue;
+                }
+
+                if(!privateIsRed(sibling->child[!side]))
+                {
+                    Copy nephew = privateCopy(sibling->child[side]);
+                    nephew->color = Color::black;
+                    sibling->color = Color::red;
+                    privateRotate(sibling, nephew, !side);
+                    parent->child[!side] = nephew;
+                    sibling = nephew;
+                }
+
+                Copy far = privateCopy(sibling->child[!side]);
+                far->color = Color::black;
+                sibling->child[!side] = far;
+                sibling->color = parent->color;
+                parent->color = Color::black;
+                privateRotate(parent, sibling, side);
+                privateAttach(path, dirs, k - 1, sibling);
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare>
+bool PersistentRedBlackTree<kType, dType, Compare>::search(const kType& sKey, dType* dataPtr) const
+{
+    const dType* data = find(sKey);
+    if(data == nullptr)
+        return false;
+
+    *dataPtr = *data;
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare>
+const dType* PersistentRedBlackTree<kType, dType, Compare>::find(const kType& sKey) const
+{
+    for(auto node = this->root.get(); node != nullptr;)
+    {
+        int order = privateCompare(sKey, node->key);
+        if(order == 0)
+            return &node->data;
+        node = node->child[order > 0].get();
+    }
+    return nullptr;
+}
+
+template<typename kType, typename dType, typename Compare>
+typename PersistentRedBlackTree<kType, dType, Compare>::const_iterator PersistentRedBlackTree<kType, dType, Compare>::begin() const
+{
+    const_iterator it;
+    it.pushLeftSpine(this->root.get());
+    return it;
+}
+
+template<typename kType, typename dType, typename Compare>
+typename PersistentRedBlackTree<kType, dType, Compare>::const_iterator PersistentRedBlackTree<kType, dType, Compare>::lower_bound(const kType& sKey) const
+{
+    // Keep the nodes we went left at, they come after the subtree below.
+    const_iterator it;
+    for(auto node = this->root.get(); node != nullptr;)
+    {
+        if(privateCompare(node->key, sKey) >= 0)
+        {
+            it.stack.push_back(node);
+            node = node->child[0].get();
+        }
+        else
+        {
+            node = node->child[1].get();
+        }
+    }
+    return it;
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename Visitor>
+unsigned long long PersistentRedBlackTree<kType, dType, Compare>::scan(const kType& lo, const kType& hi, Visitor&& visitor) const
+{
+    unsigned long long visited = 0;
+
+    for(auto it = lower_bound(lo); it != end() && privateCompare(it->first, hi) <= 0; ++it)
+    {
+        visited++;
+
+        if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, const dType&>, bool>)
+        {
+            if(!visitor(it->first, it->second))
+                break;
+        }
+        else
+        {
+            visitor(it->first, it->second);
+        }
+    }
+
+    return visited;
+}
+
+#endif //REDBLACKTREE_PERSISTENTREDBLACKTREE_H
@@ -1,11 +1,35 @@
 //
 // Created by steve on 3/28/2021.
 //
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "NodePool.h"
+#include "ThreadPool.h"
+#ifdef WIN32
 #include <windows.h>
+#endif
 
 #ifndef REDBLACKTREE_REDBLACKTREE_H
 #define REDBLACKTREE_REDBLACKTREE_H
@@ -49,92 +73,382 @@ void printInColor(std::string &&s, int color)
  */
 enum Color {red, black};
 
+/**
+ * Stand-in for Node::subtreeSize when the tree doesn't keep sizes.
+ */
+struct NoSubtreeSize {};
+
+/**
+ * \brief       Augment policy that keeps nothing. The default.
+ *
+ * \details     An augment policy describes a summary kept for every subtree
+ *          of the tree, recomputed bottom-up whenever the shape changes. It
+ *          provides:
+ *          -summary_type: what is stored per node.
+ *          -identity(): summary of an empty subtree.
+ *          -fromEntry(key, data): summary of a single entry.
+ *          -combine(left, right): summary of two adjacent key ranges, left
+ *          before right. Must be associative, doesn't have to be commutative.
+ */
+struct NoAugment
+{
+    struct summary_type {};
+
+    static summary_type identity() {return {};}
+
+    template<typename kType, typename dType>
+    static summary_type fromEntry(const kType&, const dType&) {return {};}
+
+    static summary_type combine(const summary_type&, const summary_type&) {return {};}
+};
+
+/**
+ * \brief       Augment policy summing the data values of a subtree.
+ */
+template<typename dType>
+struct SumAugment
+{
+    using summary_type = dType;
+
+    static summary_type identity() {return dType{};}
+
+    template<typename kType>
+    static summary_type fromEntry(const kType&, const dType& data) {return data;}
+
+    static summary_type combine(const summary_type& left, const summary_type& right) {return left + right;}
+};
+
+/**
+ * \brief       Augment policy keeping the smallest data value of a subtree.
+ *          identity() is the largest dType, so dType must be arithmetic.
+ */
+template<typename dType>
+struct MinAugment
+{
+    using summary_type = dType;
+
+    static summary_type identity() {return std::numeric_limits<dType>::max();}
+
+    template<typename kType>
+    static summary_type fromEntry(const kType&, const dType& data) {return data;}
+
+    static summary_type combine(const summary_type& left, const summary_type& right) {return right < left ? right : left;}
+};
+
+/**
+ * \brief       Augment policy keeping the largest data value of a subtree.
+ *          identity() is the lowest dType, so dType must be arithmetic.
+ */
+template<typename dType>
+struct MaxAugment
+{
+    using summary_type = dType;
+
+    static summary_type identity() {return std::numeric_limits<dType>::lowest();}
+
+    template<typename kType>
+    static summary_type fromEntry(const kType&, const dType& data) {return data;}
+
+    static summary_type combine(const summary_type& left, const summary_type& right) {return left < right ? right : left;}
+};
+
+/**
+ * \brief       Augment policy that turns the tree into an interval tree.
+ *          Keys are interval starts, data the (inclusive) interval ends, and
+ *          the summary is the largest end in the subtree.
+ *
+ * \details     Any policy with an intervalEnd(key, data) function and the
+ *          largest end as its summary enables the overlap queries, so data
+ *          can also be a record that holds the end.
+ */
+template<typename kType>
+struct IntervalAugment : MaxAugment<kType>
+{
+    static const kType& intervalEnd(const kType&, const kType& end) {return end;}
+};
+
+/**
+ * \brief       Augment policies the overlap queries work with.
+ */
+template<typename Augment, typename kType, typename dType>
+concept IntervalAugmentPolicy = requires(const kType& key, const dType& data) {
+    {Augment::intervalEnd(key, data)} -> std::convertible_to<const kType&>;
+};
+
 /**
  * \brief       Node class for acting as the nodes within the binary
  *          tree. Has helper methods for returning parent, uncle, sibling
  *          etc.
  *
+ * \details     left and right own the subtree below them, the tree frees
+ *          a node's children before the node itself. parent is only a
+ *          non-owning back link, so there is no ownership cycle.
+ *
+ *          To keep a node down to three words plus the key/data, the color
+ *          lives in the lowest bit of the parent pointer (nodes are always at
+ *          least pointer aligned, so that bit is free). The key comes first
+ *          since that is what every descent compares, data right after it.
+ *
+ *          Order statistic trees also keep the size of the subtree below each
+ *          node, augmented trees an Augment summary. Otherwise subtreeSize
+ *          and summary are empty members that take no space.
+ *
  * @tparam kType Key value type.
  * @tparam dType Data value type.
+ * @tparam OrderStatistics True to store subtreeSize.
+ * @tparam Augment Policy whose summary_type is stored per node.
  */
-template <typename kType, typename dType>
+template <typename kType, typename dType, bool OrderStatistics = false, typename Augment = NoAugment>
 class Node
 {
 public:
     kType key;
     dType data;
-    std::shared_ptr<Node<kType, dType>> left = nullptr;
-    std::shared_ptr<Node<kType, dType>> right = nullptr;
-    std::shared_ptr<Node<kType, dType>> parent = nullptr;
-    Color color = Color::red;
+    Node<kType, dType, OrderStatistics, Augment>* left = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* right = nullptr;
+
+    /**
+     * Nodes in the subtree rooted here, this one included.
+     */
+    [[no_unique_address]] std::conditional_t<OrderStatistics, unsigned long long, NoSubtreeSize> subtreeSize{initialSubtreeSize()};
+
+    /**
+     * Augment summary of the subtree rooted here.
+     */
+    [[no_unique_address]] typename Augment::summary_type summary{};
+
+    Node() = default;
+
+    /**
+     * \brief   Builds key from key and data in place from args.
+     * @param key Forwarded to the kType constructor.
+     * @param args Forwarded to the dType constructor.
+     */
+    template<typename K, typename... Args>
+    explicit Node(K&& key, Args&&... args);
+
+    /**
+     * \brief   Returns the parent (if there is) of this node. Else nullptr
+     * @return  Node<kType, dType, OrderStatistics, Augment>* of the parent node.
+     */
+    Node<kType, dType, OrderStatistics, Augment>* getParent() const;
 
     /**
-     * \brief   Returns the parent (if there is) of this node. Else std::shared_ptr(nullptr)
-     * @return  std::shared_ptr<Node<kType, dType>> of the parent node.
+     * \brief   Returns the uncle (if there is) of this node. Else nullptr
+     * @return  Node<kType, dType, OrderStatistics, Augment>* of the uncle node.
      */
-    std::shared_ptr<Node<kType, dType>> getParent();
+    Node<kType, dType, OrderStatistics, Augment>* getUncle() const;
 
     /**
-     * \brief   Returns the uncle (if there is) of this node. Else std::shared_ptr(nullptr)
-     * @return  std::shared_ptr<Node<kType, dType>> of the uncle node.
+     * \brief   Returns the sibling (if there is) of this node. Else nullptr
+     * @return  Node<kType, dType, OrderStatistics, Augment>* of the sibling node.
      */
-    std::shared_ptr<Node<kType, dType>> getUncle();
+    Node<kType, dType, OrderStatistics, Augment>* getSibling() const;
 
     /**
-     * \brief   Returns the sibling (if there is) of this node. Else std::shared_ptr(nullptr)
-     * @return  std::shared_ptr<Node<kType, dType>> of the sibling node.
+     * \brief   Sets the parent while keeping the color.
+     * @param parent New parent of this node, can be nullptr.
      */
-    std::shared_ptr<Node<kType, dType>> getSibling();
+    void setParent(Node<kType, dType, OrderStatistics, Augment>* parent);
+
+    Color getColor() const {return static_cast<Color>(this->parentAndColor & COLOR_MASK);}
+    void setColor(Color color) {this->parentAndColor = (this->parentAndColor & ~COLOR_MASK) | static_cast<std::uintptr_t>(color);}
+
+private:
+    static constexpr std::uintptr_t COLOR_MASK = 1;
+
+    static constexpr auto initialSubtreeSize()
+    {
+        if constexpr(OrderStatistics)
+            return 1ULL;
+        else
+            return NoSubtreeSize{};
+    }
+
+    /**
+     * Parent pointer with the color packed into the lowest bit. 0 is a red
+     * node without a parent.
+     */
+    std::uintptr_t parentAndColor = 0;
 };
 
-template<typename kType, typename dType>
-std::shared_ptr<Node<kType, dType>> Node<kType, dType>::getParent() {
-    return this->parent;
+/*
+ * Three words of links plus the payload, nothing else.
+ */
+static_assert(sizeof(Node<int, int>) == 3 * sizeof(void*) + 2 * sizeof(int), "Node<int, int> should be three words plus key and data.");
+static_assert(alignof(Node<int, int>) > 1, "Color bit needs pointer alignment.");
+static_assert(sizeof(Node<int, int, true>) == 4 * sizeof(void*) + 2 * sizeof(int), "Subtree size should add one word.");
+
+template<typename kType, typename dType, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* Node<kType, dType, OrderStatistics, Augment>::getParent() const {
+    return reinterpret_cast<Node<kType, dType, OrderStatistics, Augment>*>(this->parentAndColor & ~COLOR_MASK);
 }
 
-template<typename kType, typename dType>
-std::shared_ptr<Node<kType, dType>> Node<kType, dType>::getUncle() {
-    if(this->parent != nullptr && this->parent->parent != nullptr) {
-        if(this->parent->parent->left == this->parent)
-            return this->parent->parent->right;
+template<typename kType, typename dType, bool OrderStatistics, typename Augment>
+void Node<kType, dType, OrderStatistics, Augment>::setParent(Node<kType, dType, OrderStatistics, Augment>* parent) {
+    this->parentAndColor = reinterpret_cast<std::uintptr_t>(parent) | (this->parentAndColor & COLOR_MASK);
+}
+
+template<typename kType, typename dType, bool OrderStatistics, typename Augment>
+template<typename K, typename... Args>
+Node<kType, dType, OrderStatistics, Augment>::Node(K&& key, Args&&... args)
+    : key(std::forward<K>(key)), data(std::forward<Args>(args)...) {}
+
+template<typename kType, typename dType, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* Node<kType, dType, OrderStatistics, Augment>::getUncle() const {
+    Node<kType, dType, OrderStatistics, Augment>* parent = getParent();
+
+    if(parent != nullptr && parent->getParent() != nullptr) {
+        if(parent->getParent()->left == parent)
+            return parent->getParent()->right;
         else
-            return this->parent->parent->left;
+            return parent->getParent()->left;
     }
     else
     {
-        return std::shared_ptr<Node<kType, dType>>(nullptr);
+        return nullptr;
     }
 }
 
-template<typename kType, typename dType>
-std::shared_ptr<Node<kType, dType>> Node<kType, dType>::getSibling() {
-    if(this->parent != nullptr) {
-        if(this->parent->left != nullptr && this->parent->left->key == this->key)
-            return this->parent->right;
-        else if(this->parent->right != nullptr && this->parent->right->key == this->key)
-            return this->parent->left;
+template<typename kType, typename dType, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* Node<kType, dType, OrderStatistics, Augment>::getSibling() const {
+    Node<kType, dType, OrderStatistics, Augment>* parent = getParent();
+
+    if(parent != nullptr) {
+        if(parent->left == this)
+            return parent->right;
+        else if(parent->right == this)
+            return parent->left;
         else
-            return std::shared_ptr<Node<kType, dType>>(nullptr);
+            return nullptr;
     }
     else
     {
-        return std::shared_ptr<Node<kType, dType>>(nullptr);
+        return nullptr;
     }
 }
 
-template<typename kType, typename dType>
+/**
+ * \brief       Transparent three-way comparator, returns a <=> b.
+ *
+ * \details     Unlike std::compare_three_way it doesn't require both sides
+ *          to be three_way_comparable on their own, so a std::string key can
+ *          be compared with a string literal or a const char*.
+ */
+struct ThreeWayCompare
+{
+    using is_transparent = void;
+
+    template<typename A, typename B> requires requires(const A& a, const B& b) {a <=> b;}
+    constexpr auto operator()(const A& a, const B& b) const {return a <=> b;}
+};
+
+/**
+ * \brief       Default ordering of a RedBlackTree. Keys that support <=> get
+ *          ThreeWayCompare so every level of a descent costs a single
+ *          comparison, anything else falls back on std::less.
+ */
+template<typename kType>
+using DefaultCompare = std::conditional_t<std::three_way_comparable<kType>, ThreeWayCompare, std::less<kType>>;
+
+/**
+ * \brief       Comparators with an is_transparent tag can compare keys
+ *          against other types, e.g. std::string keys with a string_view.
+ */
+template<typename Compare>
+concept TransparentCompare = requires { typename Compare::is_transparent; };
+
+/**
+ * \brief       Key types a transparent comparator is handed as they are,
+ *          without converting them to kType first.
+ *
+ * \details     Compare has to take K against kType both ways round. A number
+ *          of another arithmetic type than kType is left out even then, as
+ *          comparing e.g. an int key with a std::size_t mixes signedness and
+ *          gets -1 wrong. Those are converted to kType like for an opaque
+ *          comparator.
+ */
+template<typename K, typename kType, typename Compare>
+concept HeterogeneousKey = TransparentCompare<Compare> &&
+                           !(std::is_arithmetic_v<K> && std::is_arithmetic_v<kType> && !std::is_same_v<K, kType>) &&
+                           std::is_invocable_v<const Compare&, const kType&, const K&> &&
+                           std::is_invocable_v<const Compare&, const K&, const kType&>;
+
+/**
+ * \brief       Key types the range queries accept: anything a transparent
+ *          comparator takes directly, else anything convertible to kType.
+ */
+template<typename K, typename kType, typename Compare>
+concept LookupKey = HeterogeneousKey<K, kType, Compare> || std::convertible_to<const K&, kType>;
+
+template<typename kType, typename dType, typename Compare>
+class FrozenRedBlackTree;
+
+/**
+ * Kinds of operations RedBlackTree::applyBatch takes.
+ */
+enum class BatchOpType {insert, remove};
+
+/**
+ * \brief       Red black tree of unique keys, each holding one data value.
+ *
+ * @tparam kType Key value type.
+ * @tparam dType Data value type.
+ * @tparam Compare Ordering of the keys. Either a three-way comparator that
+ *          returns a std::*_ordering (one call per level) or a bool less than
+ *          comparator. If it is transparent, search and remove also accept
+ *          keys of any type it can compare against kType.
+ * @tparam OrderStatistics True to keep subtree sizes in every node, which
+ *          enables rank, select and count in O(log n) for one extra word per
+ *          node.
+ * @tparam Augment Policy for a per-subtree summary (see NoAugment), which
+ *          enables aggregate, and with an interval policy the overlap
+ *          queries, in O(log n).
+ */
+template<typename kType, typename dType, typename Compare = DefaultCompare<kType>, bool OrderStatistics = false, typename Augment = NoAugment>
 class RedBlackTree
 {
 private:
+    /**
+     * True if nodes keep an Augment summary.
+     */
+    static constexpr bool AUGMENTED = !std::is_same_v<Augment, NoAugment>;
+
+    /**
+     * True if comp returns an ordering instead of a bool.
+     */
+    static constexpr bool THREE_WAY = !std::is_convertible_v<std::invoke_result_t<const Compare&, const kType&, const kType&>, bool>;
+
+    /**
+     * Key ordering, takes no space when the comparator is empty.
+     */
+    [[no_unique_address]] Compare comp;
+
+    /**
+     * Pool every node of this tree is allocated from.
+     */
+    NodePool nodePool{sizeof(Node<kType, dType, OrderStatistics, Augment>)};
+
     /**
      * top root of the tree
      */
-    std::shared_ptr<Node<kType, dType>> root;
+    Node<kType, dType, OrderStatistics, Augment>* root = nullptr;
 
     /**
      * counter for totalNodes. Increments/decrements on insert/remove success.
+     * UNKNOWN_SIZE after a split or set operation, until getTotalSize counts
+     * again. Atomic so const getTotalSize calls on several threads can each
+     * store what they counted; every access is a relaxed load or store, so
+     * it costs a plain move.
+     */
+    mutable std::atomic<unsigned long long> totalNodes{0};
+    static constexpr unsigned long long UNKNOWN_SIZE = ~0ULL;
+
+    /**
+     * Node of the last insert, where append starts looking. Cleared when
+     * that node goes away or leaves the tree.
      */
-    unsigned long long totalNodes;
+    Node<kType, dType, OrderStatistics, Augment>* lastInserted = nullptr;
 
     /**
      * \brief       Creates a node object when called with the parameters key
@@ -142,571 +456,3496 @@ private:
      *
      * \details     Creates a node object when called with the parameters key
      *          and data which is of types kType & dType respectively with the
-     *          declaration of the object type(s).
+     *          declaration of the object type(s). The node is carved out of
+     *          nodePool rather than the global heap, and key/data are
+     *          constructed straight inside it.
      *
-     * @param key kType key value for traversing the tree.
-     * @param data Data that is stored in nodes. Not part of the structure
-     *          of the tree
+     * @param key Forwarded to the kType constructor.
+     * @param args Forwarded to the dType constructor. Data is stored in
+     *          nodes. Not part of the structure of the tree
      *
-     * @return      std::shared_ptr<Node<kType, dType>> of the node created.
+     * @return      Node<kType, dType, OrderStatistics, Augment>* of the node created.
      */
-    std::shared_ptr<Node<kType, dType>> createLeaf(kType key, dType data);
+    template<typename K, typename... Args>
+    Node<kType, dType, OrderStatistics, Augment>* createLeaf(K&& key, Args&&... args);
 
     /**
-     * \brief       Private function for adjusting a tree when a new node has
-     *          just been inserted. Follows Red Black Tree rules for insertion.
-     *          Uses the parameter Node to adjust from there on.
+     * \brief       Destroys a node that is no longer linked into the tree
+     *          and hands its block back to nodePool.
      *
-     * @param node std::shared_ptr<Node<kType, dType>> of the node we're adjusting
-     *          the tree to.
+     * @param node Node to destroy. Its children are not touched.
      */
-    void privateInsertAdjustTree(std::shared_ptr<Node<kType, dType>> node);
+    void destroyLeaf(Node<kType, dType, OrderStatistics, Augment>* node);
 
     /**
-     * \brief       Recursively finds the node in which the newly created node
-     *          can be inserted at. If the Node->left/right is null, insert
-     *          the node param in that place.
-     *
-     * @param root Node we are recursively transcending down.
-     * @param node Node/leaf we are inserting into the tree.
+     * \brief       Destroys root and every node below it, children first.
      *
-     * @return Boolean if the node was successfully inserted.
+     * @param root Top of the subtree to destroy.
      */
-    bool privateInsert(std::shared_ptr<Node<kType, dType>> root, std::shared_ptr<Node<kType, dType>> node);
+    void privateDestroyTree(Node<kType, dType, OrderStatistics, Augment>* root);
 
     /**
-     * \brief       Helper function that calls other methods upon insertion
-     *          of the tree.
-     *
-     * \details     Helper function that calls other methods upon insertion
-     *          of the tree. First calls privateInsert to insert into the tree
-     *          as a normal BST as a red node. Since we have the node as a ptr,
-     *          we call privateInsertAdjustTree to calibrate that(and parents)
-     *          node to match the rules of a red black tree.
-     *
-     * @param root Node that we start from.
-     * @param key kType key value of the node being inserted.
-     * @param data dType data value of the node being inserted.
-     * @return Boolean if the node was successfully inserted.
+     * Blocks a bulk build constructs its nodes in, the i-th smallest entry
+     * in block i. They come in chunks of their own, so the old nodes' chunks
+     * empty out and go back to the system once the old nodes are destroyed.
      */
-    bool privateRedBlackInsert(std::shared_ptr<Node<kType, dType>> root, kType key, dType data);
+    struct BulkBlocks
+    {
+        NodePool::Run run;
+        std::size_t count = 0;
+
+        Node<kType, dType, OrderStatistics, Augment>* operator[](std::size_t i) const
+        {
+            return static_cast<Node<kType, dType, OrderStatistics, Augment>*>(this->run[i]);
+        }
+    };
 
     /**
-     * \brief       Recursive standard BST function to the find the node we want to delete.
-     *
-     * @param root Node from where to start from.
+     * \brief       Blocks for a bulk build of count nodes.
      */
-    void privateDeleteBST(std::shared_ptr<Node<kType, dType>> root);
+    BulkBlocks privateAcquireBlocks(std::size_t count);
 
     /**
-     * \brief       Function that is called with the node we want to delete.
-     *
-     * \details     Function called with the param root, this root is the node
-     *          that we are deleting. Upon deleting, we proceed with the standard
-     *          delete case in a BST. Before the leaf node is replaced/deleted, we
-     *          set the appropriate variables like replacedColor and deletedColor
-     *          to find the best case.
-     *          Initial Steps:
-     *          -If deleted Node has 2 Null children, x->nullptr
-     *          -If deleted Node has 1 Null children, x->non-nullptr child.
-     *          -If deleted Node has 0 Null childrem, x->replacement->right(could be null)
-     *
-     *          Other Steps:
-     *          -If the node we deleted is red and its replacement is red or nullptr,
-     *          we are done.
-     *          -If the node we deleted is red and its replacement is black, color the
-     *          replacement red and proceed to CASES 0-4.
-     *          -If the node we deleted is black and its replacement is red, color the
-     *          replacement black, we are done.
-     *          -If the node we deleted is black and its replacement is null or black,
-     *          proceed to cases 0-4.
-     *
-     *          Cases:
-     *          -Case Zero: Node x is red.
-     *          -Case One: Node x is black and sibling is red
-     *          -Case Two: Node x is black and sibling is black and both children of
-     *          sibling is black.
-     *          -Case Three: Node x is black and sibling is black with:
-     *              -If x is left child, siblings left child is red and right is black.
-     *              -If x is right child, siblings right child is red and left is black.
-     *          -Case Four: Node x is black and sibling is black with:
-     *              -If x is left child, sibling right is red.
-     *              -If x is right childm sibling left is red.
-     * @param root
+     * \brief       Gives back blocks of a bulk build that failed, once every
+     *          node constructed in them is destroyed again.
      */
-    void privateDelete(std::shared_ptr<Node<kType, dType>> root);
+    void privateReleaseBlocks(BulkBlocks& blocks);
 
     /**
-     * \brief       Recursive function to the find the node we want to delete.
-     *          Upon finding the node to delete, call privateDelete.
-     *
-     * @param root Node from where to start from.
+     * \brief       Destroys the current nodes ahead of linking the ones of a
+     *          bulk build. root is left nullptr.
      */
-    bool privateRemove(std::shared_ptr<Node<kType, dType>> root, kType key);
+    void privateCommitBlocks();
 
     /**
-     * \brief       Performs a left rotate on the root node. Sets the
-     *          pivot node to roots->right child.
-     *
-     * @param root Node to perform left rotate on.
+     * \brief       Constructs a node in block from node's entry, moving it
+     *          if neither key nor data can throw on move and copying it
+     *          otherwise, so a throw leaves node's entry as it was.
      */
-    void privateLeftRotate(std::shared_ptr<Node<kType, dType>> root);
+    static void privateCloneEntry(void* block, Node<kType, dType, OrderStatistics, Augment>* node);
 
     /**
-     * \brief       Performs a right rotate on the root node. Sets the
-     *          pivot node to roots->left child.
+     * \brief       Links the already constructed nodes [lo, hi) of a key
+     *          ordered block array into a balanced subtree.
      *
-     * @param root Node to perform right rotate on.
+     * \details     The middle node becomes the subtree root, so sizes of
+     *          sibling subtrees differ by at most one and every null link
+     *          sits at depth redDepth or redDepth + 1. Coloring exactly the
+     *          nodes at redDepth red then gives every path the same number of
+     *          black nodes, with no red node having a red child.
+     *
+     * @param blocks Blocks of the array.
+     * @param lo First node of the subtree.
+     * @param hi One past the last node of the subtree.
+     * @param depth Depth of the subtree root.
+     * @param redDepth floor(log2(n + 1)) for the whole tree of n nodes.
+     * @param parent Parent of the subtree root.
+     * @return The subtree root, nullptr if lo == hi.
      */
-    void privateRightRotate(std::shared_ptr<Node<kType, dType>> root);
+    Node<kType, dType, OrderStatistics, Augment>* privateBuildBalanced(const BulkBlocks& blocks, std::size_t lo, std::size_t hi, unsigned depth,
+                                                                       unsigned redDepth, Node<kType, dType, OrderStatistics, Augment>* parent);
 
     /**
-     * \brief Debugging print inorder method.
-     * @param root To start from.
+     * \brief       Number of black nodes on any path from root down to a
+     *          null link. O(log n).
      */
-    void privatePrintInorder(std::shared_ptr<Node<kType, dType>> root);
-    void privatePrintTreeFromRoot(std::shared_ptr<Node<kType, dType>> root);
+    static unsigned privateBlackHeight(const Node<kType, dType, OrderStatistics, Augment>* root);
 
     /**
-     * \brief       Finds the largest value from the root Node.
-     *
-     * \details     Recursively transcends the tree to find the largest
-     *          value from the root Node.
-     *
-     * @param root Node starting point.
-     *
-     * @return std::shared_ptr<Node<KType, dType>> of the largest Node.
+     * \brief       Stores count as the number of entries, UNKNOWN_SIZE if it
+     *          is not known.
      */
-    std::shared_ptr<Node<kType, dType>> privateFindLargest(std::shared_ptr<Node<kType, dType>> root);
+    void privateSetSize(unsigned long long count) const;
 
     /**
-     * \brief       Finds the smalled value from the root Node.
-     *
-     * \details     Recursively transcends the tree to find the smallest
-     *          value from the root Node.
-     *
-     * @param root Node starting point.
-     *
-     * @return std::shared_ptr<Node<KType, dType>> of the smallest Node.
+     * \brief       Adds delta to the number of entries, unless it is unknown.
      */
-    std::shared_ptr<Node<kType, dType>> privateFindSmallest(std::shared_ptr<Node<kType, dType>> root);
+    void privateAddSize(long long delta);
 
     /**
-     * \brief       Finds the key value from the root Node. If the node doesn't
-     *          contain the key value, recusively move left or right depending
-     *          on whether it is less than or greater than the search val.
-     *
-     * @param root Node starting point.
-     *
-     * @return std::shared_ptr<Node<KType, dType>> of the search Node.
+     * \brief       Number of entries if known without counting, else
+     *          UNKNOWN_SIZE. Always known with OrderStatistics.
      */
-    std::shared_ptr<Node<kType, dType>> privateSearch(std::shared_ptr<Node<kType, dType>> root, const kType& val);
+    unsigned long long privateKnownSize() const;
 
     /**
-     * \brief       Checks if Case Zero is applicable. Returns true if so.
-     *          Else false.
-     *
-     * \details     Returns true if x is red.
-     *
-     * @param x Node x to check if Case Zero.
-     *
-     * @return Boolean true/false if is case zero.
+     * \brief       Number of entries if known, else an upper bound from the
+     *          black height. O(log n), for the paths that only pick a
+     *          strategy by size and must not count.
      */
-    bool privateCheckCaseZero(std::shared_ptr<Node<kType, dType>> x);
+    unsigned long long privateSizeBound() const;
 
     /**
-     * \brief       Checks if Case One is applicable. Returns true if so.
-     *          Else false.
+     * \brief       Turns a child subtree into a tree of its own: no parent
+     *          and a black root.
      *
-     * \details     Returns true if x is black and sibling w is red.
-     *
-     * @param x Node x to check if black.
-     * @param w Node w to check if red.
-     *
-     * @return Boolean true/false if is case one.
+     * @param root Subtree root, may be nullptr.
+     * @param height Black height of the subtree before.
+     * @return Black height of the subtree after.
      */
-    bool privateCheckCaseOne(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w);
+    static unsigned privateDetach(Node<kType, dType, OrderStatistics, Augment>* root, unsigned height);
 
     /**
-     * \brief       Check if Case Two is applicable. Returns true if so.
-     *          Else false
+     * \brief       Joins two trees and a pivot node with every key of left
+     *          below the pivot and every key of right above it.
      *
-     * \details     Returns true if x is black and sibling w is black
-     *          and sibling w's childed are both black.
-     *
-     * @param x Node x to check if black.
-     * @param w Node w to check if black and children are black.
+     * \details     If the black heights match, pivot simply becomes the
+     *          new root. Otherwise it goes down the inner spine of the
+     *          taller tree (the right spine of left, or the left spine of
+     *          right) to the first black node as high as the shorter tree,
+     *          hangs in there as a red node holding that node and the shorter
+     *          tree, and is fixed up like a fresh insert. Both the walk and
+     *          the fix-up only cover the height difference, O(|lh - rh| + 1).
+     *          Touches nothing but the given nodes.
      *
-     * @return Boolean true/false if is case two.
+     * @param left Root of the lower tree, no parent and black, may be nullptr.
+     * @param leftHeight Black height of left.
+     * @param pivot Detached node going in between.
+     * @param right Root of the upper tree, no parent and black, may be nullptr.
+     * @param rightHeight Black height of right.
+     * @param height Set to the black height of the result.
+     * @return Root of the joined tree, no parent and black.
      */
-    bool privateCheckCaseTwo(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w);
+    static Node<kType, dType, OrderStatistics, Augment>* privateJoin(Node<kType, dType, OrderStatistics, Augment>* left, unsigned leftHeight, Node<kType, dType, OrderStatistics, Augment>* pivot,
+                                                                     Node<kType, dType, OrderStatistics, Augment>* right, unsigned rightHeight, unsigned& height);
 
     /**
-     * \brief       Check if Case Three is applicable. Returns true if so.
-     *          Else false.
-     *
-     * \details     Returns true if x is black and sibling w is black along with:
-     *          -If x is left child, and w->left is red and w->right is black.
-     *          -If x is right child, and w->right is red and w->left is black.
-     *
-     * @param x Node x to check if black.
-     * @param w Node w to check if black and one child is red.
-     * @param parent Parent of x and W. Used to find if the child is left or right.
-     *
-     * @return Boolean true/false if the case is three.
+     * \brief       Same as privateJoin, without a pivot. The largest node of
+     *          left is split off and used as one. O(log n).
      */
-    bool privateCheckCaseThree(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w, std::shared_ptr<Node<kType, dType>> parent);
+    Node<kType, dType, OrderStatistics, Augment>* privateJoin(Node<kType, dType, OrderStatistics, Augment>* left, unsigned leftHeight,
+                                                              Node<kType, dType, OrderStatistics, Augment>* right, unsigned rightHeight, unsigned& height);
 
     /**
-     * \brief       Check if Case Four is applicable. Returns true if so.
-     *          Else false.
-     *
-     * \details     Returns true if x is black and sibling w is black along with:
-     *          -If x is left child, w->right is red.
-     *          -If x is right child, w->left is red.
+     * \brief       Splits a tree into the keys below key and the keys above
+     *          it, O(log n).
      *
-     * @param x Node x to check if black.
-     * @param w Node w to check if black and one child is red.
-     * @param parent Parent of x and W. Used to find if the child is left or right.
+     * \details     Walks down towards key. Every node on the way is cut
+     *          out with its two subtrees detached; the subtree on the far
+     *          side of key is joined back onto the matching half with that
+     *          node as pivot on the way back up. The joins along the path
+     *          work on increasing heights, so their costs add up to O(log n).
+     *          Touches nothing but the given nodes.
      *
-     * @return Boolean true/false if the case is four.
+     * @param root Root of the tree, no parent and black, may be nullptr.
+     * @param height Black height of root.
+     * @param key Key to split at.
+     * @param left Set to the tree of keys below key.
+     * @param leftHeight Set to the black height of left.
+     * @param right Set to the tree of keys above key.
+     * @param rightHeight Set to the black height of right.
+     * @return The detached node holding key, nullptr if there is none.
      */
-    bool privateCheckCaseFour(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w, std::shared_ptr<Node<kType, dType>> parentw);
+    template<typename K>
+    Node<kType, dType, OrderStatistics, Augment>* privateSplit(Node<kType, dType, OrderStatistics, Augment>* root, unsigned height, const K& key,
+                                                               Node<kType, dType, OrderStatistics, Augment>*& left, unsigned& leftHeight,
+                                                               Node<kType, dType, OrderStatistics, Augment>*& right, unsigned& rightHeight);
 
     /**
-     * \brief       Adjusts x Node to fit case zero.
-     *
-     * \details     Colors x Node black. Does not branch to other cases.
-     *
-     * @param x Node that is of case zero.
+     * Which of unionWith, intersectWith and subtract privateSetOperation runs.
      */
-    void privateCaseZero(std::shared_ptr<Node<kType, dType>> x);
+    enum class SetOperation {unite, intersect, subtract};
 
     /**
-     * \brief       Adjusts x Node, w Node, and parent Node to match that of
-     *          case one to a Red Black BST.
+     * \brief       Nodes and whole subtrees a set operation dropped. They are
+     *          chained through their parent links, so collecting them never
+     *          allocates and two chains append in O(1).
+     */
+    struct DroppedNodes
+    {
+        Node<kType, dType, OrderStatistics, Augment>* head = nullptr;
+        Node<kType, dType, OrderStatistics, Augment>* tail = nullptr;
+
+        void add(Node<kType, dType, OrderStatistics, Augment>* root)
+        {
+            root->setParent(nullptr);
+            if(this->tail != nullptr)
+                this->tail->setParent(root);
+            else
+                this->head = root;
+            this->tail = root;
+        }
+
+        void append(DroppedNodes& other)
+        {
+            if(other.head == nullptr)
+                return;
+            if(this->tail != nullptr)
+                this->tail->setParent(other.head);
+            else
+                this->head = other.head;
+            this->tail = other.tail;
+        }
+    };
+
+    /**
+     * Subtrees with a lower black height (fewer than about 4k nodes) are not
+     * worth a task of their own.
+     */
+    static constexpr unsigned PARALLEL_MIN_HEIGHT = 12;
+
+    /**
+     * \brief       Union, intersection or difference of two trees by split
+     *          and join, O(m log(n/m + 1)) for sizes m <= n.
      *
-     * \details     Node x is black and w is red. Color w black. Color x parent red.
-     *          Rotate parent depending on if x is left child, then left rotation, etc.
-     *          Adjust w to the new sibling. Branch to next case 2-4 depending on results.
+     * \details     Cuts the root out of a, splits b around its key and
+     *          recurses into the two halves independently, the upper one as
+     *          a task on pool while spawnDepth lasts. The halves and
+     *          a's root (if its key stays) are then joined back together.
+     *          Nodes that do not make it into the result are only collected
+     *          in dropped, as the pool may not be used from several threads.
      *
-     * @param x Node that is of case one.
-     * @param w Sibling of Node x.
-     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     * @param op Operation to run. Entries of a win over equal keys of b.
+     * @param a Root of the first tree, no parent and black, may be nullptr.
+     * @param aHeight Black height of a.
+     * @param b Root of the second tree, no parent and black, may be nullptr.
+     * @param bHeight Black height of b.
+     * @param height Set to the black height of the result.
+     * @param dropped Collects the nodes left out of the result.
+     * @param spawnDepth Recursion levels left that may spawn a task.
+     * @param pool Pool the tasks run on.
+     * @return Root of the result, no parent and black.
      */
-    void privateCaseOne(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w, std::shared_ptr<Node<kType, dType>> parent);
+    Node<kType, dType, OrderStatistics, Augment>* privateSetOperation(SetOperation op, Node<kType, dType, OrderStatistics, Augment>* a, unsigned aHeight,
+                                                                      Node<kType, dType, OrderStatistics, Augment>* b, unsigned bHeight,
+                                                                      unsigned& height, DroppedNodes& dropped, unsigned spawnDepth, ThreadPool& pool);
 
     /**
-     * \brief       Adjusts x Node, w Node, and Parent Node to match that of
-     *          case two to a Red Black BST.
+     * \brief       Runs op on this tree and other, leaving the result here
+     *          and other empty.
+     */
+    void privateSetOperation(SetOperation op, RedBlackTree&& other, ThreadPool& pool);
+
+    /**
+     * \brief       Levels of halving that split count entries into about four
+     *          pieces per worker of pool, fewer if that would leave under
+     *          about 4k entries per piece.
+     */
+    static unsigned privateParallelDepth(const ThreadPool& pool, unsigned long long count);
+
+    /**
+     * Trees with other data types (from parallel_transform) link their
+     * nodes in directly.
+     */
+    template<typename, typename, typename, bool, typename> friend class RedBlackTree;
+    template<typename, typename, typename> friend class FrozenRedBlackTree;
+
+    /**
+     * Tree a parallel_transform with fn builds: same keys, comparator and
+     * order statistics, data from fn.
+     */
+    template<typename Fn>
+    using TransformedData = std::decay_t<std::invoke_result_t<Fn&, const kType&, const dType&>>;
+    template<typename Fn>
+    using TransformedTree = RedBlackTree<kType, TransformedData<Fn>, Compare, OrderStatistics>;
+
+    /**
+     * \brief       The top of the tree cut into pieces for a parallel pass.
      *
-     * \details     Node x is black, w is black, and both children of w are black.
-     *          Color w red. Set x to parent. If x is red, color black. Else proceed
-     *          to cases 1-4 based on result.
+     * \details     The nodes less than depth levels below the root are kept
+     *          in between, the subtrees hanging off them in subtrees, both in
+     *          key order: subtrees[0] holds every key before between[0],
+     *          subtrees[i + 1] every key between between[i] and
+     *          between[i + 1]. So subtrees has one more entry than between,
+     *          some of which may be nullptr.
+     */
+    struct ParallelCut
+    {
+        std::vector<Node<kType, dType, OrderStatistics, Augment>*> subtrees;
+        std::vector<Node<kType, dType, OrderStatistics, Augment>*> between;
+        unsigned depth = 0;
+    };
+
+    /**
+     * \brief       Cuts the tree privateParallelDepth levels below the root.
+     */
+    ParallelCut privateParallelCut(const ThreadPool& pool) const;
+
+    /**
+     * \brief       Collects the pieces of the cut depth levels below root.
+     */
+    static void privateParallelCut(Node<kType, dType, OrderStatistics, Augment>* root, unsigned depth, ParallelCut& cut);
+
+    /**
+     * \brief       Calls visitor(key, data) on every entry of root, in key order.
+     */
+    template<typename Visitor>
+    static void privateForEach(Node<kType, dType, OrderStatistics, Augment>* root, Visitor& visitor);
+
+    /**
+     * \brief       Runs privateForEach on the pieces of the cut as tasks on pool.
+     */
+    template<typename Visitor>
+    void privateParallelForEach(Visitor& visitor, ThreadPool& pool) const;
+
+    /**
+     * \brief       Folds map(key, data) of every entry of root into acc, in key
+     *          order, with combine.
+     */
+    template<typename T, typename Map, typename Combine>
+    static T privateReduce(Node<kType, dType, OrderStatistics, Augment>* root, T acc, Map& map, Combine& combine);
+
+    /**
+     * \brief       Appends every node of root whose entry pred accepts to
+     *          kept, in key order.
+     */
+    template<typename Pred>
+    static void privateFilter(Node<kType, dType, OrderStatistics, Augment>* root, Pred& pred, std::vector<Node<kType, dType, OrderStatistics, Augment>*>& kept);
+
+    /**
+     * \brief       Copies the subtree at root into nodes of type Copy taken
+     *          from pool, with data fn(key, data). Colors and subtree sizes
+     *          are copied along, so the copy has the same shape.
      *
-     * @param x Node that is of case one.
-     * @param w Sibling of Node x.
-     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     * \details     If fn throws, the nodes copied so far are destroyed (their
+     *          blocks stay with pool) and the exception is passed on.
+     *
+     * @param root Subtree to copy, may be nullptr.
+     * @param depth Levels to copy. Where the cut took a subtree (depth 0
+     *          or no node) the next entry of pieces is linked in instead, so
+     *          the top of a ParallelCut can be copied around subtrees that
+     *          were copied on their own.
+     * @param pieces Copied subtrees of the cut, consumed in key order.
+     *          nullptr to copy the whole subtree.
+     * @param next Index of the next piece, advanced past every one used.
      */
-    void privateCaseTwo(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w, std::shared_ptr<Node<kType, dType>> parent);
+    template<typename Copy, typename Fn>
+    static Copy* privateCopyTransformed(Node<kType, dType, OrderStatistics, Augment>* root, Fn& fn, NodePool& pool,
+                                        unsigned depth, Copy* const* pieces, std::size_t& next);
 
     /**
-     * \brief       Adjusts x Node, w Node, and parent Node to match that of
-     *          case three to a Red Black BST.
+     * \brief       Runs the destructors of every node of a copy and gives
+     *          their blocks back through pool, whichever pool they came from.
+     *          A pool only frees chunks once their blocks are given back.
+     */
+    template<typename Copy>
+    static void privateDestroyCopy(Copy* root, NodePool& pool);
+
+    /**
+     * \brief       privateBuildBalanced with the top levels linked here and
+     *          the subtrees below them handed to group. Nodes linked here
+     *          are left for privateUpdateTop once group is done.
      *
-     * \details     Node x is black, w is black, and one child of w is red.
-     *          If x is left child, then w's left child is red and right is black. Else
-     *          conversely with x is right child, then w's right child is red and left
-     *          is black. Color the red child black, color w red. Rotate w based on left
-     *          or right. Adjust w to the new w since the rotate. Proceed to case 4.
+     * @param spawnDepth Depth at which subtrees become tasks.
+     */
+    Node<kType, dType, OrderStatistics, Augment>* privateBuildBalanced(const BulkBlocks& blocks, std::size_t lo, std::size_t hi, unsigned depth, unsigned redDepth,
+                                                                       Node<kType, dType, OrderStatistics, Augment>* parent, unsigned spawnDepth, ThreadPool::TaskGroup& group);
+
+    /**
+     * \brief       Runs privateUpdateNode bottom up on the nodes less than
+     *          levels below root.
+     */
+    static void privateUpdateTop(Node<kType, dType, OrderStatistics, Augment>* root, unsigned levels);
+
+    /**
+     * \brief       Replaces the contents of the tree with count entries,
+     *          constructed in key order on the workers of pool.
      *
-     * @param x Node that is of case one.
-     * @param w Sibling of Node x.
-     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     * \details     Like assignSorted, the nodes are carved out of one
+     *          allocation and linked into a balanced tree, but both the
+     *          constructing and the linking are split into ranges that run as
+     *          tasks. If constructing an entry throws, the tree is left as it
+     *          was and the exception is passed on.
+     *
+     * @param count Entries to build.
+     * @param construct Callable taking (std::size_t i, void* block) that
+     *          constructs the node of the i-th smallest entry in block.
+     *          Called from several threads at once for different i.
      */
-    void privateCaseThree(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w, std::shared_ptr<Node<kType, dType>> parent);
+    template<typename Construct>
+    void privateParallelBuild(std::size_t count, Construct& construct, ThreadPool& pool);
 
     /**
-     * \brief       Adjusts x Node, w Node, and parent Node to match that of
-     *          case four to a Red Black BST.
+     * \brief       Private function for adjusting a tree when a new node has
+     *          just been inserted. Follows Red Black Tree rules for insertion.
+     *          Uses the parameter Node to adjust from there on.
      *
-     * \details     Node x is black, w is black and w's right child is red with x
-     *          being pointed to by the left. Conversily flipped as well. w gets set
-     *          to parents color. Parent gets colored black. Color w's child black.
-     *          Rotate the parent left if x is left child. Right if else. Then we are
-     *          done, don't branch to another case.
+     * @param node Node<kType, dType, OrderStatistics, Augment>* of the node we're adjusting
+     *          the tree to.
+     * @param top Root slot of the tree node is in.
+     * @return True if the root ended up red and was blackened, so the black
+     *          height of the tree grew by one.
+     */
+    static bool privateInsertAdjustTree(Node<kType, dType, OrderStatistics, Augment>* node, Node<kType, dType, OrderStatistics, Augment>*& top);
+    bool privateInsertAdjustTree(Node<kType, dType, OrderStatistics, Augment>* node);
+
+    /**
+     * \brief       Finds the node under which key would be inserted, without
+     *          building anything.
      *
-     * @param x Node that is of case one.
-     * @param w Sibling of Node x.
-     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     * \details     Walks down from root in a loop with a single comparison
+     *          per level. A three-way comparator stops as soon as it sees an
+     *          equal key. A less than comparator remembers the last node we
+     *          didn't go right from; only that node can hold an equal key, so
+     *          one extra comparison at the bottom tells a duplicate apart.
+     *
+     * @param root Node we start transcending down from.
+     * @param key Key being inserted, anything comp can compare against kType.
+     * @param parent Set to the node the new leaf hangs off, nullptr if the
+     *          tree is empty.
+     * @param goLeft Set to true if the new leaf is parent's left child.
+     *
+     * @return False if key already exists.
      */
-    void privateCaseFour(std::shared_ptr<Node<kType, dType>> x, std::shared_ptr<Node<kType, dType>> w, std::shared_ptr<Node<kType, dType>> parent);
-public:
+    template<typename K>
+    bool privateFindInsertPosition(Node<kType, dType, OrderStatistics, Augment>* root, const K& key, Node<kType, dType, OrderStatistics, Augment>*& parent, bool& goLeft);
+
     /**
-     * \brief       Constructs an empty tree.
+     * \brief       Hangs node off parent at the spot found by
+     *          privateFindInsertPosition, or makes it the root.
+     */
+    void privateLinkLeaf(Node<kType, dType, OrderStatistics, Augment>* node, Node<kType, dType, OrderStatistics, Augment>* parent, bool goLeft);
+
+    /**
+     * \brief       Size of the subtree at node, 0 for nullptr. Only for
+     *          OrderStatistics trees.
+     */
+    static unsigned long long privateSubtreeSize(const Node<kType, dType, OrderStatistics, Augment>* node);
+
+    /**
+     * \brief       Summary of the subtree at node, Augment::identity() for
+     *          nullptr.
+     */
+    static typename Augment::summary_type privateSummary(const Node<kType, dType, OrderStatistics, Augment>* node);
+
+    /**
+     * \brief       Recomputes whatever node keeps about its subtree (size,
+     *          Augment summary) from its children. Called bottom-up after
+     *          every change in shape, so rotations and the fix-up cases keep
+     *          it right. Does nothing for plain trees.
+     */
+    static void privateUpdateNode(Node<kType, dType, OrderStatistics, Augment>* node);
+
+    /**
+     * \brief       Runs privateUpdateNode on node and every node above it.
+     *          Used when a leaf is linked in or unlinked, or data changes.
+     */
+    static void privateUpdatePath(Node<kType, dType, OrderStatistics, Augment>* node);
+
+    /**
+     * \brief       Visits, in key order, every interval below root that
+     *          overlaps [lo, hi], skipping subtrees whose largest end is
+     *          below lo.
+     */
+    template<typename Visitor>
+    bool privateVisitOverlaps(Node<kType, dType, OrderStatistics, Augment>* root, const kType& lo, const kType& hi, Visitor& visitor, unsigned long long& visited) const;
+
+    /**
+     * \brief       Number of entries with key < val, or key <= val if
+     *          inclusive. One descent adding up left subtree sizes.
+     */
+    template<typename K>
+    unsigned long long privateCountBelow(const K& val, bool inclusive) const;
+
+    /**
+     * \brief       Returns the k-th smallest node, 0-based, walking down by
+     *          left subtree sizes. nullptr if k is out of range.
+     */
+    Node<kType, dType, OrderStatistics, Augment>* privateSelect(unsigned long long k) const;
+
+    /**
+     * \brief       Finds the node in which the newly created node can be
+     *          inserted at. If the Node->left/right is null, insert the node
+     *          param in that place.
      *
-     * \details     Constructs an empty tree.
+     * @param root Node we start transcending down from.
+     * @param node Node/leaf we are inserting into the tree.
+     *
+     * @return Boolean if the node was successfully inserted.
      */
-    RedBlackTree();
+    bool privateInsert(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>* node);
 
     /**
-     * \brief       Constructs a tree with the following two params.
+     * \brief       Helper function that calls other methods upon insertion
+     *          of the tree.
      *
-     * \details     Constucts a tree with one initial node. rootKey is the starting
-     *          key value for the root of the tree, and rootData as the data value
-     *          for that key.
+     * \details     Helper function that calls other methods upon insertion
+     *          of the tree. First finds where key goes. Only if key is new
+     *          is the node built, with key and data constructed in place, and
+     *          linked in as a red leaf. Since we have the node as a ptr, we
+     *          call privateInsertAdjustTree to calibrate that(and parents)
+     *          node to match the rules of a red black tree.
      *
-     * @param rootKey Key value of the data entry.
-     * @param rootData Data value for that key entry.
+     * @param root Node that we start from.
+     * @param key Key of the node being inserted. Must be comparable with
+     *          kType by comp, and is forwarded to the kType constructor.
+     * @param args Forwarded to the dType constructor.
+     * @return Boolean if the node was successfully inserted.
      */
-    RedBlackTree(kType rootKey, dType rootData);
+    template<typename K, typename... Args>
+    bool privateRedBlackInsert(Node<kType, dType, OrderStatistics, Augment>* root, K&& key, Args&&... args);
 
     /**
-     * \brief       Returns the total entries of the tree.
+     * \brief       Finds where key goes using a node next to it instead of
+     *          a descent from the root, like privateFindInsertPosition.
      *
-     * @return Unsigned long long size of the total nodes in the tree.
+     * \details     The neighbour of hint on key's side is found through the
+     *          parent links. If key lies between the two, the new leaf hangs
+     *          off whichever of them has a free child link on the inside.
+     *          O(1) amortized for consecutive keys, no key comparisons beyond
+     *          the two neighbours.
+     *
+     * @param hint Node next to where key goes, nullptr for past the largest.
+     * @param key Key to insert.
+     * @param parent Set to the node the new leaf hangs off.
+     * @param goLeft Set to true if the new leaf is parent's left child.
+     * @param existing Set to the node holding key if it is in the tree.
+     * @return False if key does not belong next to hint.
      */
-    unsigned long long getTotalSize() {return this->totalNodes;}
+    template<typename K>
+    bool privateFindHintPosition(Node<kType, dType, OrderStatistics, Augment>* hint, const K& key, Node<kType, dType, OrderStatistics, Augment>*& parent,
+                                 bool& goLeft, Node<kType, dType, OrderStatistics, Augment>*& existing) const;
 
     /**
-     * \details     Attempts an insertion into the tree with the two
-     *          given params. Calls the privateInsert function to build
-     *          onto the tree. Returns false if inserting the node results
-     *          in a collision.
+     * \brief       Insert starting from hint, falling back to a descent from
+     *          the root if key does not belong next to it.
      *
-     * @param key Key value of node being inserted.
-     * @param data Data value of node being inserted.
-     * @return Bool if inserting into the tree was successful.
+     * @param hint Node next to where key goes, nullptr for past the largest.
+     * @param inserted Set to true if a node was inserted.
+     * @return Node holding key, new or existing.
      */
-    bool insert(kType key, dType data);
+    template<typename K, typename... Args>
+    Node<kType, dType, OrderStatistics, Augment>* privateHintedInsert(Node<kType, dType, OrderStatistics, Augment>* hint, bool& inserted, K&& key, Args&&... args);
 
     /**
-     * \details     Attempts to remove an item from the tree.
-     * @param key
-     * @return
+     * \brief       Recursive standard BST function to the find the node we want to delete.
+     *
+     * @param root Node from where to start from.
      */
-    bool remove(kType key);
+    void privateDeleteBST(Node<kType, dType, OrderStatistics, Augment>* root);
 
     /**
-     * \details     Searches the tree for search key parameter and if
-     *          if exists in the tree, returns true. Else returns false
-     *          since entry is not in tree. dataPtr param is a pointer
-     *          to an object that is to be filled with what is from
-     *          the tree.
+     * \brief       Function that is called with the node we want to delete.
      *
-     * @param sKey Search Key to be searched against in the tree.
-     * @param dataPtr Pointer to data type that is to be copied into.
-     * @return Bool depending if search key is in the tree.
+     * \details     Function called with the param root, this root is the node
+     *          that we are deleting. Upon deleting, we proceed with the standard
+     *          delete case in a BST. Before the leaf node is replaced/deleted, we
+     *          set the appropriate variables like replacedColor and deletedColor
+     *          to find the best case.
+     *          Initial Steps:
+     *          -If deleted Node has 2 Null children, x->nullptr
+     *          -If deleted Node has 1 Null children, x->non-nullptr child.
+     *          -If deleted Node has 0 Null childrem, x->replacement->right(could be null)
+     *
+     *          Other Steps:
+     *          -If the node we deleted is red and its replacement is red or nullptr,
+     *          we are done.
+     *          -If the node we deleted is red and its replacement is black, color the
+     *          replacement red and proceed to CASES 0-4.
+     *          -If the node we deleted is black and its replacement is red, color the
+     *          replacement black, we are done.
+     *          -If the node we deleted is black and its replacement is null or black,
+     *          proceed to cases 0-4.
+     *
+     *          Cases:
+     *          -Case Zero: Node x is red.
+     *          -Case One: Node x is black and sibling is red
+     *          -Case Two: Node x is black and sibling is black and both children of
+     *          sibling is black.
+     *          -Case Three: Node x is black and sibling is black with:
+     *              -If x is left child, siblings left child is red and right is black.
+     *              -If x is right child, siblings right child is red and left is black.
+     *          -Case Four: Node x is black and sibling is black with:
+     *              -If x is left child, sibling right is red.
+     *              -If x is right childm sibling left is red.
+     * @param root
      */
-    bool search(const kType& sKey, dType* dataPtr);
+    void privateDelete(Node<kType, dType, OrderStatistics, Augment>* root);
 
-    void printInorder();
-    void printTreeFromRoot(kType rootVal);
-    void printTreeFromRoot();
+    /**
+     * \brief       Swaps the places of root and its in-order successor in
+     *          the tree. Both keep their own color.
+     *
+     * @param root Node with two children.
+     * @param successor Smallest node of root->right.
+     */
+    void privateSwapWithSuccessor(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>* successor);
 
+    /**
+     * \brief       Finds the node we want to delete with privateSearch.
+     *          Upon finding the node to delete, call privateDelete.
+     *
+     * @param root Node from where to start from.
+     * @param key Key to remove, anything comp can compare against kType.
+     */
+    template<typename K>
+    bool privateRemove(Node<kType, dType, OrderStatistics, Augment>* root, const K& key);
 
     /**
-     * Debugging puposes only.
+     * \brief       Performs a left rotate on the root node. Sets the
+     *          pivot node to roots->right child.
+     *
+     * @param root Node to perform left rotate on.
+     * @param top Root slot of the tree root is in, moved to the pivot if
+     *          it pointed at root.
      */
-    void debugInsertRecursive(std::shared_ptr<Node<kType, dType>> &root, std::shared_ptr<Node<kType, dType>> &node);
-    void debugInsert(kType key, dType data, Color color);
-};
+    static void privateLeftRotate(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>*& top);
+    void privateLeftRotate(Node<kType, dType, OrderStatistics, Augment>* root);
 
-template<typename kType, typename dType>
-RedBlackTree<kType, dType>::RedBlackTree(kType rootKey, dType rootData)
-{
-    this->root = std::make_shared<Node<kType, dType>>();
-    this->root->key = rootKey;
-    this->root->data = rootData;
-    this->root->color = Color::black;
-    this->totalNodes = 1;
-}
+    /**
+     * \brief       Performs a right rotate on the root node. Sets the
+     *          pivot node to roots->left child.
+     *
+     * @param root Node to perform right rotate on.
+     * @param top Root slot of the tree root is in, moved to the pivot if
+     *          it pointed at root.
+     */
+    static void privateRightRotate(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>*& top);
+    void privateRightRotate(Node<kType, dType, OrderStatistics, Augment>* root);
+
+    /**
+     * \brief Debugging print inorder method. Walks the parent links, so it
+     *          needs no stack.
+     * @param root To start from.
+     */
+    void privatePrintInorder(Node<kType, dType, OrderStatistics, Augment>* root);
+
+    /**
+     * \brief       isValid for the subtree at root, whose keys must lie
+     *          strictly between low and high where those are not nullptr.
+     *
+     * @param blackHeight Set to the black nodes on every path down from root.
+     * @param count Set to the nodes of the subtree.
+     */
+    bool privateIsValid(const Node<kType, dType, OrderStatistics, Augment>* root, const Node<kType, dType, OrderStatistics, Augment>* low,
+                        const Node<kType, dType, OrderStatistics, Augment>* high, unsigned& blackHeight, unsigned long long& count) const;
+    void privatePrintTreeFromRoot(Node<kType, dType, OrderStatistics, Augment>* root);
+
+    /**
+     * \brief       Finds the largest value from the root Node.
+     *
+     * \details     Follows right links from the root Node to find the
+     *          largest value.
+     *
+     * @param root Node starting point.
+     *
+     * @return Node<kType, dType, OrderStatistics, Augment>* of the largest Node.
+     */
+    static Node<kType, dType, OrderStatistics, Augment>* privateFindLargest(Node<kType, dType, OrderStatistics, Augment>* root);
+
+    /**
+     * \brief       Finds the smalled value from the root Node.
+     *
+     * \details     Follows left links from the root Node to find the
+     *          smallest value.
+     *
+     * @param root Node starting point.
+     *
+     * @return Node<kType, dType, OrderStatistics, Augment>* of the smallest Node.
+     */
+    static Node<kType, dType, OrderStatistics, Augment>* privateFindSmallest(Node<kType, dType, OrderStatistics, Augment>* root);
+
+    /**
+     * \brief       Finds the key value from the root Node. Else nullptr.
+     *
+     * \details     Loops down from root doing one comparison per level. A
+     *          three-way comparator returns as soon as it hits val. With a
+     *          less than comparator, going left whenever the node isn't
+     *          smaller than val leaves the last such node as the only
+     *          candidate, which one more comparison confirms or rejects.
+     *
+     * @param root Node starting point.
+     * @param val Key to look for, anything comp can compare against kType.
+     *
+     * @return Node<kType, dType, OrderStatistics, Augment>* of the search Node.
+     */
+    template<typename K>
+    Node<kType, dType, OrderStatistics, Augment>* privateSearch(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const;
+
+    /**
+     * Lookups searchBatch keeps in flight at once, enough to cover a memory
+     * miss with the work on the others.
+     */
+    static constexpr std::size_t SEARCH_BATCH_WIDTH = 16;
+
+    /**
+     * Below this many entries the tree mostly sits in cache, where plain
+     * descents win over interleaved ones.
+     */
+    static constexpr unsigned long long SEARCH_BATCH_MIN_SIZE = 1ULL << 18;
+
+    static void privatePrefetch(const void* address);
+
+    /**
+     * True if entries can be saved and loaded as raw bytes.
+     */
+    static constexpr bool SNAPSHOT_TYPES = std::is_trivially_copyable_v<kType> && std::is_trivially_copyable_v<dType>;
+
+    /**
+     * Snapshot file layout, all in native byte order:
+     *      "RBTS", uint32 version, uint32 sizeof(kType), uint32 sizeof(dType),
+     *      uint64 entry count, the entries (key bytes then data bytes) in key
+     *      order, uint64 XXH64 (seed 0) of everything before it.
+     */
+    static constexpr char SNAPSHOT_MAGIC[4] = {'R', 'B', 'T', 'S'};
+    static constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+    static constexpr std::size_t SNAPSHOT_HEADER_SIZE = 4 + 3 * sizeof(std::uint32_t) + sizeof(std::uint64_t);
+    static constexpr std::size_t SNAPSHOT_ENTRY_SIZE = sizeof(kType) + sizeof(dType);
+
+    /**
+     * Bytes save and load move per write or read.
+     */
+    static constexpr std::size_t SNAPSHOT_CHUNK_SIZE = std::size_t(1) << 20;
+
+    /**
+     * Snapshot checksum, XXH64 fed in pieces. Four independent lanes take
+     * 8 bytes each per step, so hashing keeps up with reading instead of
+     * waiting on one multiply per byte.
+     */
+    struct SnapshotHash
+    {
+        static constexpr std::uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+        static constexpr std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+        static constexpr std::uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+        static constexpr std::uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+        static constexpr std::uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+        static constexpr std::size_t STRIPE = 32;
+
+        std::uint64_t lanes[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+        unsigned char pending[STRIPE];
+        std::size_t pendingBytes = 0;
+        std::uint64_t totalBytes = 0;
+
+        /**
+         * \brief       Folds count bytes into the hash.
+         */
+        void update(const unsigned char* bytes, std::size_t count);
+
+        /**
+         * \brief       The hash of every byte so far.
+         */
+        std::uint64_t digest() const;
+
+        static std::uint64_t round(std::uint64_t lane, std::uint64_t word);
+        static std::uint64_t read64(const unsigned char* bytes);
+        void stripe(const unsigned char* bytes);
+    };
+
+    /**
+     * \brief       Builds the header of a snapshot of count entries.
+     */
+    static void privateSnapshotHeader(unsigned char* header, std::uint64_t count);
+
+    /**
+     * \brief       Returns the in-order successor of node, or nullptr if node
+     *          holds the largest key. Uses the parent links.
+     *
+     * @param node Node to step from.
+     */
+    static Node<kType, dType, OrderStatistics, Augment>* privateSuccessor(Node<kType, dType, OrderStatistics, Augment>* node);
+
+    /**
+     * \brief       Returns the in-order predecessor of node, or nullptr if
+     *          node holds the smallest key. Uses the parent links.
+     *
+     * @param node Node to step from.
+     */
+    static Node<kType, dType, OrderStatistics, Augment>* privatePredecessor(Node<kType, dType, OrderStatistics, Augment>* node);
+
+    /**
+     * \brief       Returns true if a orders before b. Three-way comparators
+     *          still only get called once.
+     */
+    template<typename A, typename B>
+    bool privateLess(const A& a, const B& b) const;
+
+    /**
+     * \brief       Hands key back as is if comp can take it directly, else
+     *          converts it to kType once, so a descent doesn't build a
+     *          temporary per level.
+     */
+    template<typename K>
+    static decltype(auto) privateLookupKey(const K& key);
+
+    /**
+     * \brief       Bound descents. Each walks down from root once doing one
+     *          comparison per level and remembers the last node that
+     *          qualified.
+     *
+     *          -privateLowerBound: smallest node with key >= val.
+     *          -privateUpperBound: smallest node with key > val.
+     *          -privateFloor: largest node with key <= val.
+     *          -privateBelow: largest node with key < val.
+     *
+     * @param root Node starting point.
+     * @param val Key to compare against, anything comp takes.
+     * @return The node, nullptr if there is none.
+     */
+    template<typename K>
+    Node<kType, dType, OrderStatistics, Augment>* privateLowerBound(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const;
+    template<typename K>
+    Node<kType, dType, OrderStatistics, Augment>* privateUpperBound(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const;
+    template<typename K>
+    Node<kType, dType, OrderStatistics, Augment>* privateFloor(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const;
+    template<typename K>
+    Node<kType, dType, OrderStatistics, Augment>* privateBelow(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const;
+
+    /**
+     * \brief       Checks if Case Zero is applicable. Returns true if so.
+     *          Else false.
+     *
+     * \details     Returns true if x is red.
+     *
+     * @param x Node x to check if Case Zero.
+     *
+     * @return Boolean true/false if is case zero.
+     */
+    bool privateCheckCaseZero(Node<kType, dType, OrderStatistics, Augment>* x);
+
+    /**
+     * \brief       Checks if Case One is applicable. Returns true if so.
+     *          Else false.
+     *
+     * \details     Returns true if x is black and sibling w is red.
+     *
+     * @param x Node x to check if black.
+     * @param w Node w to check if red.
+     *
+     * @return Boolean true/false if is case one.
+     */
+    bool privateCheckCaseOne(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w);
+
+    /**
+     * \brief       Check if Case Two is applicable. Returns true if so.
+     *          Else false
+     *
+     * \details     Returns true if x is black and sibling w is black
+     *          and sibling w's childed are both black.
+     *
+     * @param x Node x to check if black.
+     * @param w Node w to check if black and children are black.
+     *
+     * @return Boolean true/false if is case two.
+     */
+    bool privateCheckCaseTwo(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w);
+
+    /**
+     * \brief       Check if Case Three is applicable. Returns true if so.
+     *          Else false.
+     *
+     * \details     Returns true if x is black and sibling w is black along with:
+     *          -If x is left child, and w->left is red and w->right is black.
+     *          -If x is right child, and w->right is red and w->left is black.
+     *
+     * @param x Node x to check if black.
+     * @param w Node w to check if black and one child is red.
+     * @param parent Parent of x and W. Used to find if the child is left or right.
+     *
+     * @return Boolean true/false if the case is three.
+     */
+    bool privateCheckCaseThree(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w, Node<kType, dType, OrderStatistics, Augment>* parent);
+
+    /**
+     * \brief       Check if Case Four is applicable. Returns true if so.
+     *          Else false.
+     *
+     * \details     Returns true if x is black and sibling w is black along with:
+     *          -If x is left child, w->right is red.
+     *          -If x is right child, w->left is red.
+     *
+     * @param x Node x to check if black.
+     * @param w Node w to check if black and one child is red.
+     * @param parent Parent of x and W. Used to find if the child is left or right.
+     *
+     * @return Boolean true/false if the case is four.
+     */
+    bool privateCheckCaseFour(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w, Node<kType, dType, OrderStatistics, Augment>* parentw);
+
+    /**
+     * \brief       Adjusts x Node to fit case zero.
+     *
+     * \details     Colors x Node black. Does not branch to other cases.
+     *
+     * @param x Node that is of case zero.
+     */
+    void privateCaseZero(Node<kType, dType, OrderStatistics, Augment>* x);
+
+    /**
+     * \brief       Adjusts x Node, w Node, and parent Node to match that of
+     *          case one to a Red Black BST.
+     *
+     * \details     Node x is black and w is red. Color w black. Color x parent red.
+     *          Rotate parent depending on if x is left child, then left rotation, etc.
+     *          Adjust w to the new sibling. Branch to next case 2-4 depending on results.
+     *
+     * @param x Node that is of case one.
+     * @param w Sibling of Node x.
+     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     */
+    void privateCaseOne(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w, Node<kType, dType, OrderStatistics, Augment>* parent);
+
+    /**
+     * \brief       Adjusts x Node, w Node, and Parent Node to match that of
+     *          case two to a Red Black BST.
+     *
+     * \details     Node x is black, w is black, and both children of w are black.
+     *          Color w red. Set x to parent. If x is red, color black. Else proceed
+     *          to cases 1-4 based on result.
+     *
+     * @param x Node that is of case one.
+     * @param w Sibling of Node x.
+     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     */
+    void privateCaseTwo(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w, Node<kType, dType, OrderStatistics, Augment>* parent);
+
+    /**
+     * \brief       Adjusts x Node, w Node, and parent Node to match that of
+     *          case three to a Red Black BST.
+     *
+     * \details     Node x is black, w is black, and one child of w is red.
+     *          If x is left child, then w's left child is red and right is black. Else
+     *          conversely with x is right child, then w's right child is red and left
+     *          is black. Color the red child black, color w red. Rotate w based on left
+     *          or right. Adjust w to the new w since the rotate. Proceed to case 4.
+     *
+     * @param x Node that is of case one.
+     * @param w Sibling of Node x.
+     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     */
+    void privateCaseThree(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w, Node<kType, dType, OrderStatistics, Augment>* parent);
+
+    /**
+     * \brief       Adjusts x Node, w Node, and parent Node to match that of
+     *          case four to a Red Black BST.
+     *
+     * \details     Node x is black, w is black and w's right child is red with x
+     *          being pointed to by the left. Conversily flipped as well. w gets set
+     *          to parents color. Parent gets colored black. Color w's child black.
+     *          Rotate the parent left if x is left child. Right if else. Then we are
+     *          done, don't branch to another case.
+     *
+     * @param x Node that is of case one.
+     * @param w Sibling of Node x.
+     * @param parent Node that is parent of x. X can be null. Parent is needed.
+     */
+    void privateCaseFour(Node<kType, dType, OrderStatistics, Augment>* x, Node<kType, dType, OrderStatistics, Augment>* w, Node<kType, dType, OrderStatistics, Augment>* parent);
+public:
+    /**
+     * \brief       Bidirectional iterator over the entries in key order.
+     *
+     * \details     Steps with the parent links, so a full walk touches every
+     *          edge twice, O(1) amortized per step, and needs no stack. end()
+     *          is the null node; decrementing it lands on the largest entry.
+     *
+     *          Key and data live side by side in the node rather than in a
+     *          std::pair, so dereferencing gives a pair of references,
+     *          (const key, data), the same shape as a std::map entry. Only
+     *          removing the entry an iterator points at invalidates it.
+     *
+     * @tparam IsConst True for const_iterator, whose data is read only.
+     */
+    template<bool IsConst>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = std::pair<kType, dType>;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::pair<const kType&, std::conditional_t<IsConst, const dType&, dType&>>;
+
+        /**
+         * Holds the reference pair so operator-> has something to point at.
+         */
+        class pointer
+        {
+        public:
+            explicit pointer(reference entry) : entry(entry) {}
+            const reference* operator->() const {return &this->entry;}
+        private:
+            reference entry;
+        };
+
+        Iterator() = default;
+
+        /**
+         * iterator converts to const_iterator, not the other way around.
+         */
+        template<bool OtherConst> requires (IsConst && !OtherConst)
+        Iterator(const Iterator<OtherConst>& other) : node(other.node), tree(other.tree) {}
+
+        reference operator*() const {return reference(this->node->key, this->node->data);}
+        pointer operator->() const {return pointer(**this);}
+
+        Iterator& operator++()
+        {
+            this->node = RedBlackTree::privateSuccessor(this->node);
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        Iterator& operator--()
+        {
+            if(this->node == nullptr)
+                this->node = this->tree->root != nullptr ? RedBlackTree::privateFindLargest(this->tree->root) : nullptr;
+            else
+                this->node = RedBlackTree::privatePredecessor(this->node);
+            return *this;
+        }
+
+        Iterator operator--(int)
+        {
+            Iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) {return a.node == b.node;}
+
+    private:
+        friend class RedBlackTree;
+        friend class Iterator<!IsConst>;
+
+        Iterator(Node<kType, dType, OrderStatistics, Augment>* node, const RedBlackTree* tree) : node(node), tree(tree) {}
+
+        Node<kType, dType, OrderStatistics, Augment>* node = nullptr;
+        const RedBlackTree* tree = nullptr;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    /**
+     * \brief       Constructs an empty tree.
+     *
+     * \details     Constructs an empty tree.
+     */
+    RedBlackTree();
+
+    /**
+     * \brief       Constructs an empty tree ordered by comp.
+     *
+     * @param comp Comparator instance used for every key comparison.
+     */
+    explicit RedBlackTree(const Compare& comp);
+
+    /**
+     * \brief       Constructs a tree with the following two params.
+     *
+     * \details     Constucts a tree with one initial node. rootKey is the starting
+     *          key value for the root of the tree, and rootData as the data value
+     *          for that key.
+     *
+     * @param rootKey Key value of the data entry.
+     * @param rootData Data value for that key entry.
+     */
+    RedBlackTree(kType rootKey, dType rootData);
+
+    /**
+     * \brief       Destroys every node of the tree.
+     */
+    ~RedBlackTree();
+
+    /**
+     * \brief       Takes over the nodes of other, leaving other empty.
+     */
+    RedBlackTree(RedBlackTree&& other) noexcept;
+    RedBlackTree& operator=(RedBlackTree&& other) noexcept;
+
+    /**
+     * Nodes have a single owner, trees can't be copied.
+     */
+    RedBlackTree(const RedBlackTree&) = delete;
+    RedBlackTree& operator=(const RedBlackTree&) = delete;
+
+    /**
+     * \brief       Returns the total entries of the tree.
+     *
+     * @return Unsigned long long size of the total nodes in the tree.
+     */
+    unsigned long long getTotalSize() const;
+
+    /**
+     * \brief       Returns the bytes of node memory the tree's pool holds,
+     *          in use or free. Chunks holding nodes a split handed to
+     *          another tree count for this one only.
+     */
+    std::size_t getReservedBytes() const {return this->nodePool.getReservedBytes();}
+
+    /**
+     * \details     Attempts an insertion into the tree with the two
+     *          given params. Calls the privateInsert function to build
+     *          onto the tree. Returns false if inserting the node results
+     *          in a collision.
+     *
+     * @param key Key value of node being inserted.
+     * @param data Data value of node being inserted.
+     * @return Bool if inserting into the tree was successful.
+     */
+    bool insert(kType key, dType data);
+
+    /**
+     * \details     Inserts a new entry, constructing the key from key and
+     *          the data from args right inside the node. If key is already in
+     *          the tree, nothing is constructed (besides a temporary kType
+     *          when key has to be converted before it can be compared).
+     *
+     * @param key Forwarded to the kType constructor.
+     * @param args Forwarded to the dType constructor.
+     * @return Bool if inserting into the tree was successful.
+     */
+    template<typename K, typename... Args>
+    bool emplace(K&& key, Args&&... args);
+
+    /**
+     * \details     Inserts key with data constructed in place from args.
+     *          If key is already in the tree, args are left untouched, so
+     *          moved-in values are not lost.
+     *
+     * @param key Key value of node being inserted.
+     * @param args Forwarded to the dType constructor.
+     * @return Bool if inserting into the tree was successful.
+     */
+    template<typename... Args>
+    bool try_emplace(const kType& key, Args&&... args);
+    template<typename... Args>
+    bool try_emplace(kType&& key, Args&&... args);
+
+    /**
+     * \details     Replaces the contents of the tree with the entries of
+     *          [first, last), which must be sorted by key with no repeats.
+     *          All nodes are carved out of chunks of their own, laid out in
+     *          key order, and linked into a balanced, correctly colored tree in
+     *          a single O(n) pass; nothing is compared or rotated.
+     *
+     *          Entries are (key, data) pairs or tuples. Use move iterators
+     *          to move them in. If constructing an entry throws, the tree is
+     *          left as it was.
+     *
+     *          The old nodes' memory is given back, except chunks still
+     *          holding nodes a split handed to another tree.
+     *
+     * @param first First entry.
+     * @param last One past the last entry.
+     */
+    template<std::input_iterator It> requires (std::forward_iterator<It> || std::sized_sentinel_for<It, It>)
+    void assignSorted(It first, It last);
+
+    /**
+     * \details     Same as assignSorted, for entries in any order. They are
+     *          copied out, sorted, and for repeated keys the first one wins
+     *          (like inserting them one after the other), then built in one
+     *          pass. O(n log n) for the sort, but no rebalancing.
+     */
+    template<std::input_iterator It>
+    void assign(It first, It last);
+
+    /**
+     * \details     Removes every entry and gives the node memory back.
+     */
+    void clear();
+
+    /**
+     * \details     Moves every entry into chunks of their own, packed in key
+     *          order, and gives the old memory back, so chunks left partly
+     *          used by removes don't stay around. O(n). Entries are copied
+     *          instead if their move can throw, and if that throws the tree
+     *          is left as it was.
+     */
+    void shrink_to_fit();
+
+    /**
+     * \details     Writes every entry to a snapshot file at path, which load
+     *          reads back. The entries are streamed out in key order as raw
+     *          bytes behind a header with a version and the key and data
+     *          sizes, followed by a checksum. They are written to path.tmp
+     *          first and moved over path at the end, so a failed save leaves
+     *          an older snapshot at path intact.
+     *
+     *          Only for trivially copyable kType and dType. The bytes are in
+     *          native byte order, so a snapshot loads on the same kind of
+     *          machine it was saved on.
+     *
+     * @param path File to write.
+     * @return False if the file could not be written.
+     */
+    bool save(const std::string& path) const requires SNAPSHOT_TYPES;
+
+    /**
+     * \details     Replaces the contents of the tree with a snapshot written
+     *          by save. The nodes are constructed straight from the file
+     *          into one allocation and linked like assignSorted, O(n) with
+     *          no comparisons beyond checking the keys are in order.
+     *
+     *          Fails without touching the tree if the file can't be read, has
+     *          the wrong magic, version or sizes, is truncated or too long,
+     *          has keys out of order, or its checksum doesn't match.
+     *
+     * @param path File to read.
+     * @return False if the snapshot was not loaded.
+     */
+    bool load(const std::string& path) requires SNAPSHOT_TYPES;
+
+    /**
+     * \brief       One operation for applyBatch. data is only used by inserts.
+     */
+    struct BatchOperation
+    {
+        BatchOpType type;
+        kType key;
+        dType data{};
+    };
+
+    /**
+     * \details     Applies a batch of inserts and removes, with the same
+     *          results as running them one after another in the given order.
+     *
+     *          Batches with at least a sixteenth as many operations as the
+     *          tree has entries are stably sorted by key (operations on
+     *          different keys commute, the ones on the same key keep their
+     *          order) and applied in key order, so consecutive descents
+     *          share their cached path. When the batch has at least as many
+     *          operations as the tree has entries, the tree and the batch
+     *          are merged in one in-order pass and the result is built next
+     *          to the old nodes, which only go once it is complete; if an
+     *          exception escapes that path the tree is left as it was.
+     *
+     * @param operations The batch, moved from.
+     * @return For each operation, in the given order, what insert/remove
+     *          would have returned.
+     */
+    std::vector<bool> applyBatch(std::vector<BatchOperation> operations);
+
+    /**
+     * \details     Splits the tree at key in O(log n). This tree keeps every
+     *          key below key, the returned tree gets key (if present) and
+     *          every key above it.
+     *
+     *          No node is copied or moved: the returned tree gets a pool
+     *          of its own for new nodes, and the nodes it takes along stay in
+     *          this tree's chunks, which count them. Once either tree is
+     *          dropped, every chunk only it used goes back to the system.
+     *          Without OrderStatistics, getTotalSize of either tree counts
+     *          its nodes once, O(n), on the next call.
+     *
+     * @param key Smallest key of the returned tree.
+     * @return Tree of every entry with a key not below key.
+     */
+    template<typename K> requires LookupKey<K, kType, Compare>
+    RedBlackTree split(const K& key);
+
+    /**
+     * \details     Appends key/data and then every entry of other to this
+     *          tree in O(log n). Every key of this tree must be below key,
+     *          and key below every key of other.
+     *
+     *          other is left empty; its nodes (and its pool) now belong to
+     *          this tree.
+     *
+     * @param key Key of the pivot entry.
+     * @param data Data of the pivot entry.
+     * @param other Tree of keys above key.
+     * @return False, with neither tree changed, if the keys are not in order.
+     */
+    bool join(kType key, dType data, RedBlackTree&& other);
+
+    /**
+     * \details     Appends every entry of other to this tree in O(log n).
+     *          Every key of this tree must be below every key of other.
+     *          other is left empty.
+     *
+     * @param other Tree of keys above this tree's.
+     * @return False, with neither tree changed, if the keys are not in order.
+     */
+    bool join(RedBlackTree&& other);
+
+    /**
+     * \details     Adds every entry of other whose key is not in this tree
+     *          yet; on equal keys this tree's data stays. O(m log(n/m + 1))
+     *          for tree sizes m <= n, so merging a small tree into a big one
+     *          costs about as much as inserting it, and two trees of equal
+     *          size merge in linear time.
+     *
+     *          Independent subtrees are worked on as tasks on pool, so up
+     *          to as many at once as it has workers. other is left empty.
+     *
+     * @param other Tree to merge in.
+     * @param pool Pool to run on, a pool of one thread to stay on the
+     *          calling thread.
+     */
+    void unionWith(RedBlackTree&& other, ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * \details     Keeps only the entries whose key is also in other. Same
+     *          cost and threading as unionWith. other is left empty.
+     *
+     * @param other Tree of keys to keep.
+     * @param pool Pool to run on.
+     */
+    void intersectWith(RedBlackTree&& other, ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * \details     Removes every entry whose key is in other. Same cost and
+     *          threading as unionWith. other is left empty.
+     *
+     * @param other Tree of keys to remove.
+     * @param pool Pool to run on.
+     */
+    void subtract(RedBlackTree&& other, ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * \details     Calls visitor(key, data) on every entry, spread over the
+     *          workers of pool. The tree is cut into subtrees near the root
+     *          and each one is walked in key order by a single task, but the
+     *          tasks run concurrently and in no particular order, so visitor
+     *          must be safe to call from several threads at once. The tree
+     *          must not be changed until the call returns.
+     *
+     *          If visitor throws, the first exception is rethrown once every
+     *          task has finished; some entries may not have been visited.
+     *
+     * @param visitor Callable taking (const kType&, dType&).
+     * @param pool Pool to run on, the shared one by default.
+     */
+    template<typename Visitor>
+    void parallel_for_each(Visitor&& visitor, ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * \details     Same as parallel_for_each above, visitor gets
+     *          (const kType&, const dType&).
+     */
+    template<typename Visitor>
+    void parallel_for_each(Visitor&& visitor, ThreadPool& pool = ThreadPool::shared()) const;
+
+    /**
+     * \details     Returns identity combined with map(key, data) of every
+     *          entry, in key order, computed on the workers of pool. Each
+     *          subtree of the cut is folded from identity by one task, and
+     *          the partial results are combined in key order, so as long as
+     *          combine is associative and identity leaves values unchanged
+     *          the result equals a sequential fold over the tree; combine
+     *          need not be commutative.
+     *
+     * @param identity Starting value of every partial result.
+     * @param map Callable taking (const kType&, const dType&), result
+     *          convertible to T. Called from several threads at once.
+     * @param combine Callable taking (T, T) returning T.
+     * @param pool Pool to run on, the shared one by default.
+     */
+    template<typename T, typename Map, typename Combine>
+    T parallel_reduce(T identity, Map&& map, Combine&& combine, ThreadPool& pool = ThreadPool::shared()) const;
+
+    /**
+     * \details     Returns a new tree with the same keys and data
+     *          fn(key, data), built on the workers of pool. The copy has the
+     *          same shape as this tree, node for node, so no key is compared.
+     *          The Augment policy is not carried over, as its summaries are
+     *          over dType.
+     *
+     *          fn is called from several threads at once. If it throws, the
+     *          first exception is rethrown and nothing is left behind.
+     *
+     * @param fn Callable taking (const kType&, const dType&).
+     * @param pool Pool to run on, the shared one by default.
+     */
+    template<typename Fn>
+    TransformedTree<Fn> parallel_transform(Fn&& fn, ThreadPool& pool = ThreadPool::shared()) const;
+
+    /**
+     * \details     Returns a new tree with a copy of every entry for which
+     *          pred(key, data) is true, built on the workers of pool. The
+     *          subtrees of the cut are filtered by separate tasks, then the
+     *          kept entries are copied and linked in parallel like
+     *          assignSorted, so no key is compared or rotated. Apart from one
+     *          sequential pass gathering the kept nodes, the work is split
+     *          evenly over the workers.
+     *
+     *          pred is called from several threads at once. If it or a copy
+     *          throws, the exception is passed on and nothing is left behind.
+     *
+     * @param pred Callable taking (const kType&, const dType&).
+     * @param pool Pool to run on, the shared one by default.
+     */
+    template<typename Pred>
+    RedBlackTree parallel_filter(Pred&& pred, ThreadPool& pool = ThreadPool::shared()) const;
+
+    /**
+     * \details     Same as assign, with the work spread over the workers of
+     *          pool: the entries are copied out, sorted in chunks by separate
+     *          tasks and merged pairwise, then the first of every run of
+     *          equal keys is built into the tree in parallel. If copying or
+     *          constructing an entry throws, the tree is left as it was.
+     *
+     * @param first First entry.
+     * @param last One past the last entry.
+     * @param pool Pool to run on, the shared one by default.
+     */
+    template<std::input_iterator It>
+    void parallel_assign(It first, It last, ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * \details     Attempts to remove an item from the tree.
+     * @param key Key value of the node being removed.
+     * @return Bool if the key was in the tree and got removed.
+     */
+    bool remove(const kType& key);
+
+    /**
+     * \details     Same as remove(key), but for transparent comparators the
+     *          key can be any type comp compares against kType, so no
+     *          temporary kType has to be built.
+     */
+    template<typename K> requires HeterogeneousKey<K, kType, Compare>
+    bool remove(const K& key);
+
+    /**
+     * \details     Searches the tree for search key parameter and if
+     *          if exists in the tree, returns true. Else returns false
+     *          since entry is not in tree. dataPtr param is a pointer
+     *          to an object that is to be filled with what is from
+     *          the tree.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @param dataPtr Pointer to data type that is to be copied into.
+     * @return Bool depending if search key is in the tree.
+     */
+    bool search(const kType& sKey, dType* dataPtr) const;
+
+    /**
+     * \details     Same as search(sKey, dataPtr), but for transparent
+     *          comparators sKey can be any type comp compares against kType,
+     *          e.g. a std::string_view or const char* for std::string keys.
+     */
+    template<typename K> requires HeterogeneousKey<K, kType, Compare>
+    bool search(const K& sKey, dType* dataPtr) const;
+
+    /**
+     * \details     Looks up sKey and hands back a pointer to the data inside
+     *          the node, so nothing is copied. The pointer stays valid until
+     *          that entry is removed or the tree is destroyed.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @return Pointer to the data of sKey, nullptr if it isn't in the tree.
+     */
+    dType* find(const kType& sKey);
+    const dType* find(const kType& sKey) const;
+
+    /**
+     * \details     Looks up every key of keys and sets out[i] to the data of
+     *          keys[i] like find, nullptr if it isn't in the tree. out is
+     *          resized to match.
+     *
+     *          Instead of one descent after the other, 16 descents go down
+     *          together, one level of each in turn, and every step
+     *          prefetches the node that descent visits next. By the time a
+     *          descent comes around again its node is usually in cache, so
+     *          up to 16 cache misses overlap instead of stalling one at a
+     *          time. A descent that reaches the bottom hands its place to the
+     *          next key. Trees small enough to sit in cache are searched one
+     *          key after the other instead, which is faster there.
+     *
+     * @param keys Keys to look up, in any order, repeats allowed.
+     * @param out Set to one pointer per key.
+     * @return Number of keys found.
+     */
+    std::size_t searchBatch(const std::vector<kType>& keys, std::vector<const dType*>& out) const;
+
+    /**
+     * \details     Same as find(sKey), taking any key type a transparent
+     *          comparator compares against kType.
+     */
+    template<typename K> requires HeterogeneousKey<K, kType, Compare>
+    dType* find(const K& sKey);
+    template<typename K> requires HeterogeneousKey<K, kType, Compare>
+    const dType* find(const K& sKey) const;
+
+    /**
+     * \details     Returns true if sKey is in the tree. Nothing is copied.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     */
+    bool contains(const kType& sKey) const;
+    template<typename K> requires HeterogeneousKey<K, kType, Compare>
+    bool contains(const K& sKey) const;
+
+    /**
+     * \details     Returns a reference to the data of sKey inside its node.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @return Reference to the data of sKey.
+     * @throws std::out_of_range if sKey is not in the tree.
+     */
+    dType& at(const kType& sKey);
+    const dType& at(const kType& sKey) const;
+    template<typename K> requires HeterogeneousKey<K, kType, Compare>
+    dType& at(const K& sKey);
+    template<typename K> requires HeterogeneousKey<K, kType, Compare>
+    const dType& at(const K& sKey) const;
+
+    /**
+     * \details     Iterators over the entries in key order. Removing an
+     *          entry only invalidates iterators pointing at it.
+     */
+    iterator begin() {return iterator(this->root != nullptr ? privateFindSmallest(this->root) : nullptr, this);}
+    iterator end() {return iterator(nullptr, this);}
+    const_iterator begin() const {return const_iterator(this->root != nullptr ? privateFindSmallest(this->root) : nullptr, this);}
+    const_iterator end() const {return const_iterator(nullptr, this);}
+    const_iterator cbegin() const {return begin();}
+    const_iterator cend() const {return end();}
+    reverse_iterator rbegin() {return reverse_iterator(end());}
+    reverse_iterator rend() {return reverse_iterator(begin());}
+    const_reverse_iterator rbegin() const {return const_reverse_iterator(end());}
+    const_reverse_iterator rend() const {return const_reverse_iterator(begin());}
+    const_reverse_iterator crbegin() const {return rbegin();}
+    const_reverse_iterator crend() const {return rend();}
+
+    /**
+     * \details     Inserts key/data near hint, like std::map's hinted insert.
+     *          If key goes right before or after hint, its neighbours are
+     *          reached through the parent links instead of a descent from the
+     *          root, so inserting keys in (near) order with the previous
+     *          result as hint costs amortized O(1) plus the rebalancing.
+     *          Otherwise this is a plain insert.
+     *
+     * @param hint Entry next to where key goes, end() for past the largest.
+     * @param key Key value of node being inserted.
+     * @param data Data value of node being inserted.
+     * @return Iterator to the entry with key, new or already there.
+     */
+    iterator insert(const_iterator hint, kType key, dType data);
+
+    /**
+     * \details     Inserts key/data using the entry of the last insert (of
+     *          any kind) as hint. Made for keys that arrive almost in order,
+     *          e.g. timestamps or sequence ids.
+     *
+     * @param key Key value of node being inserted.
+     * @param data Data value of node being inserted.
+     * @return Bool if inserting into the tree was successful.
+     */
+    bool append(kType key, dType data);
+
+    /**
+     * \details     Ordered lookups, each a single O(log n) descent. Keys can
+     *          be anything a transparent comparator takes, or anything that
+     *          converts to kType. All return end() if there is no such entry.
+     *
+     *          -lower_bound/ceiling: first entry with key >= sKey.
+     *          -upper_bound/successor: first entry with key > sKey.
+     *          -floor: last entry with key <= sKey.
+     *          -predecessor: last entry with key < sKey.
+     *          -equal_range: [lower_bound, upper_bound), at most one entry.
+     *
+     *          sKey doesn't have to be in the tree.
+     */
+    template<typename K> requires LookupKey<K, kType, Compare>
+    iterator lower_bound(const K& sKey) {return iterator(privateLowerBound(this->root, privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator lower_bound(const K& sKey) const {return const_iterator(privateLowerBound(this->root, privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    iterator upper_bound(const K& sKey) {return iterator(privateUpperBound(this->root, privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator upper_bound(const K& sKey) const {return const_iterator(privateUpperBound(this->root, privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    std::pair<iterator, iterator> equal_range(const K& sKey);
+    template<typename K> requires LookupKey<K, kType, Compare>
+    std::pair<const_iterator, const_iterator> equal_range(const K& sKey) const;
+
+    template<typename K> requires LookupKey<K, kType, Compare>
+    iterator ceiling(const K& sKey) {return lower_bound(sKey);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator ceiling(const K& sKey) const {return lower_bound(sKey);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    iterator floor(const K& sKey) {return iterator(privateFloor(this->root, privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator floor(const K& sKey) const {return const_iterator(privateFloor(this->root, privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    iterator successor(const K& sKey) {return upper_bound(sKey);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator successor(const K& sKey) const {return upper_bound(sKey);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    iterator predecessor(const K& sKey) {return iterator(privateBelow(this->root, privateLookupKey(sKey)), this);}
+    template<typename K> requires LookupKey<K, kType, Compare>
+    const_iterator predecessor(const K& sKey) const {return const_iterator(privateBelow(this->root, privateLookupKey(sKey)), this);}
+
+    /**
+     * \details     Number of entries with key < sKey, i.e. the 0-based
+     *          position sKey has or would have in key order. O(log n).
+     *          Only for OrderStatistics trees.
+     */
+    template<typename K> requires (OrderStatistics && LookupKey<K, kType, Compare>)
+    unsigned long long rank(const K& sKey) const;
+
+    /**
+     * \details     Returns the k-th smallest entry, 0-based, or end() if
+     *          k >= getTotalSize(). O(log n). Only for OrderStatistics trees.
+     *
+     * @param k Position in key order.
+     */
+    iterator select(unsigned long long k) requires OrderStatistics {return iterator(privateSelect(k), this);}
+    const_iterator select(unsigned long long k) const requires OrderStatistics {return const_iterator(privateSelect(k), this);}
+
+    /**
+     * \details     Number of entries with lo <= key <= hi, without visiting
+     *          them. O(log n). Only for OrderStatistics trees.
+     */
+    template<typename K> requires (OrderStatistics && LookupKey<K, kType, Compare>)
+    unsigned long long count(const K& lo, const K& hi) const;
+
+    /**
+     * \details     Augment summary of every entry with lo <= key <= hi, e.g.
+     *          the sum, min or max of their data. One descent to where the
+     *          paths to lo and hi split, then one down each side picking up
+     *          whole subtree summaries, so O(log n). Only for augmented trees.
+     *
+     * @return Augment::identity() if the range is empty.
+     */
+    template<typename K> requires LookupKey<K, kType, Compare>
+    typename Augment::summary_type aggregate(const K& lo, const K& hi) const requires AUGMENTED;
+
+    /**
+     * \details     Summary of the whole tree, O(1).
+     */
+    typename Augment::summary_type aggregate() const requires AUGMENTED {return privateSummary(this->root);}
+
+    /**
+     * \details     Calls fn(data) on the data of sKey and then refreshes the
+     *          summaries above it. Writes through find, at or an iterator
+     *          don't do that, so on augmented trees data should be changed
+     *          with update.
+     *
+     * @return False if sKey isn't in the tree.
+     */
+    template<typename K, typename Fn> requires LookupKey<K, kType, Compare>
+    bool update(const K& sKey, Fn&& fn);
+
+    /**
+     * \details     Returns an interval overlapping [lo, hi], i.e. with
+     *          start <= hi and end >= lo, or end() if there is none. O(log n).
+     *          Only for interval policies (see IntervalAugment).
+     */
+    const_iterator findOverlap(const kType& lo, const kType& hi) const requires IntervalAugmentPolicy<Augment, kType, dType>;
+
+    /**
+     * \details     Calls visitor(start, data) on every interval overlapping
+     *          [lo, hi], in start order. Subtrees that end before lo or start
+     *          after hi are skipped, so only paths leading to reported
+     *          intervals are walked, at most O((k + 1) log n) for k of them.
+     *          If visitor returns bool, returning false stops.
+     *
+     * @return Number of intervals visited.
+     */
+    template<typename Visitor>
+    unsigned long long overlaps(const kType& lo, const kType& hi, Visitor&& visitor) const requires IntervalAugmentPolicy<Augment, kType, dType>;
+
+    /**
+     * \details     Calls visitor(key, data) on every entry with
+     *          lo <= key <= hi, in key order. One descent finds lo, then the
+     *          walk follows the parent links, so it costs O(log n + k) for k
+     *          visited entries. If visitor returns bool, returning false
+     *          stops the scan.
+     *
+     * @param lo Smallest key to visit.
+     * @param hi Largest key to visit.
+     * @param visitor Callable taking (const kType&, dType&).
+     * @return Number of entries visited.
+     */
+    template<typename K, typename Visitor> requires LookupKey<K, kType, Compare>
+    unsigned long long scan(const K& lo, const K& hi, Visitor&& visitor);
+
+    /**
+     * \details     Same as scan above, visitor gets (const kType&, const dType&).
+     */
+    template<typename K, typename Visitor> requires LookupKey<K, kType, Compare>
+    unsigned long long scan(const K& lo, const K& hi, Visitor&& visitor) const;
+
+    /**
+     * \details     Returns a read only copy of the tree in one flat array
+     *          with a pointer free, branchless search (see
+     *          FrozenRedBlackTree). O(n). Defined in FrozenRedBlackTree.h,
+     *          which has to be included to call it.
+     */
+    FrozenRedBlackTree<kType, dType, Compare> freeze() const;
+
+    void printInorder();
+    void printTreeFromRoot(kType rootVal);
+    void printTreeFromRoot();
+
+    /**
+     * \brief       Checks key order, parent links, the red black rules, the
+     *          subtree and tree sizes kept and, where summaries can be
+     *          compared with ==, every Augment summary against the one
+     *          recomputed from its children. O(n), for tests and debugging.
+     *
+     * @return True if every check passes.
+     */
+    bool isValid() const;
+
+
+    /**
+     * Debugging puposes only.
+     */
+    void debugInsertRecursive(Node<kType, dType, OrderStatistics, Augment>* &root, Node<kType, dType, OrderStatistics, Augment>* &node);
+    void debugInsert(kType key, dType data, Color color);
+};
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::RedBlackTree(kType rootKey, dType rootData)
+{
+    this->root = createLeaf(std::move(rootKey), std::move(rootData));
+    this->root->setColor(Color::black);
+    privateSetSize(1);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::RedBlackTree() {}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::RedBlackTree(const Compare& comp) : comp(comp) {}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::~RedBlackTree()
+{
+    privateDestroyTree(this->root);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::RedBlackTree(RedBlackTree&& other) noexcept
+    : comp(std::move(other.comp)), nodePool(std::move(other.nodePool)), root(other.root), totalNodes(other.totalNodes.load(std::memory_order_relaxed)),
+      lastInserted(other.lastInserted)
+{
+    other.root = nullptr;
+    other.lastInserted = nullptr;
+    other.privateSetSize(0);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>& RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::operator=(RedBlackTree&& other) noexcept
+{
+    if(this != &other)
+    {
+        privateDestroyTree(this->root);
+        this->comp = std::move(other.comp);
+        this->nodePool = std::move(other.nodePool);
+        this->root = other.root;
+        privateSetSize(other.totalNodes.load(std::memory_order_relaxed));
+        this->lastInserted = other.lastInserted;
+        other.root = nullptr;
+        other.lastInserted = nullptr;
+        other.privateSetSize(0);
+    }
+    return *this;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K, typename... Args>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::createLeaf(K&& key, Args&&... args)
+{
+    void* block = this->nodePool.allocate(sizeof(Node<kType, dType, OrderStatistics, Augment>));
+
+    try {
+        return new (block) Node<kType, dType, OrderStatistics, Augment>(std::forward<K>(key), std::forward<Args>(args)...);
+    }
+    catch(...) {
+        this->nodePool.deallocate(block, sizeof(Node<kType, dType, OrderStatistics, Augment>));
+        throw;
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::destroyLeaf(Node<kType, dType, OrderStatistics, Augment>* node)
+{
+    if(node == this->lastInserted)
+        this->lastInserted = nullptr;
+
+    node->~Node<kType, dType, OrderStatistics, Augment>();
+    this->nodePool.deallocate(node, sizeof(Node<kType, dType, OrderStatistics, Augment>));
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateDestroyTree(Node<kType, dType, OrderStatistics, Augment>* root)
+{
+    if(root != nullptr)
+    {
+        privateDestroyTree(root->left);
+        privateDestroyTree(root->right);
+        destroyLeaf(root);
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::BulkBlocks RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateAcquireBlocks(std::size_t count)
+{
+    BulkBlocks blocks;
+    blocks.run = this->nodePool.allocateRun(count);
+    blocks.count = count;
+    return blocks;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateReleaseBlocks(BulkBlocks& blocks)
+{
+    this->nodePool.deallocateRun(blocks.run, blocks.count);
+    blocks.run = NodePool::Run();
+    blocks.count = 0;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCommitBlocks()
+{
+    privateDestroyTree(this->root);
+    this->root = nullptr;
+    this->nodePool.trim();
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCloneEntry(void* block, Node<kType, dType, OrderStatistics, Augment>* node)
+{
+    constexpr bool NOTHROW_MOVE = std::is_nothrow_move_constructible_v<kType> && std::is_nothrow_move_constructible_v<dType>;
+    constexpr bool COPYABLE = std::is_copy_constructible_v<kType> && std::is_copy_constructible_v<dType>;
+
+    if constexpr(NOTHROW_MOVE || !COPYABLE)
+        new (block) Node<kType, dType, OrderStatistics, Augment>(std::move(node->key), std::move(node->data));
+    else
+        new (block) Node<kType, dType, OrderStatistics, Augment>(std::as_const(node->key), std::as_const(node->data));
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateBuildBalanced(const BulkBlocks& blocks, std::size_t lo, std::size_t hi, unsigned depth,
+                                                                                                                            unsigned redDepth, Node<kType, dType, OrderStatistics, Augment>* parent)
+{
+    if(lo >= hi)
+        return nullptr;
+
+    std::size_t mid = lo + (hi - lo) / 2;
+    Node<kType, dType, OrderStatistics, Augment>* node = blocks[mid];
+
+    node->setParent(parent);
+    node->setColor(depth == redDepth ? Color::red : Color::black);
+    node->left = privateBuildBalanced(blocks, lo, mid, depth + 1, redDepth, node);
+    node->right = privateBuildBalanced(blocks, mid + 1, hi, depth + 1, redDepth, node);
+    privateUpdateNode(node);
+
+    return node;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<std::input_iterator It> requires (std::forward_iterator<It> || std::sized_sentinel_for<It, It>)
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::assignSorted(It first, It last)
+{
+    const std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+    BulkBlocks blocks = privateAcquireBlocks(count);
+
+    // Construct every node in key order first, so the links can be laid
+    // over them afterwards.
+    std::size_t built = 0;
+    try {
+        for(; first != last; ++first, ++built)
+        {
+            auto&& entry = *first;
+            new (blocks[built]) Node<kType, dType, OrderStatistics, Augment>(std::get<0>(std::forward<decltype(entry)>(entry)),
+                                                                              std::get<1>(std::forward<decltype(entry)>(entry)));
+        }
+    }
+    catch(...) {
+        for(std::size_t i = 0; i < built; i++)
+            blocks[i]->~Node();
+        privateReleaseBlocks(blocks);
+        throw;
+    }
+
+    privateCommitBlocks();
+    this->root = privateBuildBalanced(blocks, 0, count, 0, (unsigned)std::bit_width(count + 1) - 1, nullptr);
+    privateSetSize(count);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<std::input_iterator It>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::assign(It first, It last)
+{
+    std::vector<std::pair<kType, dType>> entries;
+    if constexpr(std::forward_iterator<It>)
+        entries.reserve(static_cast<std::size_t>(std::distance(first, last)));
+
+    for(; first != last; ++first)
+    {
+        auto&& entry = *first;
+        entries.emplace_back(std::get<0>(std::forward<decltype(entry)>(entry)), std::get<1>(std::forward<decltype(entry)>(entry)));
+    }
+
+    // Stable, so the first of equal keys stays in front and survives unique.
+    std::stable_sort(entries.begin(), entries.end(), [this](const auto& a, const auto& b) {return privateLess(a.first, b.first);});
+    auto end = std::unique(entries.begin(), entries.end(), [this](const auto& a, const auto& b) {return !privateLess(a.first, b.first);});
+
+    assignSorted(std::make_move_iterator(entries.begin()), std::make_move_iterator(end));
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::clear()
+{
+    privateDestroyTree(this->root);
+    this->root = nullptr;
+    this->nodePool.reset();
+    privateSetSize(0);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::shrink_to_fit()
+{
+    const std::size_t count = (std::size_t)getTotalSize();
+    BulkBlocks blocks = privateAcquireBlocks(count);
+
+    std::size_t built = 0;
+    try {
+        for(auto node = this->root != nullptr ? privateFindSmallest(this->root) : nullptr; node != nullptr; node = privateSuccessor(node), built++)
+            privateCloneEntry(blocks[built], node);
+    }
+    catch(...) {
+        for(std::size_t i = 0; i < built; i++)
+            blocks[i]->~Node();
+        privateReleaseBlocks(blocks);
+        throw;
+    }
+
+    privateCommitBlocks();
+    this->root = privateBuildBalanced(blocks, 0, count, 0, (unsigned)std::bit_width(count + 1) - 1, nullptr);
+    privateSetSize(count);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+std::uint64_t RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::SnapshotHash::round(std::uint64_t lane, std::uint64_t word)
+{
+    return std::rotl(lane + word * PRIME2, 31) * PRIME1;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+std::uint64_t RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::SnapshotHash::read64(const unsigned char* bytes)
+{
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::SnapshotHash::stripe(const unsigned char* bytes)
+{
+    for(std::size_t i = 0; i < 4; i++)
+        this->lanes[i] = round(this->lanes[i], read64(bytes + 8 * i));
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::SnapshotHash::update(const unsigned char* bytes, std::size_t count)
+{
+    this->totalBytes += count;
+
+    // Top up a stripe left over from the last call first.
+    if(this->pendingBytes > 0)
+    {
+        const std::size_t take = std::min(count, STRIPE - this->pendingBytes);
+        std::memcpy(this->pending + this->pendingBytes, bytes, take);
+        this->pendingBytes += take;
+        bytes += take;
+        count -= take;
+
+        if(this->pendingBytes < STRIPE)
+            return;
+        stripe(this->pending);
+        this->pendingBytes = 0;
+    }
+
+    for(; count >= STRIPE; bytes += STRIPE, count -= STRIPE)
+        stripe(bytes);
+
+    std::memcpy(this->pending, bytes, count);
+    this->pendingBytes = count;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+std::uint64_t RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::SnapshotHash::digest() const
+{
+    std::uint64_t hash;
+    if(this->totalBytes >= STRIPE)
+    {
+        hash = std::rotl(this->lanes[0], 1) + std::rotl(this->lanes[1], 7) + std::rotl(this->lanes[2], 12) + std::rotl(this->lanes[3], 18);
+        for(std::uint64_t lane : this->lanes)
+            hash = (hash ^ round(0, lane)) * PRIME1 + PRIME4;
+    }
+    else
+        hash = PRIME5;
+
+    hash += this->totalBytes;
+
+    // The tail, 8, then 4, then 1 byte at a time.
+    std::size_t i = 0;
+    for(; i + 8 <= this->pendingBytes; i += 8)
+        hash = std::rotl(hash ^ round(0, read64(this->pending + i)), 27) * PRIME1 + PRIME4;
+    if(i + 4 <= this->pendingBytes)
+    {
+        std::uint32_t word;
+        std::memcpy(&word, this->pending + i, sizeof(word));
+        hash = std::rotl(hash ^ (word * PRIME1), 23) * PRIME2 + PRIME3;
+        i += 4;
+    }
+    for(; i < this->pendingBytes; i++)
+        hash = std::rotl(hash ^ (this->pending[i] * PRIME5), 11) * PRIME1;
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSnapshotHeader(unsigned char* header, std::uint64_t count)
+{
+    const std::uint32_t fields[3] = {SNAPSHOT_VERSION, (std::uint32_t)sizeof(kType), (std::uint32_t)sizeof(dType)};
+    std::memcpy(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    std::memcpy(header + sizeof(SNAPSHOT_MAGIC), fields, sizeof(fields));
+    std::memcpy(header + sizeof(SNAPSHOT_MAGIC) + sizeof(fields), &count, sizeof(count));
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::save(const std::string& path) const requires SNAPSHOT_TYPES
+{
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if(!file)
+            return false;
+
+        std::vector<unsigned char> buffer(SNAPSHOT_HEADER_SIZE);
+        privateSnapshotHeader(buffer.data(), getTotalSize());
+        buffer.reserve(SNAPSHOT_CHUNK_SIZE + SNAPSHOT_ENTRY_SIZE);
+
+        SnapshotHash hash;
+        auto flush = [&] {
+            hash.update(buffer.data(), buffer.size());
+            file.write(reinterpret_cast<const char*>(buffer.data()), (std::streamsize)buffer.size());
+            buffer.clear();
+        };
+
+        auto append = [&](const kType& key, const dType& data) {
+            const std::size_t end = buffer.size();
+            buffer.resize(end + SNAPSHOT_ENTRY_SIZE);
+            std::memcpy(buffer.data() + end, &key, sizeof(kType));
+            std::memcpy(buffer.data() + end + sizeof(kType), &data, sizeof(dType));
+            if(buffer.size() >= SNAPSHOT_CHUNK_SIZE)
+                flush();
+        };
+        privateForEach(this->root, append);
+        flush();
+
+        const std::uint64_t checksum = hash.digest();
+        file.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+        file.close();
+        if(!file)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if(error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::load(const std::string& path) requires SNAPSHOT_TYPES
+{
+    std::ifstream file(path, std::ios::binary);
+    unsigned char header[SNAPSHOT_HEADER_SIZE];
+    if(!file || !file.read(reinterpret_cast<char*>(header), SNAPSHOT_HEADER_SIZE))
+        return false;
+
+    // Everything but the count has to match what save writes for this tree.
+    std::uint64_t count = 0;
+    std::memcpy(&count, header + SNAPSHOT_HEADER_SIZE - sizeof(count), sizeof(count));
+    unsigned char expected[SNAPSHOT_HEADER_SIZE];
+    privateSnapshotHeader(expected, count);
+    if(std::memcmp(header, expected, SNAPSHOT_HEADER_SIZE) != 0)
+        return false;
+
+    // Check the size before allocating, so a bad count can't ask for
+    // more memory than the file could fill.
+    std::error_code error;
+    const std::uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if(error || count > (fileSize - SNAPSHOT_HEADER_SIZE) / SNAPSHOT_ENTRY_SIZE
+       || fileSize != SNAPSHOT_HEADER_SIZE + count * SNAPSHOT_ENTRY_SIZE + sizeof(std::uint64_t))
+        return false;
+
+    BulkBlocks blocks = privateAcquireBlocks((std::size_t)count);
+    SnapshotHash hash;
+    hash.update(header, SNAPSHOT_HEADER_SIZE);
+
+    std::vector<unsigned char> buffer;
+    std::array<unsigned char, sizeof(kType)> key;
+    std::array<unsigned char, sizeof(dType)> data;
+    std::size_t built = 0;
+    bool valid = true;
+    while(valid && built < count)
+    {
+        const std::size_t entries = std::min<std::size_t>((std::size_t)count - built, std::max<std::size_t>(1, SNAPSHOT_CHUNK_SIZE / SNAPSHOT_ENTRY_SIZE));
+        buffer.resize(entries * SNAPSHOT_ENTRY_SIZE);
+        if(!file.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize)buffer.size()))
+        {
+            valid = false;
+            break;
+        }
+        hash.update(buffer.data(), buffer.size());
+
+        for(std::size_t i = 0; i < entries && valid; i++)
+        {
+            std::memcpy(key.data(), buffer.data() + i * SNAPSHOT_ENTRY_SIZE, sizeof(kType));
+            std::memcpy(data.data(), buffer.data() + i * SNAPSHOT_ENTRY_SIZE + sizeof(kType), sizeof(dType));
+            auto node = new (blocks[built]) Node<kType, dType, OrderStatistics, Augment>(std::bit_cast<kType>(key), std::bit_cast<dType>(data));
+            built++;
+
+            // Keys must keep going up, or the links laid over them are wrong.
+            if(built > 1)
+                valid = privateLess(blocks[built - 2]->key, node->key);
+        }
+    }
+
+    std::uint64_t checksum = 0;
+    valid = valid && file.read(reinterpret_cast<char*>(&checksum), sizeof(checksum)) && checksum == hash.digest();
+
+    if(!valid)
+    {
+        for(std::size_t i = 0; i < built; i++)
+            blocks[i]->~Node();
+        privateReleaseBlocks(blocks);
+        return false;
+    }
+
+    privateCommitBlocks();
+    this->root = privateBuildBalanced(blocks, 0, (std::size_t)count, 0, (unsigned)std::bit_width(count + 1) - 1, nullptr);
+    privateSetSize(count);
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+std::vector<bool> RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::applyBatch(std::vector<BatchOperation> operations)
+{
+    std::vector<bool> results(operations.size(), false);
+
+    // Same as insert/remove. Only moves from op if it gets inserted.
+    auto apply = [this](BatchOperation& op) {
+        if(op.type == BatchOpType::insert)
+            return privateRedBlackInsert(this->root, std::move(op.key), std::move(op.data));
+
+        return privateRemove(this->root, op.key);
+    };
+
+    // Too sparse for neighbouring descents to share anything, sorting would
+    // only cost. Apply them as they come. After a split only a bound is
+    // known, counting would cost O(n); an overestimate just keeps the batch
+    // off the rebuild path.
+    const unsigned long long size = privateSizeBound();
+    if(operations.size() < size / 16)
+    {
+        for(std::size_t i = 0; i < operations.size(); i++)
+            results[i] = apply(operations[i]);
+
+        return results;
+    }
+
+    std::vector<std::size_t> order(operations.size());
+    for(std::size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {return privateLess(operations[a].key, operations[b].key);});
+
+    // Batch about as big as the tree: merge the two in one in-order pass and
+    // rebuild, O(n + k) instead of O(k log n).
+    if(operations.size() >= size)
+    {
+        // Decide first, comparing only, where every entry of the result
+        // comes from: a tree node or the insert that put it there. Nothing
+        // is moved yet, so a throwing comparator leaves the tree as it was.
+        std::vector<std::pair<Node<kType, dType, OrderStatistics, Augment>*, std::size_t>> sources;
+        sources.reserve(std::min<unsigned long long>(size, operations.size()) + operations.size());
+
+        auto node = this->root != nullptr ? privateFindSmallest(this->root) : nullptr;
+        std::size_t next = 0;
+
+        while(node != nullptr || next < order.size())
+        {
+            // Take the smaller key; on a tie the tree entry goes first and
+            // its operations are applied to it.
+            std::pair<Node<kType, dType, OrderStatistics, Augment>*, std::size_t> source{nullptr, order.size()};
+            const kType* key;
+            if(node != nullptr && (next == order.size() || !privateLess(operations[order[next]].key, node->key)))
+            {
+                source.first = node;
+                key = &node->key;
+                node = privateSuccessor(node);
+            }
+            else
+                key = &operations[order[next]].key;
+
+            bool present = source.first != nullptr;
+            for(; next < order.size() && !privateLess(*key, operations[order[next]].key); next++)
+            {
+                const BatchOperation& op = operations[order[next]];
+
+                if(op.type == BatchOpType::insert && !present)
+                {
+                    source = {nullptr, order[next]};
+                    present = true;
+                    results[order[next]] = true;
+                }
+                else if(op.type == BatchOpType::remove && present)
+                {
+                    present = false;
+                    results[order[next]] = true;
+                }
+            }
+
+            if(present)
+                sources.push_back(source);
+        }
+
+        // Then build on the side; the old nodes only go once all are built.
+        BulkBlocks blocks = privateAcquireBlocks(sources.size());
+        std::size_t built = 0;
+        try {
+            for(; built < sources.size(); built++)
+            {
+                if(sources[built].first != nullptr)
+                    privateCloneEntry(blocks[built], sources[built].first);
+                else
+                {
+                    BatchOperation& op = operations[sources[built].second];
+                    new (blocks[built]) Node<kType, dType, OrderStatistics, Augment>(std::move(op.key), std::move(op.data));
+                }
+            }
+        }
+        catch(...) {
+            for(std::size_t i = 0; i < built; i++)
+                blocks[i]->~Node();
+            privateReleaseBlocks(blocks);
+            throw;
+        }
+
+        privateCommitBlocks();
+        this->root = privateBuildBalanced(blocks, 0, built, 0, (unsigned)std::bit_width(built + 1) - 1, nullptr);
+        privateSetSize(built);
+        return results;
+    }
+
+    // Otherwise apply them in key order, so neighbouring descents walk the
+    // same, already cached, upper path.
+    for(std::size_t index : order)
+        results[index] = apply(operations[index]);
+
+    return results;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+unsigned RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateBlackHeight(const Node<kType, dType, OrderStatistics, Augment>* root)
+{
+    unsigned height = 0;
+    for(; root != nullptr; root = root->left)
+    {
+        if(root->getColor() == Color::black)
+            height++;
+    }
+
+    return height;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSetSize(unsigned long long count) const
+{
+    this->totalNodes.store(count, std::memory_order_relaxed);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateAddSize(long long delta)
+{
+    const unsigned long long count = this->totalNodes.load(std::memory_order_relaxed);
+    if(count != UNKNOWN_SIZE)
+        this->totalNodes.store(count + (unsigned long long)delta, std::memory_order_relaxed);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateKnownSize() const
+{
+    if constexpr(OrderStatistics)
+        return privateSubtreeSize(this->root);
+    else
+        return this->totalNodes.load(std::memory_order_relaxed);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSizeBound() const
+{
+    const unsigned long long count = privateKnownSize();
+    if(count != UNKNOWN_SIZE)
+        return count;
+
+    // A path holds at most one red node per black one plus a red root, so
+    // the tree is at most 2 * blackHeight + 1 levels deep.
+    const unsigned levels = 2 * privateBlackHeight(this->root) + 1;
+    return levels >= 64 ? UNKNOWN_SIZE - 1 : (1ULL << levels) - 1;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+unsigned RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateDetach(Node<kType, dType, OrderStatistics, Augment>* root, unsigned height)
+{
+    if(root == nullptr)
+        return height;
+
+    root->setParent(nullptr);
+
+    // A red root turned black adds one black node to every path.
+    if(root->getColor() == Color::red)
+    {
+        root->setColor(Color::black);
+        height++;
+    }
+
+    return height;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateJoin(Node<kType, dType, OrderStatistics, Augment>* left, unsigned leftHeight, Node<kType, dType, OrderStatistics, Augment>* pivot,
+                                                                                Node<kType, dType, OrderStatistics, Augment>* right, unsigned rightHeight, unsigned& height)
+{
+    pivot->setParent(nullptr);
+
+    if(leftHeight == rightHeight)
+    {
+        pivot->left = left;
+        pivot->right = right;
+        if(left != nullptr)
+            left->setParent(pivot);
+        if(right != nullptr)
+            right->setParent(pivot);
+
+        pivot->setColor(Color::black);
+        privateUpdateNode(pivot);
+        height = leftHeight + 1;
+        return pivot;
+    }
+
+    const bool leftTaller = leftHeight > rightHeight;
+    Node<kType, dType, OrderStatistics, Augment>* tall = leftTaller ? left : right;
+    Node<kType, dType, OrderStatistics, Augment>* shorter = leftTaller ? right : left;
+    const unsigned shortHeight = leftTaller ? rightHeight : leftHeight;
+
+    // Walk the inner spine down to the first black node (or null link) with
+    // the shorter tree's black height. tall is black and higher, so this
+    // takes at least one step.
+    Node<kType, dType, OrderStatistics, Augment>* parent = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* node = tall;
+    unsigned nodeHeight = leftTaller ? leftHeight : rightHeight;
+
+    while(node != nullptr && (node->getColor() == Color::red || nodeHeight != shortHeight))
+    {
+        if(node->getColor() == Color::black)
+            nodeHeight--;
+
+        parent = node;
+        node = leftTaller ? node->right : node->left;
+    }
+
+    pivot->left = leftTaller ? node : shorter;
+    pivot->right = leftTaller ? shorter : node;
+    if(pivot->left != nullptr)
+        pivot->left->setParent(pivot);
+    if(pivot->right != nullptr)
+        pivot->right->setParent(pivot);
+
+    pivot->setColor(Color::red);
+    pivot->setParent(parent);
+    if(leftTaller)
+        parent->right = pivot;
+    else
+        parent->left = pivot;
+
+    // Every node above pivot gained the shorter tree.
+    privateUpdatePath(pivot);
+
+    Node<kType, dType, OrderStatistics, Augment>* top = tall;
+    height = (leftTaller ? leftHeight : rightHeight) + (privateInsertAdjustTree(pivot, top) ? 1 : 0);
+    return top;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateJoin(Node<kType, dType, OrderStatistics, Augment>* left, unsigned leftHeight,
+                                                                                Node<kType, dType, OrderStatistics, Augment>* right, unsigned rightHeight, unsigned& height)
+{
+    if(left == nullptr)
+    {
+        height = rightHeight;
+        return right;
+    }
+
+    Node<kType, dType, OrderStatistics, Augment>* lower = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* upper = nullptr;
+    unsigned lowerHeight = 0;
+    unsigned upperHeight = 0;
+
+    Node<kType, dType, OrderStatistics, Augment>* pivot = privateSplit(left, leftHeight, privateFindLargest(left)->key, lower, lowerHeight, upper, upperHeight);
+    return privateJoin(lower, lowerHeight, pivot, right, rightHeight, height);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSplit(Node<kType, dType, OrderStatistics, Augment>* root, unsigned height, const K& key,
+                                                                                 Node<kType, dType, OrderStatistics, Augment>*& left, unsigned& leftHeight,
+                                                                                 Node<kType, dType, OrderStatistics, Augment>*& right, unsigned& rightHeight)
+{
+    if(root == nullptr)
+    {
+        left = nullptr;
+        right = nullptr;
+        leftHeight = 0;
+        rightHeight = 0;
+        return nullptr;
+    }
+
+    // Cut root out, its subtrees become trees of their own.
+    const unsigned childHeight = height - (root->getColor() == Color::black ? 1 : 0);
+    Node<kType, dType, OrderStatistics, Augment>* lower = root->left;
+    Node<kType, dType, OrderStatistics, Augment>* upper = root->right;
+    unsigned lowerHeight = privateDetach(lower, childHeight);
+    unsigned upperHeight = privateDetach(upper, childHeight);
+    root->left = nullptr;
+    root->right = nullptr;
+
+    if(privateLess(key, root->key))
+    {
+        Node<kType, dType, OrderStatistics, Augment>* match = privateSplit(lower, lowerHeight, key, left, leftHeight, right, rightHeight);
+        right = privateJoin(right, rightHeight, root, upper, upperHeight, rightHeight);
+        return match;
+    }
+
+    if(privateLess(root->key, key))
+    {
+        Node<kType, dType, OrderStatistics, Augment>* match = privateSplit(upper, upperHeight, key, left, leftHeight, right, rightHeight);
+        left = privateJoin(lower, lowerHeight, root, left, leftHeight, leftHeight);
+        return match;
+    }
+
+    left = lower;
+    right = upper;
+    leftHeight = lowerHeight;
+    rightHeight = upperHeight;
+    return root;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires LookupKey<K, kType, Compare>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment> RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::split(const K& key)
+{
+    RedBlackTree upperTree(this->comp);
+
+    Node<kType, dType, OrderStatistics, Augment>* top = this->root;
+    Node<kType, dType, OrderStatistics, Augment>* lower = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* upper = nullptr;
+    unsigned lowerHeight = 0;
+    unsigned upperHeight = 0;
+
+    Node<kType, dType, OrderStatistics, Augment>* match = privateSplit(top, privateBlackHeight(top), privateLookupKey(key), lower, lowerHeight, upper, upperHeight);
+    if(match != nullptr)
+        upper = privateJoin(nullptr, 0, match, upper, upperHeight, upperHeight);
+
+    this->root = lower;
+    upperTree.root = upper;
+
+    if(this->lastInserted != nullptr && !privateLess(this->lastInserted->key, privateLookupKey(key)))
+    {
+        upperTree.lastInserted = this->lastInserted;
+        this->lastInserted = nullptr;
+    }
+
+    // Sizes of the halves are not known without walking them, unless one
+    // of them got everything.
+    if(lower == nullptr)
+    {
+        upperTree.privateSetSize(this->totalNodes.load(std::memory_order_relaxed));
+        privateSetSize(0);
+    }
+    else if(upper != nullptr)
+    {
+        privateSetSize(UNKNOWN_SIZE);
+        upperTree.privateSetSize(UNKNOWN_SIZE);
+    }
+
+    return upperTree;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::join(kType key, dType data, RedBlackTree&& other)
+{
+    if(this == &other)
+        return false;
+    if(this->root != nullptr && !privateLess(privateFindLargest(this->root)->key, key))
+        return false;
+    if(other.root != nullptr && !privateLess(key, privateFindSmallest(other.root)->key))
+        return false;
+
+    Node<kType, dType, OrderStatistics, Augment>* pivot = createLeaf(std::move(key), std::move(data));
+
+    try {
+        this->nodePool.merge(std::move(other.nodePool));
+    }
+    catch(...) {
+        destroyLeaf(pivot);
+        throw;
+    }
+
+    unsigned height = 0;
+    Node<kType, dType, OrderStatistics, Augment>* top = privateJoin(this->root, privateBlackHeight(this->root), pivot, other.root, privateBlackHeight(other.root), height);
+
+    const unsigned long long mine = this->totalNodes.load(std::memory_order_relaxed);
+    const unsigned long long theirs = other.totalNodes.load(std::memory_order_relaxed);
+    this->root = top;
+    privateSetSize(mine == UNKNOWN_SIZE || theirs == UNKNOWN_SIZE ? UNKNOWN_SIZE : mine + theirs + 1);
+    other.root = nullptr;
+    other.privateSetSize(0);
+    other.lastInserted = nullptr;
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::join(RedBlackTree&& other)
+{
+    if(this == &other)
+        return false;
+    if(this->root != nullptr && other.root != nullptr && !privateLess(privateFindLargest(this->root)->key, privateFindSmallest(other.root)->key))
+        return false;
+
+    this->nodePool.merge(std::move(other.nodePool));
+
+    unsigned height = 0;
+    Node<kType, dType, OrderStatistics, Augment>* top = privateJoin(this->root, privateBlackHeight(this->root), other.root, privateBlackHeight(other.root), height);
+
+    const unsigned long long mine = this->totalNodes.load(std::memory_order_relaxed);
+    const unsigned long long theirs = other.totalNodes.load(std::memory_order_relaxed);
+    this->root = top;
+    privateSetSize(mine == UNKNOWN_SIZE || theirs == UNKNOWN_SIZE ? UNKNOWN_SIZE : mine + theirs);
+    other.root = nullptr;
+    other.privateSetSize(0);
+    other.lastInserted = nullptr;
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSetOperation(SetOperation op, Node<kType, dType, OrderStatistics, Augment>* a, unsigned aHeight, Node<kType, dType, OrderStatistics, Augment>* b, unsigned bHeight,
+                                                                                        unsigned& height, DroppedNodes& dropped, unsigned spawnDepth, ThreadPool& pool)
+{
+    if(a == nullptr || b == nullptr)
+    {
+        // Union keeps whichever side is left, difference only a, intersection nothing.
+        const bool keep = a != nullptr ? op != SetOperation::intersect : op == SetOperation::unite;
+        Node<kType, dType, OrderStatistics, Augment>* rest = a != nullptr ? a : b;
+
+        if(keep)
+        {
+            height = a != nullptr ? aHeight : bHeight;
+            return rest;
+        }
+
+        if(rest != nullptr)
+            dropped.add(rest);
+        height = 0;
+        return nullptr;
+    }
+
+    // Cut a's root out and split b around its key.
+    const unsigned childHeight = aHeight - (a->getColor() == Color::black ? 1 : 0);
+    Node<kType, dType, OrderStatistics, Augment>* aLower = a->left;
+    Node<kType, dType, OrderStatistics, Augment>* aUpper = a->right;
+    const unsigned aLowerHeight = privateDetach(aLower, childHeight);
+    const unsigned aUpperHeight = privateDetach(aUpper, childHeight);
+    a->left = nullptr;
+    a->right = nullptr;
+
+    Node<kType, dType, OrderStatistics, Augment>* bLower = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* bUpper = nullptr;
+    unsigned bLowerHeight = 0;
+    unsigned bUpperHeight = 0;
+    Node<kType, dType, OrderStatistics, Augment>* match = privateSplit(b, bHeight, a->key, bLower, bLowerHeight, bUpper, bUpperHeight);
+
+    // The halves share no nodes, so the upper one may run as a task.
+    const unsigned childSpawnDepth = spawnDepth > 0 ? spawnDepth - 1 : 0;
+    Node<kType, dType, OrderStatistics, Augment>* upper = nullptr;
+    unsigned upperHeight = 0;
+    DroppedNodes upperDropped;
+    auto runUpper = [&]() {
+        upper = privateSetOperation(op, aUpper, aUpperHeight, bUpper, bUpperHeight, upperHeight, upperDropped, childSpawnDepth, pool);
+    };
+
+    ThreadPool::TaskGroup group(pool);
+    const bool spawned = spawnDepth > 0 && aHeight >= PARALLEL_MIN_HEIGHT;
+    if(spawned)
+        group.run(runUpper);
+
+    unsigned lowerHeight = 0;
+    Node<kType, dType, OrderStatistics, Augment>* lower = privateSetOperation(op, aLower, aLowerHeight, bLower, bLowerHeight, lowerHeight, dropped, childSpawnDepth, pool);
+
+    if(spawned)
+        group.wait();
+    else
+        runUpper();
+
+    dropped.append(upperDropped);
+    if(match != nullptr)
+        dropped.add(match);
+
+    // a's root stays in a union, in an intersection if b has its key too,
+    // and in a difference if b does not.
+    if(op == SetOperation::unite || (op == SetOperation::intersect) == (match != nullptr))
+        return privateJoin(lower, lowerHeight, a, upper, upperHeight, height);
+
+    dropped.add(a);
+    return privateJoin(lower, lowerHeight, upper, upperHeight, height);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSetOperation(SetOperation op, RedBlackTree&& other, ThreadPool& pool)
+{
+    if(this == &other)
+    {
+        if(op == SetOperation::subtract)
+            clear();
+        return;
+    }
+
+    this->nodePool.merge(std::move(other.nodePool));
+
+    // Tasks, not threads, so a few pieces per worker are fine. The pool only
+    // runs as many at once as it has workers.
+    const unsigned spawnDepth = privateParallelDepth(pool, std::max(privateSizeBound(), other.privateSizeBound()));
+
+    DroppedNodes dropped;
+    unsigned height = 0;
+    this->root = privateSetOperation(op, this->root, privateBlackHeight(this->root), other.root, privateBlackHeight(other.root), height, dropped, spawnDepth, pool);
+    privateSetSize(UNKNOWN_SIZE);
+    other.root = nullptr;
+    other.privateSetSize(0);
+    other.lastInserted = nullptr;
+
+    // Back on one thread, the pool can take the dropped nodes now.
+    for(Node<kType, dType, OrderStatistics, Augment>* node = dropped.head; node != nullptr;)
+    {
+        Node<kType, dType, OrderStatistics, Augment>* next = node->getParent();
+        privateDestroyTree(node);
+        node = next;
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+unsigned RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateParallelDepth(const ThreadPool& pool, unsigned long long count)
+{
+    // Four pieces per worker so uneven ones even out, but at least about
+    // 4k entries each, or a task costs more than it saves.
+    const unsigned threads = pool.getThreadCount();
+    const unsigned depth = threads > 1 ? (unsigned)std::bit_width(threads - 1) + 2 : 0;
+    return std::min(depth, (unsigned)std::bit_width(count >> 12));
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::ParallelCut RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateParallelCut(const ThreadPool& pool) const
+{
+    ParallelCut cut;
+    cut.depth = privateParallelDepth(pool, privateSizeBound());
+    privateParallelCut(this->root, cut.depth, cut);
+    return cut;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateParallelCut(Node<kType, dType, OrderStatistics, Augment>* root, unsigned depth, ParallelCut& cut)
+{
+    if(depth == 0 || root == nullptr)
+    {
+        cut.subtrees.push_back(root);
+        return;
+    }
+
+    privateParallelCut(root->left, depth - 1, cut);
+    cut.between.push_back(root);
+    privateParallelCut(root->right, depth - 1, cut);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Visitor>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateForEach(Node<kType, dType, OrderStatistics, Augment>* root, Visitor& visitor)
+{
+    if(root != nullptr)
+    {
+        privateForEach(root->left, visitor);
+        visitor(root->key, root->data);
+        privateForEach(root->right, visitor);
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Visitor>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateParallelForEach(Visitor& visitor, ThreadPool& pool) const
+{
+    ParallelCut cut = privateParallelCut(pool);
+    ThreadPool::TaskGroup group(pool);
+
+    for(Node<kType, dType, OrderStatistics, Augment>* subtree : cut.subtrees)
+    {
+        if(subtree != nullptr)
+            group.run([subtree, &visitor] {privateForEach(subtree, visitor);});
+    }
+
+    if(!cut.between.empty())
+    {
+        group.run([&cut, &visitor] {
+            for(Node<kType, dType, OrderStatistics, Augment>* node : cut.between)
+                visitor(node->key, node->data);
+        });
+    }
+
+    group.wait();
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Visitor>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::parallel_for_each(Visitor&& visitor, ThreadPool& pool)
+{
+    privateParallelForEach(visitor, pool);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Visitor>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::parallel_for_each(Visitor&& visitor, ThreadPool& pool) const
+{
+    auto readOnly = [&visitor](const kType& key, const dType& data) {visitor(key, data);};
+    privateParallelForEach(readOnly, pool);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename T, typename Map, typename Combine>
+T RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateReduce(Node<kType, dType, OrderStatistics, Augment>* root, T acc, Map& map, Combine& combine)
+{
+    if(root == nullptr)
+        return acc;
+
+    acc = privateReduce(root->left, std::move(acc), map, combine);
+    acc = combine(std::move(acc), map(std::as_const(root->key), std::as_const(root->data)));
+    return privateReduce(root->right, std::move(acc), map, combine);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Pred>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateFilter(Node<kType, dType, OrderStatistics, Augment>* root, Pred& pred, std::vector<Node<kType, dType, OrderStatistics, Augment>*>& kept)
+{
+    if(root != nullptr)
+    {
+        privateFilter(root->left, pred, kept);
+        if(pred(std::as_const(root->key), std::as_const(root->data)))
+            kept.push_back(root);
+        privateFilter(root->right, pred, kept);
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename T, typename Map, typename Combine>
+T RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::parallel_reduce(T identity, Map&& map, Combine&& combine, ThreadPool& pool) const
+{
+    ParallelCut cut = privateParallelCut(pool);
+
+    // optional rather than T, so T needs no default constructor and
+    // std::vector<bool> never packs two results into one word.
+    std::vector<std::optional<T>> partial(cut.subtrees.size());
+    ThreadPool::TaskGroup group(pool);
+    for(std::size_t i = 0; i < cut.subtrees.size(); i++)
+    {
+        group.run([&, i] {
+            partial[i].emplace(privateReduce(cut.subtrees[i], identity, map, combine));
+        });
+    }
+    group.wait();
+
+    T result = std::move(*partial[0]);
+    for(std::size_t i = 0; i < cut.between.size(); i++)
+    {
+        Node<kType, dType, OrderStatistics, Augment>* node = cut.between[i];
+        result = combine(std::move(result), map(std::as_const(node->key), std::as_const(node->data)));
+        result = combine(std::move(result), std::move(*partial[i + 1]));
+    }
+    return result;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Copy, typename Fn>
+Copy* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCopyTransformed(Node<kType, dType, OrderStatistics, Augment>* root, Fn& fn, NodePool& pool,
+                                                                                          unsigned depth, Copy* const* pieces, std::size_t& next)
+{
+    if(depth == 0 || root == nullptr)
+        return pieces != nullptr ? pieces[next++] : nullptr;
+
+    Copy* left = privateCopyTransformed(root->left, fn, pool, depth - 1, pieces, next);
+    void* block = nullptr;
+    Copy* node = nullptr;
+    Copy* right = nullptr;
+    try {
+        block = pool.allocate(sizeof(Copy));
+        node = new(block) Copy(root->key, fn(std::as_const(root->key), std::as_const(root->data)));
+        right = privateCopyTransformed(root->right, fn, pool, depth - 1, pieces, next);
+    }
+    catch(...) {
+        privateDestroyCopy(left, pool);
+        if(node != nullptr)
+            node->~Copy();
+        if(block != nullptr)
+            pool.deallocate(block, sizeof(Copy));
+        throw;
+    }
+
+    node->left = left;
+    node->right = right;
+    if(left != nullptr)
+        left->setParent(node);
+    if(right != nullptr)
+        right->setParent(node);
+    node->setColor(root->getColor());
+    if constexpr(OrderStatistics)
+        node->subtreeSize = root->subtreeSize;
+    return node;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Copy>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateDestroyCopy(Copy* root, NodePool& pool)
+{
+    if(root != nullptr)
+    {
+        privateDestroyCopy(root->left, pool);
+        privateDestroyCopy(root->right, pool);
+        root->~Copy();
+        pool.deallocate(root, sizeof(Copy));
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Fn>
+typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::template TransformedTree<Fn> RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::parallel_transform(Fn&& fn, ThreadPool& pool) const
+{
+    using Result = TransformedTree<Fn>;
+    using Copy = Node<kType, TransformedData<Fn>, OrderStatistics>;
+
+    ParallelCut cut = privateParallelCut(pool);
+    Result result(this->comp);
+
+    // Every task gets a pool of its own, the result takes their chunks over
+    // once all are done.
+    std::vector<NodePool> pools;
+    pools.reserve(cut.subtrees.size());
+    for(std::size_t i = 0; i < cut.subtrees.size(); i++)
+        pools.emplace_back(sizeof(Copy));
+
+    const unsigned NO_CUT = std::numeric_limits<unsigned>::max();
+    std::vector<Copy*> pieces(cut.subtrees.size(), nullptr);
+    ThreadPool::TaskGroup group(pool);
+    for(std::size_t i = 0; i < cut.subtrees.size(); i++)
+    {
+        group.run([&, i] {
+            std::size_t none = 0;
+            pieces[i] = privateCopyTransformed<Copy>(cut.subtrees[i], fn, pools[i], NO_CUT, nullptr, none);
+        });
+    }
+
+    std::size_t next = 0;
+    try {
+        group.wait();
+        result.root = privateCopyTransformed<Copy>(this->root, fn, result.nodePool, cut.depth, pieces.data(), next);
+    }
+    catch(...) {
+        // Pieces the top did not take yet are still loose.
+        for(std::size_t i = next; i < pieces.size(); i++)
+            privateDestroyCopy(pieces[i], pools[i]);
+        throw;
+    }
+
+    for(NodePool& taskPool : pools)
+        result.nodePool.merge(std::move(taskPool));
+    result.privateSetSize(privateKnownSize());
+    return result;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateBuildBalanced(const BulkBlocks& blocks, std::size_t lo, std::size_t hi, unsigned depth, unsigned redDepth,
+                                                                                                                            Node<kType, dType, OrderStatistics, Augment>* parent, unsigned spawnDepth, ThreadPool::TaskGroup& group)
+{
+    if(lo >= hi)
+        return nullptr;
+
+    std::size_t mid = lo + (hi - lo) / 2;
+    Node<kType, dType, OrderStatistics, Augment>* node = blocks[mid];
+
+    if(depth == spawnDepth)
+    {
+        // The subtree root is known up front, the task only fills it in.
+        group.run([this, &blocks, lo, hi, depth, redDepth, parent] {privateBuildBalanced(blocks, lo, hi, depth, redDepth, parent);});
+        return node;
+    }
+
+    node->setParent(parent);
+    node->setColor(depth == redDepth ? Color::red : Color::black);
+    node->left = privateBuildBalanced(blocks, lo, mid, depth + 1, redDepth, node, spawnDepth, group);
+    node->right = privateBuildBalanced(blocks, mid + 1, hi, depth + 1, redDepth, node, spawnDepth, group);
+
+    return node;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateUpdateTop(Node<kType, dType, OrderStatistics, Augment>* root, unsigned levels)
+{
+    if constexpr(OrderStatistics || AUGMENTED)
+    {
+        if(root != nullptr && levels > 0)
+        {
+            privateUpdateTop(root->left, levels - 1);
+            privateUpdateTop(root->right, levels - 1);
+            privateUpdateNode(root);
+        }
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Construct>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateParallelBuild(std::size_t count, Construct& construct, ThreadPool& pool)
+{
+    BulkBlocks blocks = privateAcquireBlocks(count);
+    const unsigned depth = privateParallelDepth(pool, count);
+    const std::size_t chunks = std::size_t(1) << depth;
+
+    // A chunk that throws destroys what it got to and stays not done.
+    std::vector<char> done(chunks, 0);
+    {
+        ThreadPool::TaskGroup group(pool);
+        for(std::size_t c = 0; c < chunks; c++)
+        {
+            group.run([&, c] {
+                const std::size_t lo = count * c / chunks;
+                const std::size_t hi = count * (c + 1) / chunks;
+                std::size_t built = lo;
+                try {
+                    for(; built < hi; built++)
+                        construct(built, static_cast<void*>(blocks[built]));
+                }
+                catch(...) {
+                    for(std::size_t i = lo; i < built; i++)
+                        blocks[i]->~Node();
+                    throw;
+                }
+                done[c] = 1;
+            });
+        }
+
+        try {
+            group.wait();
+        }
+        catch(...) {
+            for(std::size_t c = 0; c < chunks; c++)
+            {
+                for(std::size_t i = count * c / chunks; done[c] && i < count * (c + 1) / chunks; i++)
+                    blocks[i]->~Node();
+            }
+            privateReleaseBlocks(blocks);
+            throw;
+        }
+    }
+
+    privateCommitBlocks();
+
+    ThreadPool::TaskGroup group(pool);
+    this->root = privateBuildBalanced(blocks, 0, count, 0, (unsigned)std::bit_width(count + 1) - 1, nullptr, depth, group);
+    group.wait();
+    privateUpdateTop(this->root, depth);
+
+    privateSetSize(count);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Pred>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment> RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::parallel_filter(Pred&& pred, ThreadPool& pool) const
+{
+    ParallelCut cut = privateParallelCut(pool);
+
+    // Nodes to copy, per subtree in key order, and which of the ones in
+    // between make it.
+    std::vector<std::vector<Node<kType, dType, OrderStatistics, Augment>*>> kept(cut.subtrees.size());
+    std::vector<char> keptBetween(cut.between.size(), 0);
+    {
+        ThreadPool::TaskGroup group(pool);
+        for(std::size_t i = 0; i < cut.subtrees.size(); i++)
+            group.run([&, i] {privateFilter(cut.subtrees[i], pred, kept[i]);});
+        group.run([&] {
+            for(std::size_t i = 0; i < cut.between.size(); i++)
+                keptBetween[i] = pred(std::as_const(cut.between[i]->key), std::as_const(cut.between[i]->data)) ? 1 : 0;
+        });
+        group.wait();
+    }
+
+    std::vector<Node<kType, dType, OrderStatistics, Augment>*> sources(kept[0].begin(), kept[0].end());
+    for(std::size_t i = 0; i < cut.between.size(); i++)
+    {
+        if(keptBetween[i])
+            sources.push_back(cut.between[i]);
+        sources.insert(sources.end(), kept[i + 1].begin(), kept[i + 1].end());
+    }
+
+    RedBlackTree result(this->comp);
+    auto construct = [&sources](std::size_t i, void* block) {
+        new (block) Node<kType, dType, OrderStatistics, Augment>(sources[i]->key, sources[i]->data);
+    };
+    result.privateParallelBuild(sources.size(), construct, pool);
+    return result;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<std::input_iterator It>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::parallel_assign(It first, It last, ThreadPool& pool)
+{
+    std::vector<std::pair<kType, dType>> entries;
+    if constexpr(std::forward_iterator<It>)
+        entries.reserve(static_cast<std::size_t>(std::distance(first, last)));
+
+    for(; first != last; ++first)
+    {
+        auto&& entry = *first;
+        entries.emplace_back(std::get<0>(std::forward<decltype(entry)>(entry)), std::get<1>(std::forward<decltype(entry)>(entry)));
+    }
+
+    // Sort chunks side by side, then merge neighbours pairwise, one round
+    // per level. Both steps are stable, so the first of equal keys stays in
+    // front like in assign.
+    auto less = [this](const auto& a, const auto& b) {return privateLess(a.first, b.first);};
+    const std::size_t count = entries.size();
+    const std::size_t chunks = std::size_t(1) << privateParallelDepth(pool, count);
+    auto bound = [&](std::size_t c) {return entries.begin() + (std::ptrdiff_t)(count * c / chunks);};
+
+    for(std::size_t width = 1; width <= chunks; width *= 2)
+    {
+        ThreadPool::TaskGroup group(pool);
+        for(std::size_t c = 0; c < chunks; c += width)
+        {
+            if(width == 1)
+                group.run([&, c] {std::stable_sort(bound(c), bound(c + 1), less);});
+            else
+                group.run([&, c, width] {std::inplace_merge(bound(c), bound(c + width / 2), bound(c + width), less);});
+        }
+        group.wait();
+    }
+
+    auto end = std::unique(entries.begin(), entries.end(), [this](const auto& a, const auto& b) {return !privateLess(a.first, b.first);});
+
+    auto construct = [&entries](std::size_t i, void* block) {
+        new (block) Node<kType, dType, OrderStatistics, Augment>(std::move(entries[i].first), std::move(entries[i].second));
+    };
+    privateParallelBuild(static_cast<std::size_t>(end - entries.begin()), construct, pool);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::unionWith(RedBlackTree&& other, ThreadPool& pool)
+{
+    privateSetOperation(SetOperation::unite, std::move(other), pool);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::intersectWith(RedBlackTree&& other, ThreadPool& pool)
+{
+    privateSetOperation(SetOperation::intersect, std::move(other), pool);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::subtract(RedBlackTree&& other, ThreadPool& pool)
+{
+    privateSetOperation(SetOperation::subtract, std::move(other), pool);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateInsertAdjustTree(Node<kType, dType, OrderStatistics, Augment>* node)
+{
+    return privateInsertAdjustTree(node, this->root);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateInsertAdjustTree(Node<kType, dType, OrderStatistics, Augment>* node, Node<kType, dType, OrderStatistics, Augment>*& top)
+{
+    // Subtree sizes and summaries are already up to date (privateLinkLeaf,
+    // privateJoin) and rotations keep them so, so this only fixes colors
+    // and stops as soon as no red node has a red parent: O(1) amortized.
+    while(node != top && node != nullptr)
+    {
+        Node<kType, dType, OrderStatistics, Augment>* parent = node->getParent();
+
+        // Nothing to fix. A red top is blackened below.
+        if(node->getColor() != Color::red || parent->getColor() != Color::red || parent == top)
+            break;
+
+        Node<kType, dType, OrderStatistics, Augment>* grandparent = parent->getParent();
+        Node<kType, dType, OrderStatistics, Augment>* uncle = grandparent->left == parent ? grandparent->right : grandparent->left;
+
+        // Red uncle: recolor and carry the red up to grandparent.
+        if(uncle != nullptr && uncle->getColor() == Color::red)
+        {
+            uncle->setColor(Color::black);
+            parent->setColor(Color::black);
+            grandparent->setColor(Color::red);
+            node = grandparent;
+            continue;
+        }
+
+        // Black or no uncle: one or two rotations finish the fix-up.
+        if(parent->left == node)
+        {
+            // right left case
+            if(grandparent->right == parent)
+            {
+                privateRightRotate(parent, top);
+                privateLeftRotate(grandparent, top);
+                node->setColor(Color::black);
+                node->right->setColor(Color::red);
+                node->left->setColor(Color::red);
+            }
+            // left left case
+            else
+            {
+                privateRightRotate(grandparent, top);
+                parent->setColor(Color::black);
+                parent->right->setColor(Color::red);
+                parent->left->setColor(Color::red);
+            }
+        }
+        else
+        {
+            // Left Right Case.
+            if(grandparent->left == parent)
+            {
+                privateLeftRotate(parent, top);
+                privateRightRotate(grandparent, top);
+                node->setColor(Color::black);
+                node->right->setColor(Color::red);
+                node->left->setColor(Color::red);
+            }
+            // right right case
+            else
+            {
+                privateLeftRotate(grandparent, top);
+                parent->setColor(Color::black);
+                parent->right->setColor(Color::red);
+                parent->left->setColor(Color::red);
+            }
+        }
+        break;
+    }
+
+    /*
+    // If root is red, pass black down to children.
+    if(top != nullptr && top->getColor() == Color::red)
+    {
+        if(top->right != nullptr)
+            top->right->setColor(Color::red);
+        if(top->left != nullptr)
+            top->left->setColor(Color::red);
+    }*/
+
+    // Set root to black!
+    bool grew = top->getColor() == Color::red;
+    top->setColor(Color::black);
+    return grew;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K, typename... Args>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateRedBlackInsert(Node<kType, dType, OrderStatistics, Augment>* root, K&& key, Args&&... args)
+{
+    Node<kType, dType, OrderStatistics, Augment>* parent = nullptr;
+    bool goLeft = false;
+
+    // Key already exists, nothing gets built.
+    if(!privateFindInsertPosition(root, key, parent, goLeft))
+        return false;
+
+    // Create Node we want to insert.
+    auto node = createLeaf(std::forward<K>(key), std::forward<Args>(args)...);
+    privateLinkLeaf(node, parent, goLeft);
+
+    privateAddSize(1);
+    privateInsertAdjustTree(node);
+    this->lastInserted = node;
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateFindHintPosition(Node<kType, dType, OrderStatistics, Augment>* hint, const K& key, Node<kType, dType, OrderStatistics, Augment>*& parent, bool& goLeft, Node<kType, dType, OrderStatistics, Augment>*& existing) const
+{
+    parent = nullptr;
+    goLeft = false;
+    existing = nullptr;
+
+    if(this->root == nullptr)
+        return true;
+
+    // key has to go between before and after.
+    Node<kType, dType, OrderStatistics, Augment>* before = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* after = nullptr;
+
+    if(hint == nullptr)
+        before = privateFindLargest(this->root);
+    else if(privateLess(key, hint->key))
+    {
+        before = privatePredecessor(hint);
+        after = hint;
+    }
+    else if(privateLess(hint->key, key))
+    {
+        before = hint;
+        after = privateSuccessor(hint);
+    }
+    else
+    {
+        existing = hint;
+        return true;
+    }
+
+    if(before != nullptr && !privateLess(before->key, key))
+    {
+        if(privateLess(key, before->key))
+            return false;
+
+        existing = before;
+        return true;
+    }
+
+    if(after != nullptr && !privateLess(key, after->key))
+    {
+        if(privateLess(after->key, key))
+            return false;
+
+        existing = after;
+        return true;
+    }
+
+    // Neighbours in order have a free link facing each other: before has
+    // no right child, or after (the smallest of that right subtree) no left.
+    if(before != nullptr && before->right == nullptr)
+        parent = before;
+    else
+    {
+        parent = after;
+        goLeft = true;
+    }
+
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K, typename... Args>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateHintedInsert(Node<kType, dType, OrderStatistics, Augment>* hint, bool& inserted, K&& key, Args&&... args)
+{
+    Node<kType, dType, OrderStatistics, Augment>* parent = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* existing = nullptr;
+    bool goLeft = false;
+    inserted = false;
+
+    if(!privateFindHintPosition(hint, key, parent, goLeft, existing))
+    {
+        // Not next to hint after all.
+        if(!privateFindInsertPosition(this->root, key, parent, goLeft))
+            existing = privateSearch(this->root, key);
+    }
+
+    if(existing != nullptr)
+        return existing;
+
+    auto node = createLeaf(std::forward<K>(key), std::forward<Args>(args)...);
+    privateLinkLeaf(node, parent, goLeft);
+
+    privateAddSize(1);
+    privateInsertAdjustTree(node);
+    this->lastInserted = node;
+    inserted = true;
+    return node;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::iterator RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::insert(const_iterator hint, kType key, dType data)
+{
+    bool inserted = false;
+    return iterator(privateHintedInsert(hint.node, inserted, std::move(key), std::move(data)), this);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::append(kType key, dType data)
+{
+    bool inserted = false;
+
+    // Without a last insert, the largest entry is the best guess.
+    privateHintedInsert(this->lastInserted, inserted, std::move(key), std::move(data));
+    return inserted;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateFindInsertPosition(Node<kType, dType, OrderStatistics, Augment>* root, const K& key, Node<kType, dType, OrderStatistics, Augment>*& parent, bool& goLeft)
+{
+    parent = nullptr;
+    goLeft = false;
+
+    if constexpr(THREE_WAY)
+    {
+        // Transcend down, stopping on an equal key.
+        while(root != nullptr)
+        {
+            auto order = this->comp(root->key, key);
+            if(order == 0)
+                return false;
+
+            parent = root;
+            goLeft = order > 0;
+            root = goLeft ? root->left : root->right;
+        }
+    }
+    else
+    {
+        Node<kType, dType, OrderStatistics, Augment>* candidate = nullptr;
+
+        // Transcend down.
+        while(root != nullptr)
+        {
+            parent = root;
+            goLeft = this->comp(key, root->key);
+
+            if(goLeft) {
+                root = root->left;
+            }
+            else {
+                candidate = root;
+                root = root->right;
+            }
+        }
+
+        // candidate->key <= key, so it is equal unless it is smaller. Do not insert.
+        if(candidate != nullptr && !this->comp(candidate->key, key))
+            return false;
+    }
+
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateLinkLeaf(Node<kType, dType, OrderStatistics, Augment>* node, Node<kType, dType, OrderStatistics, Augment>* parent, bool goLeft)
+{
+    // Set Node Parent to the last node.
+    node->setParent(parent);
 
-template<typename kType, typename dType>
-RedBlackTree<kType, dType>::RedBlackTree() {}
+    if(parent == nullptr)
+        this->root = node;
+    else if(goLeft)
+        parent->left = node;
+    else
+        parent->right = node;
 
+    privateUpdatePath(node);
+}
 
-template<typename kType, typename dType>
-std::shared_ptr<Node<kType, dType>> RedBlackTree<kType, dType>::createLeaf(kType key, dType data)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSubtreeSize(const Node<kType, dType, OrderStatistics, Augment>* node)
 {
-    auto leaf = std::make_shared<Node<kType, dType>>();
-    leaf->key = key;
-    leaf->data = data;
-    return leaf;
+    return node != nullptr ? node->subtreeSize : 0;
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateInsertAdjustTree(std::shared_ptr<Node<kType, dType>> node)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+typename Augment::summary_type RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSummary(const Node<kType, dType, OrderStatistics, Augment>* node)
 {
-    while(node != this->root && node != nullptr)
-    {
-        // Set uncle of node to null, set uncle if exists.
-        auto parent =       std::shared_ptr<Node<kType, dType>>(nullptr);
-        auto grandparent =  std::shared_ptr<Node<kType, dType>>(nullptr);
-        auto uncle =        std::shared_ptr<Node<kType, dType>>(nullptr);
-
-        if(node != nullptr)
-            parent = node->parent;
-        if(parent != nullptr)
-            grandparent = parent->parent;
-        if(grandparent != nullptr)
-            uncle = grandparent->left == parent ? grandparent->right : grandparent->left;
-
-        // Case that parent and child both are red
-        if(node != nullptr && node->color == Color::red && node->parent != nullptr && node->parent->color == Color::red)
-        {
-            // Case that child is left pointed to by parent.
-            if(parent->left == node)
-            {
-                // If uncle is a nullptr, we need to rotate.
-                if(uncle == nullptr || uncle->color == Color::black) {
-                    // right left case
-                    if(node->parent->parent->right == parent){
-                        privateRightRotate(node->parent);
-                        privateLeftRotate(node->parent);
-                        node->color = Color::black;
-                        node->right->color = Color::red;
-                        node->left->color = Color::red;
-                    }
-                    // left left case
-                    else if(node->parent->parent->left == parent)
-                    {
-                        privateRightRotate(node->parent->parent);
-                        node->parent->color = Color::black;
-                        node->parent->right->color = Color::red;
-                        node->parent->left->color = Color::red;
-                    }
-                }
-                else if(uncle->color == Color::red)
-                {
-                    uncle->color = Color::black;
-                    node->parent->color = Color::black;
-                    node->parent->parent->color = Color::red;
-                }
-            }
+    return node != nullptr ? node->summary : Augment::identity();
+}
 
-            // Case that child is right pointed to by parent.
-            else if(node->parent->right == node)
-            {
-                // Check if uncle exists or uncle color is black.
-                if(uncle == nullptr || uncle->color == Color::black)
-                {
-                    // Left Right Case.
-                    if(node->parent->parent->left == parent) {
-                        privateLeftRotate(node->parent);
-                        privateRightRotate(node->parent);
-                        node->color = Color::black;
-                        node->right->color = Color::red;
-                        node->left->color = Color::red;
-                    }
-                    // right right case
-                    else if(node->parent->parent->right == parent)
-                    {
-                        privateLeftRotate(node->parent->parent);
-                        node->parent->color = Color::black;
-                        node->parent->right->color = Color::red;
-                        node->parent->left->color = Color::red;
-                    }
-                }
-                else if(uncle->color == Color::red)
-                {
-                    uncle->color = Color::black;
-                    node->parent->color = Color::black;
-                    node->parent->parent->color = Color::red;
-                }
-            }
-        }
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateUpdateNode(Node<kType, dType, OrderStatistics, Augment>* node)
+{
+    if constexpr(OrderStatistics)
+        node->subtreeSize = 1 + privateSubtreeSize(node->left) + privateSubtreeSize(node->right);
 
-        // Increment if can
-        if(node != this->root)
-        {
-            node = node->parent;
-        }
-    }
+    // Left subtree, node, right subtree: combine in key order.
+    if constexpr(AUGMENTED)
+        node->summary = Augment::combine(Augment::combine(privateSummary(node->left), Augment::fromEntry(node->key, node->data)), privateSummary(node->right));
+}
 
-    /*
-    // If root is red, pass black down to children.
-    if(this->root != nullptr && this->root->color == Color::red)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateUpdatePath(Node<kType, dType, OrderStatistics, Augment>* node)
+{
+    if constexpr(OrderStatistics || AUGMENTED)
     {
-        if(this->root->right != nullptr)
-            this->root->right->color = Color::red;
-        if(this->root->left != nullptr)
-            this->root->left->color = Color::red;
-    }*/
-
-    // Set root to black!
-    this->root->color = Color::black;
+        for(; node != nullptr; node = node->getParent())
+            privateUpdateNode(node);
+    }
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateRedBlackInsert(std::shared_ptr<Node<kType, dType>> root, kType key, dType data)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateInsert(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>* node)
 {
-    // Create Node we want to insert.
-    auto node = createLeaf(key, data);
-
-    bool itemInserted = privateInsert(root, node);
+    Node<kType, dType, OrderStatistics, Augment>* parent = nullptr;
+    bool goLeft = false;
 
-    if(itemInserted)
-        this->totalNodes++;
+    // Else, the value exists already, do not insert.
+    if(!privateFindInsertPosition(root, node->key, parent, goLeft))
+        return false;
 
-    /*
-     * TODO: Add color to node. Modify the rest of the tree.
-     */
-    privateInsertAdjustTree(node);
+    privateLinkLeaf(node, parent, goLeft);
+    return true;
+}
 
-    return itemInserted;
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::insert(kType key, dType data)
+{
+    return privateRedBlackInsert(this->root, std::move(key), std::move(data));
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateInsert(std::shared_ptr<Node<kType, dType>> root, std::shared_ptr<Node<kType, dType>> node)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K, typename... Args>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::emplace(K&& key, Args&&... args)
 {
-    // If root is empty, then insert node into here. Return true since we have inserted a new item.
-    if(root == nullptr) {
-        root = node;
-        return true;
-    }
-    // Else we transcend down.
-    else if(root->key != node->key) {
-        // Set Node Parent to this root.
-        node->parent = root;
-        if(root->key < node->key)
-        {
-            if(root->right != nullptr) {
-                return privateInsert(root->right, node);
-            }
-            else {
-                root->right = node;
-                return true;
-            }
-        }
-        else
-        {
-            if(root->left != nullptr) {
-                return privateInsert(root->left, node);
-            }
-            else
-            {
-                root->left = node;
-                return true;
-            }
-        }
+    using Key = std::remove_cvref_t<K>;
+
+    // Compare key as it is if we can, otherwise build the kType up front.
+    if constexpr(std::is_same_v<Key, kType> || HeterogeneousKey<Key, kType, Compare>)
+    {
+        return privateRedBlackInsert(this->root, std::forward<K>(key), std::forward<Args>(args)...);
     }
-    // Else, the value exists already, do not insert.
     else
     {
-        return false;
+        kType builtKey(std::forward<K>(key));
+        return privateRedBlackInsert(this->root, std::move(builtKey), std::forward<Args>(args)...);
     }
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::insert(kType key, dType data)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename... Args>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::try_emplace(const kType& key, Args&&... args)
+{
+    return privateRedBlackInsert(this->root, key, std::forward<Args>(args)...);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename... Args>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::try_emplace(kType&& key, Args&&... args)
 {
-    return privateRedBlackInsert(this->root, key, data);
+    return privateRedBlackInsert(this->root, std::move(key), std::forward<Args>(args)...);
 }
 
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::debugInsertRecursive(std::shared_ptr<Node<kType, dType>> &root, std::shared_ptr<Node<kType, dType>> &node)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::debugInsertRecursive(Node<kType, dType, OrderStatistics, Augment>* &root, Node<kType, dType, OrderStatistics, Augment>* &node)
 {
     // If root is empty, then insert node into here. Return true since we have inserted a new item.
     if(root == nullptr) {
@@ -716,7 +3955,7 @@ void RedBlackTree<kType, dType>::debugInsertRecursive(std::shared_ptr<Node<kType
         // Else we transcend down.
     else if(root->key != node->key) {
         // Set Node Parent to this root.
-        node->parent = root;
+        node->setParent(root);
         if(root->key < node->key)
         {
             if(root->right != nullptr) {
@@ -746,49 +3985,49 @@ void RedBlackTree<kType, dType>::debugInsertRecursive(std::shared_ptr<Node<kType
     }
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::debugInsert(kType key, dType data, Color color)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::debugInsert(kType key, dType data, Color color)
 {
-    auto x = createLeaf(key, data);
-    x->color = color;
+    auto x = createLeaf(std::move(key), std::move(data));
+    x->setColor(color);
 
     privateInsert(this->root, x);
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateCheckCaseZero(std::shared_ptr<Node<kType, dType>> x)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCheckCaseZero(Node<kType, dType, OrderStatistics, Augment>* x)
 {
-    if(x != nullptr && x->color == red)
+    if(x != nullptr && x->getColor() == red)
         return true;
 
     return false;
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateCaseZero(std::shared_ptr<Node<kType, dType>> x)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCaseZero(Node<kType, dType, OrderStatistics, Augment>* x)
 {
-    x->color = Color::black;
+    x->setColor(Color::black);
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateCheckCaseOne(std::shared_ptr<Node<kType, dType>> x,
-                                                     std::shared_ptr<Node<kType, dType>> w)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCheckCaseOne(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                     Node<kType, dType, OrderStatistics, Augment>* w)
 {
-    if((x == nullptr || x->color == Color::black) && w != nullptr && w->color == Color::red)
+    if((x == nullptr || x->getColor() == Color::black) && w != nullptr && w->getColor() == Color::red)
         return true;
 
     return false;
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateCheckCaseTwo(std::shared_ptr<Node<kType, dType>> x,
-                                                     std::shared_ptr<Node<kType, dType>> w)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCheckCaseTwo(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                     Node<kType, dType, OrderStatistics, Augment>* w)
 {
-    if((x == nullptr || x->color == Color::black)                      &&
-       (w != nullptr && w->color == Color::black)                      &&
-       ( (w->color == Color::black                      &&
-                         (w->right == nullptr || w->right->color == Color::black)        &&
-                         (w->left == nullptr || w->left->color == Color::black) ) ) )
+    if((x == nullptr || x->getColor() == Color::black)                      &&
+       (w != nullptr && w->getColor() == Color::black)                      &&
+       ( (w->getColor() == Color::black                      &&
+                         (w->right == nullptr || w->right->getColor() == Color::black)        &&
+                         (w->left == nullptr || w->left->getColor() == Color::black) ) ) )
     {
         return true;
     }
@@ -796,16 +4035,16 @@ bool RedBlackTree<kType, dType>::privateCheckCaseTwo(std::shared_ptr<Node<kType,
     return false;
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateCheckCaseThree(std::shared_ptr<Node<kType, dType>> x,
-                                                       std::shared_ptr<Node<kType, dType>> w,
-                                                       std::shared_ptr<Node<kType, dType>> parent)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCheckCaseThree(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                       Node<kType, dType, OrderStatistics, Augment>* w,
+                                                       Node<kType, dType, OrderStatistics, Augment>* parent)
 {
-    if(( x == nullptr || x->color == Color::black)                      &&
-        (w != nullptr && w->color == Color::black)                      &&
-        ((parent != nullptr && parent->left == x && w != nullptr && w->left != nullptr && w->left->color == Color::red && (w->right == nullptr || w->right->color == Color::black))
+    if(( x == nullptr || x->getColor() == Color::black)                      &&
+        (w != nullptr && w->getColor() == Color::black)                      &&
+        ((parent != nullptr && parent->left == x && w != nullptr && w->left != nullptr && w->left->getColor() == Color::red && (w->right == nullptr || w->right->getColor() == Color::black))
         ||
-        (parent != nullptr && parent->right == x && w != nullptr && w->right != nullptr && w->right->color == Color::red && (w->left == nullptr || w->left->color == Color::black))
+        (parent != nullptr && parent->right == x && w != nullptr && w->right != nullptr && w->right->getColor() == Color::red && (w->left == nullptr || w->left->getColor() == Color::black))
         ))
     {
         return true;
@@ -814,14 +4053,14 @@ bool RedBlackTree<kType, dType>::privateCheckCaseThree(std::shared_ptr<Node<kTyp
     return false;
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateCheckCaseFour(std::shared_ptr<Node<kType, dType>> x,
-                                                      std::shared_ptr<Node<kType, dType>> w,
-                                                      std::shared_ptr<Node<kType, dType>> parent)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCheckCaseFour(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                      Node<kType, dType, OrderStatistics, Augment>* w,
+                                                      Node<kType, dType, OrderStatistics, Augment>* parent)
 {
-    if((x == nullptr || x->color == Color::black) &&
+    if((x == nullptr || x->getColor() == Color::black) &&
        w != nullptr &&
-       ((parent != nullptr && parent->right == x && w->left != nullptr && w->left->color == Color::red) || (parent != nullptr && parent->left == x && w->right != nullptr && w->right->color == Color::red)))
+       ((parent != nullptr && parent->right == x && w->left != nullptr && w->left->getColor() == Color::red) || (parent != nullptr && parent->left == x && w->right != nullptr && w->right->getColor() == Color::red)))
     {
         return true;
     }
@@ -829,17 +4068,17 @@ bool RedBlackTree<kType, dType>::privateCheckCaseFour(std::shared_ptr<Node<kType
     return false;
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateCaseOne(std::shared_ptr<Node<kType, dType>> x,
-                                                std::shared_ptr<Node<kType, dType>> w,
-                                                std::shared_ptr<Node<kType, dType>> parent)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCaseOne(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                Node<kType, dType, OrderStatistics, Augment>* w,
+                                                Node<kType, dType, OrderStatistics, Augment>* parent)
 {
     // Color w black
-    w->color = Color::black;
+    w->setColor(Color::black);
 
     // Color parent of x red
     if(parent != nullptr)
-        parent->color = Color::red;
+        parent->setColor(Color::red);
 
     if(parent->left == x) {
         privateLeftRotate(parent);
@@ -854,11 +4093,11 @@ void RedBlackTree<kType, dType>::privateCaseOne(std::shared_ptr<Node<kType, dTyp
      * Decide on cases 2,3,4 from here!
      * CASE 2.
      */
-    if((x == nullptr || x->color == Color::black)                      &&
-            (w == nullptr || w->color == Color::black)                      &&
-            (w == nullptr || (w->color == Color::black                      &&
-                              (w->right == nullptr || w->right->color == Color::black)        &&
-                              (w->left == nullptr || w->left->color == Color::black) ) ) ) {
+    if((x == nullptr || x->getColor() == Color::black)                      &&
+            (w == nullptr || w->getColor() == Color::black)                      &&
+            (w == nullptr || (w->getColor() == Color::black                      &&
+                              (w->right == nullptr || w->right->getColor() == Color::black)        &&
+                              (w->left == nullptr || w->left->getColor() == Color::black) ) ) ) {
         privateCaseTwo(x, w, parent);
     }
     /* CASE 3.
@@ -867,11 +4106,11 @@ void RedBlackTree<kType, dType>::privateCaseOne(std::shared_ptr<Node<kType, dTyp
      * IF X is left child, and w's left child  is red and right black
      * IF X is right child, and w's left child is black and right red
      */
-    else if((x == nullptr || x->color == Color::black)                      &&
-            (w == nullptr || w->color == Color::black)                      &&
-            ((parent != nullptr && parent->left == x && w != nullptr && w->left != nullptr && w->left->color == Color::red && (w->right == nullptr || w->right->color == Color::black))
+    else if((x == nullptr || x->getColor() == Color::black)                      &&
+            (w == nullptr || w->getColor() == Color::black)                      &&
+            ((parent != nullptr && parent->left == x && w != nullptr && w->left != nullptr && w->left->getColor() == Color::red && (w->right == nullptr || w->right->getColor() == Color::black))
              ||
-             (parent != nullptr && parent->right == x && w != nullptr && w->right != nullptr && w->right->color == Color::red && (w->left == nullptr || w->left->color == Color::black))
+             (parent != nullptr && parent->right == x && w != nullptr && w->right != nullptr && w->right->getColor() == Color::red && (w->left == nullptr || w->left->getColor() == Color::black))
             ))
     {
         privateCaseThree(x, w, parent);
@@ -881,36 +4120,32 @@ void RedBlackTree<kType, dType>::privateCaseOne(std::shared_ptr<Node<kType, dTyp
      * x is left child, T.F w's right child is red ||
      * x ir right child, T.F. w's left child is red
      */
-    else if((x == nullptr || x->color == Color::black) &&
+    else if((x == nullptr || x->getColor() == Color::black) &&
             w != nullptr &&
-            ((w->left != nullptr && w->left->color == Color::red) || (w->right != nullptr && w->right->color == Color::red)))
+            ((w->left != nullptr && w->left->getColor() == Color::red) || (w->right != nullptr && w->right->getColor() == Color::red)))
     {
         privateCaseFour(x, w, parent);
     }
 
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateCaseTwo(std::shared_ptr<Node<kType, dType>> x,
-                                                std::shared_ptr<Node<kType, dType>> w,
-                                                std::shared_ptr<Node<kType,dType>> parent)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCaseTwo(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                Node<kType, dType, OrderStatistics, Augment>* w,
+                                                Node<kType, dType, OrderStatistics, Augment>* parent)
 {
-    std::shared_ptr<Node<kType, dType>> tempX = x;
-    std::shared_ptr<Node<kType, dType>> tempW = w;
-    std::shared_ptr<Node<kType, dType>> tempP = parent;
-
     if(w != nullptr)
-        w->color = Color::red;
+        w->setColor(Color::red);
 
     x = parent;
 
     w = x->getSibling();
     if(x != nullptr)
-        parent = x->parent;
+        parent = x->getParent();
 
-    if(x != nullptr && x->color == Color::red)
+    if(x != nullptr && x->getColor() == Color::red)
     {
-        x->color = Color::black;
+        x->setColor(Color::black);
     }
     else
     {
@@ -927,19 +4162,19 @@ void RedBlackTree<kType, dType>::privateCaseTwo(std::shared_ptr<Node<kType, dTyp
     }
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateCaseThree(std::shared_ptr<Node<kType, dType>> x,
-                                                  std::shared_ptr<Node<kType, dType>> w,
-                                                  std::shared_ptr<Node<kType, dType>> parent)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCaseThree(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                  Node<kType, dType, OrderStatistics, Augment>* w,
+                                                  Node<kType, dType, OrderStatistics, Augment>* parent)
 {
     // Color w's child black(the one thats red)
     if(parent != nullptr && parent->left == x)
-        w->left->color = Color::black;
+        w->left->setColor(Color::black);
     else
-        w->right->color = Color::black;
+        w->right->setColor(Color::black);
 
     // Color w red
-    w->color = Color::red;
+    w->setColor(Color::red);
 
     if(parent != nullptr && parent->left == x)
         privateRightRotate(w);
@@ -955,47 +4190,47 @@ void RedBlackTree<kType, dType>::privateCaseThree(std::shared_ptr<Node<kType, dT
         privateCaseFour(x, w, parent);
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateCaseFour(std::shared_ptr<Node<kType, dType>> x,
-                                                 std::shared_ptr<Node<kType, dType>> w,
-                                                 std::shared_ptr<Node<kType, dType>> parent)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCaseFour(Node<kType, dType, OrderStatistics, Augment>* x,
+                                                 Node<kType, dType, OrderStatistics, Augment>* w,
+                                                 Node<kType, dType, OrderStatistics, Augment>* parent)
 {
-    // Color w the same color as x->parent
+    // Color w the same color as x->getParent()
     if(w != nullptr && parent != nullptr)
-        w->color = parent->color;
+        w->setColor(parent->getColor());
 
     // Color parent black
     if(parent != nullptr)
-        parent->color = Color::black;
+        parent->setColor(Color::black);
 
     // Color w's child black now depending on if x is left or right.
     if(w != nullptr && parent != nullptr) {
         if(parent->left == x) {
             if(w->right != nullptr)
-                w->right->color = Color::black;
+                w->right->setColor(Color::black);
             privateLeftRotate(parent);
         }
         else
         {
             if(w->left != nullptr)
-                w->left->color = Color::black;
+                w->left->setColor(Color::black);
             privateRightRotate(parent);
         }
     }
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateDeleteBST(std::shared_ptr<Node<kType, dType>> root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateDeleteBST(Node<kType, dType, OrderStatistics, Augment>* root)
 {
     if(root->left == nullptr && root->right == nullptr)
     {
-        if(root->parent != nullptr) {
-            if (root->parent->left == root)
-                root->parent->left = nullptr;
+        if(root->getParent() != nullptr) {
+            if (root->getParent()->left == root)
+                root->getParent()->left = nullptr;
             else
-                root->parent->right = nullptr;
+                root->getParent()->right = nullptr;
 
-            root->parent = nullptr;
+            root->setParent(nullptr);
         }
         else
         {
@@ -1008,63 +4243,103 @@ void RedBlackTree<kType, dType>::privateDeleteBST(std::shared_ptr<Node<kType, dT
         // case that left child exists
         if(root->left != nullptr)
         {
-            root->left->parent = root->parent;
+            root->left->setParent(root->getParent());
 
-            if(root->parent != nullptr && root->parent->left == root)
-                root->parent->left = root->left;
+            if(root->getParent() != nullptr && root->getParent()->left == root)
+                root->getParent()->left = root->left;
             else
-                root->parent->right = root->left;
+                root->getParent()->right = root->left;
 
-            root->parent = nullptr;
+            root->setParent(nullptr);
             root->left = nullptr;
         }
         else
         {
-            root->right->parent = root->parent;
+            root->right->setParent(root->getParent());
 
-            if(root->parent != nullptr && root->parent->left == root)
-                root->parent->left = root->right;
+            if(root->getParent() != nullptr && root->getParent()->left == root)
+                root->getParent()->left = root->right;
             else
-                root->parent->right = root->right;
+                root->getParent()->right = root->right;
 
-            root->parent = nullptr;
+            root->setParent(nullptr);
             root->right = nullptr;
         }
     }
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateDelete(std::shared_ptr<Node<kType, dType>> root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSwapWithSuccessor(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>* successor)
+{
+    Node<kType, dType, OrderStatistics, Augment>* parent = root->getParent();
+    Node<kType, dType, OrderStatistics, Augment>* successorParent = successor->getParent();
+    Node<kType, dType, OrderStatistics, Augment>* successorRight = successor->right;
+
+    // successor takes root's spot.
+    successor->setParent(parent);
+    if(parent == nullptr)
+        this->root = successor;
+    else if(parent->left == root)
+        parent->left = successor;
+    else
+        parent->right = successor;
+
+    successor->left = root->left;
+    successor->left->setParent(successor);
+
+    if(successorParent == root)
+    {
+        successor->right = root;
+        root->setParent(successor);
+    }
+    else
+    {
+        successor->right = root->right;
+        successor->right->setParent(successor);
+        successorParent->left = root;
+        root->setParent(successorParent);
+    }
+
+    // root takes successor's old spot, which has no left child.
+    root->left = nullptr;
+    root->right = successorRight;
+    if(successorRight != nullptr)
+        successorRight->setParent(root);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateDelete(Node<kType, dType, OrderStatistics, Augment>* root)
 {
-    std::shared_ptr<Node<kType, dType>> x;
-    std::shared_ptr<Node<kType, dType>> xParent;
-    std::shared_ptr<Node<kType, dType>> w;
-    std::shared_ptr<Node<kType, dType>> replacementNode;
+    Node<kType, dType, OrderStatistics, Augment>* x = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* xParent = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* w = nullptr;
+    Node<kType, dType, OrderStatistics, Augment>* replacementNode = nullptr;
     Color deletedColor;
     Color replacementColor;
 
     // case that root is leaf!
     if(root->left == nullptr && root->right == nullptr)
     {
-        xParent = root->parent;
+        xParent = root->getParent();
 
-        if(root->parent != nullptr) {
-            if (root->parent->left == root)
-                root->parent->left = nullptr;
+        if(root->getParent() != nullptr) {
+            if (root->getParent()->left == root)
+                root->getParent()->left = nullptr;
             else
-                root->parent->right = nullptr;
+                root->getParent()->right = nullptr;
 
-            deletedColor = root->color;
-            root->parent = nullptr;
+            deletedColor = root->getColor();
+            root->setParent(nullptr);
         }
         else
         {
-            deletedColor = this->root->color;
+            deletedColor = this->root->getColor();
             this->root = nullptr;
         }
 
         replacementColor = Color::black;
         x = nullptr;
+        destroyLeaf(root);
     }
     // case that root has only one child.
     else if((root->left != nullptr && root->right == nullptr) || (root->right != nullptr && root->left == nullptr))
@@ -1072,84 +4347,92 @@ void RedBlackTree<kType, dType>::privateDelete(std::shared_ptr<Node<kType, dType
         // case that left child exists
         if(root->left != nullptr)
         {
-            xParent = root->parent;
+            xParent = root->getParent();
             x = root->left;
             replacementNode = x;
-            deletedColor = root->color;
-            replacementColor = x->color;
+            deletedColor = root->getColor();
+            replacementColor = x->getColor();
 
-            if(root->parent != nullptr && root->parent->left == root) {
-                root->parent->left = x;
-                x->parent = root->parent;
+            if(root->getParent() != nullptr && root->getParent()->left == root) {
+                root->getParent()->left = x;
+                x->setParent(root->getParent());
                 root->left = nullptr;
-                root->parent = nullptr;
+                root->setParent(nullptr);
             }
-            else if(root->parent != nullptr && root->parent->right == root) {
-                root->parent->right = x;
-                x->parent = root->parent;
+            else if(root->getParent() != nullptr && root->getParent()->right == root) {
+                root->getParent()->right = x;
+                x->setParent(root->getParent());
                 root->left = nullptr;
-                root->parent = nullptr;
+                root->setParent(nullptr);
             }
             // root is top of tree!
             else {
                 this->root = x;
+                x->setParent(nullptr);
                 root->right = nullptr;
                 root->left = nullptr;
-                root->parent = nullptr;
+                root->setParent(nullptr);
             }
 
         }
         else
         {
-            xParent = root->parent;
+            xParent = root->getParent();
             x = root->right;
             replacementNode = x;
-            deletedColor = root->color;
-            replacementColor = x->color;
+            deletedColor = root->getColor();
+            replacementColor = x->getColor();
 
-            if(root->parent != nullptr && root->parent->left == root) {
-                root->parent->left = x;
-                x->parent = root->parent;
+            if(root->getParent() != nullptr && root->getParent()->left == root) {
+                root->getParent()->left = x;
+                x->setParent(root->getParent());
                 root->left = nullptr;
-                root->parent = nullptr;
+                root->setParent(nullptr);
             }
-            else if(root->parent != nullptr && root->parent->right == root) {
-                root->parent->right = x;
-                x->parent = root->parent;
+            else if(root->getParent() != nullptr && root->getParent()->right == root) {
+                root->getParent()->right = x;
+                x->setParent(root->getParent());
                 root->left = nullptr;
-                root->parent = nullptr;
+                root->setParent(nullptr);
             }
             else {
                 this->root = x;
+                x->setParent(nullptr);
                 root->right = nullptr;
                 root->left = nullptr;
-                root->parent = nullptr;
+                root->setParent(nullptr);
             }
         }
 
         if(deletedColor == Color::black && replacementColor == Color::red)
         {
-            x->color = Color::black;
+            x->setColor(Color::black);
         }
+
+        destroyLeaf(root);
     }
     // else its two children
     else
     {
         auto successor = this->privateFindSmallest(root->right);
         x = successor->right;
-        deletedColor = root->color;
-        replacementColor = successor->color;
+        deletedColor = root->getColor();
+        replacementColor = successor->getColor();
 
-        root->key = successor->key;
-        root->data = successor->data;
-        root->color = successor->color;
+        // Move the successor node into root's spot instead of copying its
+        // key/data over, so payloads never get copied (and can be move-only).
+        privateSwapWithSuccessor(root, successor);
 
-        replacementNode = root;
+        replacementNode = successor;
 
-        xParent = successor->parent;
-        privateDeleteBST(successor);
+        xParent = root->getParent();
+        privateDeleteBST(root);
+        destroyLeaf(root);
     }
 
+    // Everything from the unlinked spot up lost an entry.
+    privateUpdatePath(xParent);
+
     // Set W now since we're beyond delete.
     if(xParent != nullptr) {
         if(xParent->left == x)
@@ -1173,7 +4456,7 @@ void RedBlackTree<kType, dType>::privateDelete(std::shared_ptr<Node<kType, dType
      */
     else if( deletedColor == Color::black && replacementColor == Color::red)
     {
-        replacementNode->color = Color::black;
+        replacementNode->setColor(Color::black);
         return;
     }
     /*
@@ -1182,7 +4465,7 @@ void RedBlackTree<kType, dType>::privateDelete(std::shared_ptr<Node<kType, dType
      */
     else if(deletedColor == Color::red && replacementColor == Color::black)
     {
-        replacementNode->color = Color::red;
+        replacementNode->setColor(Color::red);
 
         // find sibling
         /*
@@ -1237,221 +4520,945 @@ void RedBlackTree<kType, dType>::privateDelete(std::shared_ptr<Node<kType, dType
         {
             privateCaseOne(x, w, xParent);
         }
-        /* CASE 2.
-         * IF X is black.
-         * IF Sibling W is black
-         * IF SIBLING W's Children are both black.
-         * */
-        else if(privateCheckCaseTwo(x, w)) {
-            privateCaseTwo(x, w, xParent);
+        /* CASE 2.
+         * IF X is black.
+         * IF Sibling W is black
+         * IF SIBLING W's Children are both black.
+         * */
+        else if(privateCheckCaseTwo(x, w)) {
+            privateCaseTwo(x, w, xParent);
+        }
+        /* CASE 3.
+         * IF X is black
+         * IF W Sibling is black
+         * IF X is left child, and w's left child  is red and right black
+         * IF X is right child, and w's left child is black and right red
+         */
+        else if(privateCheckCaseThree(x, w, xParent))
+        {
+            privateCaseThree(x, w, xParent);
+        }
+        /* CASE 4. X is black/null && sibling w is black
+         * &&
+         * x is left child, T.F w's right child is red ||
+         * x ir right child, T.F. w's left child is red
+         */
+        else if(privateCheckCaseFour(x, w, xParent))
+        {
+            privateCaseFour(x, w, xParent);
+        }
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateRemove(Node<kType, dType, OrderStatistics, Augment>* root, const K& key) {
+    Node<kType, dType, OrderStatistics, Augment>* node = privateSearch(root, key);
+
+    // node is not found in the tree.
+    if(node == nullptr)
+        return false;
+
+    privateDelete(node);
+    privateAddSize(-1);
+    return true;
+}
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::remove(const kType& key)
+{
+    bool removed = privateRemove(this->root, key);
+
+    return removed;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires HeterogeneousKey<K, kType, Compare>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::remove(const K& key)
+{
+    return privateRemove(this->root, key);
+}
+
+
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateLeftRotate(Node<kType, dType, OrderStatistics, Augment>* root)
+{
+    privateLeftRotate(root, this->root);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateLeftRotate(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>*& top)
+{
+    auto pivot = root->right;
+
+    if(pivot != nullptr)
+    {
+        root->right = pivot->left;
+
+        if(pivot->left != nullptr)
+            pivot->left->setParent(root);
+
+        pivot->left = root;
+        pivot->setParent(root->getParent());
+
+        if(root->getParent() != nullptr && root->getParent()->left == root)
+            root->getParent()->left = pivot;
+        else if(root->getParent() != nullptr && root->getParent()->right == root)
+            root->getParent()->right = pivot;
+
+        root->setParent(pivot);
+
+        if(top == root)
+        {
+            top = pivot;
+        }
+
+        // root is now below pivot, so it goes first.
+        privateUpdateNode(root);
+        privateUpdateNode(pivot);
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateRightRotate(Node<kType, dType, OrderStatistics, Augment>* root)
+{
+    privateRightRotate(root, this->root);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateRightRotate(Node<kType, dType, OrderStatistics, Augment>* root, Node<kType, dType, OrderStatistics, Augment>*& top)
+{
+    auto pivot = root->left;
+
+    if(pivot != nullptr)
+    {
+        root->left = pivot->right;
+
+        if(pivot->right != nullptr)
+            pivot->right->setParent(root);
+
+        pivot->right = root;
+        pivot->setParent(root->getParent());
+
+        if(root->getParent() != nullptr && root->getParent()->left == root)
+            root->getParent()->left = pivot;
+        else if(root->getParent() != nullptr && root->getParent()->right == root)
+            root->getParent()->right = pivot;
+
+        root->setParent(pivot);
+
+        if(top == root)
+        {
+            top = pivot;
+        }
+
+        // root is now below pivot, so it goes first.
+        privateUpdateNode(root);
+        privateUpdateNode(pivot);
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSearch(Node<kType, dType, OrderStatistics, Augment>* root, const K& key) const {
+    if constexpr(THREE_WAY)
+    {
+        while(root != nullptr)
+        {
+            auto order = this->comp(root->key, key);
+            if(order < 0)
+                root = root->right;
+            else if(order > 0)
+                root = root->left;
+            else
+                return root;
+        }
+
+        return nullptr;
+    }
+    else
+    {
+        Node<kType, dType, OrderStatistics, Augment>* candidate = nullptr;
+
+        while(root != nullptr)
+        {
+            if(this->comp(root->key, key))
+            {
+                root = root->right;
+            }
+            else
+            {
+                candidate = root;
+                root = root->left;
+            }
+        }
+
+        // candidate is the smallest node with key >= search key.
+        if(candidate != nullptr && !this->comp(key, candidate->key))
+            return candidate;
+
+        return nullptr;
+    }
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privatePrefetch(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+std::size_t RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::searchBatch(const std::vector<kType>& keys, std::vector<const dType*>& out) const
+{
+    out.assign(keys.size(), nullptr);
+    if(this->root == nullptr)
+        return 0;
+
+    if(privateSizeBound() < SEARCH_BATCH_MIN_SIZE)
+    {
+        std::size_t found = 0;
+        for(std::size_t i = 0; i < keys.size(); i++)
+        {
+            if(Node<kType, dType, OrderStatistics, Augment>* node = privateSearch(this->root, keys[i]))
+            {
+                out[i] = &node->data;
+                found++;
+            }
+        }
+        return found;
+    }
+
+    // Each slot runs the less than descent of privateSearch for one key:
+    // remember the last node not smaller than the key, confirm it at the
+    // bottom. A slot that reaches the bottom takes the next key right away,
+    // so the slots stay busy until the keys run out.
+    struct Slot
+    {
+        std::size_t index;
+        Node<kType, dType, OrderStatistics, Augment>* cursor;
+        Node<kType, dType, OrderStatistics, Augment>* candidate;
+    };
+
+    Slot slots[SEARCH_BATCH_WIDTH];
+    std::size_t width = std::min(SEARCH_BATCH_WIDTH, keys.size());
+    std::size_t next = width;
+    std::size_t found = 0;
+    for(std::size_t i = 0; i < width; i++)
+        slots[i] = Slot{i, this->root, nullptr};
+
+    while(width > 0)
+    {
+        for(std::size_t i = 0; i < width;)
+        {
+            Slot& slot = slots[i];
+            Node<kType, dType, OrderStatistics, Augment>* node = slot.cursor;
+            const bool less = privateLess(node->key, keys[slot.index]);
+            slot.candidate = less ? slot.candidate : node;
+            slot.cursor = less ? node->right : node->left;
+
+            if(slot.cursor != nullptr)
+            {
+                privatePrefetch(slot.cursor);
+                i++;
+                continue;
+            }
+
+            if(slot.candidate != nullptr && !privateLess(keys[slot.index], slot.candidate->key))
+            {
+                out[slot.index] = &slot.candidate->data;
+                found++;
+            }
+
+            // Start the next key here, or move the last slot in.
+            if(next < keys.size())
+                slot = Slot{next++, this->root, nullptr};
+            else
+                slot = slots[--width];
+        }
+    }
+
+    return found;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateFindLargest(Node<kType, dType, OrderStatistics, Augment>* root)
+{
+    while(root->right != nullptr)
+        root = root->right;
+
+    return root;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateFindSmallest(Node<kType, dType, OrderStatistics, Augment>* root)
+{
+    while(root->left != nullptr)
+        root = root->left;
+
+    return root;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSuccessor(Node<kType, dType, OrderStatistics, Augment>* node)
+{
+    if(node->right != nullptr)
+        return privateFindSmallest(node->right);
+
+    // Climb until we come up from a left child.
+    Node<kType, dType, OrderStatistics, Augment>* parent = node->getParent();
+    while(parent != nullptr && parent->right == node)
+    {
+        node = parent;
+        parent = parent->getParent();
+    }
+
+    return parent;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename A, typename B>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateLess(const A& a, const B& b) const
+{
+    if constexpr(THREE_WAY)
+        return this->comp(a, b) < 0;
+    else
+        return this->comp(a, b);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+decltype(auto) RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateLookupKey(const K& key)
+{
+    if constexpr(std::is_same_v<K, kType> || HeterogeneousKey<K, kType, Compare>)
+        return (key);
+    else
+        return kType(key);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateLowerBound(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const
+{
+    Node<kType, dType, OrderStatistics, Augment>* candidate = nullptr;
+
+    while(root != nullptr)
+    {
+        if(privateLess(root->key, val))
+        {
+            root = root->right;
+        }
+        else
+        {
+            candidate = root;
+            root = root->left;
         }
-        /* CASE 3.
-         * IF X is black
-         * IF W Sibling is black
-         * IF X is left child, and w's left child  is red and right black
-         * IF X is right child, and w's left child is black and right red
-         */
-        else if(privateCheckCaseThree(x, w, xParent))
+    }
+
+    return candidate;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateUpperBound(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const
+{
+    Node<kType, dType, OrderStatistics, Augment>* candidate = nullptr;
+
+    while(root != nullptr)
+    {
+        if(privateLess(val, root->key))
         {
-            privateCaseThree(x, w, xParent);
+            candidate = root;
+            root = root->left;
         }
-        /* CASE 4. X is black/null && sibling w is black
-         * &&
-         * x is left child, T.F w's right child is red ||
-         * x ir right child, T.F. w's left child is red
-         */
-        else if(privateCheckCaseFour(x, w, xParent))
+        else
         {
-            privateCaseFour(x, w, xParent);
+            root = root->right;
         }
     }
+
+    return candidate;
 }
 
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::privateRemove(std::shared_ptr<Node<kType, dType>> root, kType key) {
-    if(root != nullptr)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateFloor(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const
+{
+    Node<kType, dType, OrderStatistics, Augment>* candidate = nullptr;
+
+    while(root != nullptr)
     {
-        if(root->key == key)
+        if(privateLess(val, root->key))
         {
-            privateDelete(root);
-            this->totalNodes--;
-            return true;
+            root = root->left;
         }
-        else if(root->key < key)
+        else
+        {
+            candidate = root;
+            root = root->right;
+        }
+    }
+
+    return candidate;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateBelow(Node<kType, dType, OrderStatistics, Augment>* root, const K& val) const
+{
+    Node<kType, dType, OrderStatistics, Augment>* candidate = nullptr;
+
+    while(root != nullptr)
+    {
+        if(privateLess(root->key, val))
         {
-            return privateRemove(root->right, key);
+            candidate = root;
+            root = root->right;
         }
         else
         {
-            return privateRemove(root->left, key);
+            root = root->left;
         }
     }
-    // else node is not found in the tree.
-    else
+
+    return candidate;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privatePredecessor(Node<kType, dType, OrderStatistics, Augment>* node)
+{
+    if(node->left != nullptr)
+        return privateFindLargest(node->left);
+
+    // Climb until we come up from a right child.
+    Node<kType, dType, OrderStatistics, Augment>* parent = node->getParent();
+    while(parent != nullptr && parent->left == node)
+    {
+        node = parent;
+        parent = parent->getParent();
+    }
+
+    return parent;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::search(const kType& sKey, dType* dataPtr) const
+{
+    auto results = privateSearch(this->root, sKey);
+    if(results == nullptr)
     {
         return false;
     }
+    else
+    {
+        *dataPtr = results->data;
+        return true;
+    }
 }
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::remove(kType key)
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires HeterogeneousKey<K, kType, Compare>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::search(const K& sKey, dType* dataPtr) const
 {
-    bool removed = privateRemove(this->root, key);
+    auto results = privateSearch(this->root, sKey);
+    if(results == nullptr)
+        return false;
 
-    return removed;
+    *dataPtr = results->data;
+    return true;
 }
 
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+dType* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::find(const kType& sKey)
+{
+    auto results = privateSearch(this->root, sKey);
+    return results != nullptr ? &results->data : nullptr;
+}
 
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+const dType* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::find(const kType& sKey) const
+{
+    auto results = privateSearch(this->root, sKey);
+    return results != nullptr ? &results->data : nullptr;
+}
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateLeftRotate(std::shared_ptr<Node<kType, dType>> root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires HeterogeneousKey<K, kType, Compare>
+dType* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::find(const K& sKey)
 {
-    auto pivot = root->right;
+    auto results = privateSearch(this->root, sKey);
+    return results != nullptr ? &results->data : nullptr;
+}
 
-    if(pivot != nullptr)
-    {
-        root->right = pivot->left;
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires HeterogeneousKey<K, kType, Compare>
+const dType* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::find(const K& sKey) const
+{
+    auto results = privateSearch(this->root, sKey);
+    return results != nullptr ? &results->data : nullptr;
+}
 
-        if(pivot->left != nullptr)
-            pivot->left->parent = root;
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::contains(const kType& sKey) const
+{
+    return privateSearch(this->root, sKey) != nullptr;
+}
 
-        pivot->left = root;
-        pivot->parent = root->parent;
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires HeterogeneousKey<K, kType, Compare>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::contains(const K& sKey) const
+{
+    return privateSearch(this->root, sKey) != nullptr;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+dType& RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::at(const kType& sKey)
+{
+    auto results = privateSearch(this->root, sKey);
+    if(results == nullptr)
+        throw std::out_of_range("RedBlackTree::at: key not in tree");
 
-        if(root->parent != nullptr && root->parent->left == root)
-            root->parent->left = pivot;
-        else if(root->parent != nullptr && root->parent->right == root)
-            root->parent->right = pivot;
+    return results->data;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+const dType& RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::at(const kType& sKey) const
+{
+    auto results = privateSearch(this->root, sKey);
+    if(results == nullptr)
+        throw std::out_of_range("RedBlackTree::at: key not in tree");
+
+    return results->data;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires HeterogeneousKey<K, kType, Compare>
+dType& RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::at(const K& sKey)
+{
+    auto results = privateSearch(this->root, sKey);
+    if(results == nullptr)
+        throw std::out_of_range("RedBlackTree::at: key not in tree");
+
+    return results->data;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires HeterogeneousKey<K, kType, Compare>
+const dType& RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::at(const K& sKey) const
+{
+    auto results = privateSearch(this->root, sKey);
+    if(results == nullptr)
+        throw std::out_of_range("RedBlackTree::at: key not in tree");
 
-        root->parent = pivot;
+    return results->data;
+}
 
-        if(this->root == root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::getTotalSize() const
+{
+    if constexpr(OrderStatistics)
+        return privateSubtreeSize(this->root);
+    else
+    {
+        // Unknown since a split, count once. Threads counting at the same
+        // time all get and store the same number.
+        unsigned long long count = this->totalNodes.load(std::memory_order_relaxed);
+        if(count == UNKNOWN_SIZE)
         {
-            this->root = pivot;
+            count = (unsigned long long)std::distance(begin(), end());
+            privateSetSize(count);
         }
+
+        return count;
     }
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privateRightRotate(std::shared_ptr<Node<kType, dType>> root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateCountBelow(const K& val, bool inclusive) const
 {
-    auto pivot = root->left;
+    unsigned long long below = 0;
+    Node<kType, dType, OrderStatistics, Augment>* node = this->root;
 
-    if(pivot != nullptr)
+    while(node != nullptr)
     {
-        root->left = pivot->right;
+        bool goRight = inclusive ? !privateLess(val, node->key) : privateLess(node->key, val);
 
-        if(pivot->right != nullptr)
-            pivot->right->parent = root;
+        if(goRight)
+        {
+            // node and everything left of it count.
+            below += privateSubtreeSize(node->left) + 1;
+            node = node->right;
+        }
+        else
+        {
+            node = node->left;
+        }
+    }
 
-        pivot->right = root;
-        pivot->parent = root->parent;
+    return below;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires (OrderStatistics && LookupKey<K, kType, Compare>)
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::rank(const K& sKey) const
+{
+    return privateCountBelow(privateLookupKey(sKey), false);
+}
 
-        if(root->parent != nullptr && root->parent->left == root)
-            root->parent->left = pivot;
-        else if(root->parent != nullptr && root->parent->right == root)
-            root->parent->right = pivot;
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+Node<kType, dType, OrderStatistics, Augment>* RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateSelect(unsigned long long k) const
+{
+    Node<kType, dType, OrderStatistics, Augment>* node = this->root;
 
-        root->parent = pivot;
+    while(node != nullptr)
+    {
+        unsigned long long leftSize = privateSubtreeSize(node->left);
 
-        if(this->root == root)
+        if(k < leftSize)
+        {
+            node = node->left;
+        }
+        else if(k == leftSize)
+        {
+            break;
+        }
+        else
         {
-            this->root = pivot;
+            k -= leftSize + 1;
+            node = node->right;
         }
     }
+
+    return node;
 }
 
-template<typename kType, typename dType>
-std::shared_ptr<Node<kType, dType>> RedBlackTree<kType, dType>::privateSearch(std::shared_ptr<Node<kType, dType>> root, const kType &key) {
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires (OrderStatistics && LookupKey<K, kType, Compare>)
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::count(const K& lo, const K& hi) const
+{
+    const auto& first = privateLookupKey(lo);
+    const auto& last = privateLookupKey(hi);
+
+    if(privateLess(last, first))
+        return 0;
 
-    if(root != nullptr)
+    return privateCountBelow(last, true) - privateCountBelow(first, false);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires LookupKey<K, kType, Compare>
+typename Augment::summary_type RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::aggregate(const K& lo, const K& hi) const requires AUGMENTED
+{
+    const auto& first = privateLookupKey(lo);
+    const auto& last = privateLookupKey(hi);
+
+    // Find the top most node inside [lo, hi], where the two paths split.
+    Node<kType, dType, OrderStatistics, Augment>* split = this->root;
+    while(split != nullptr)
+    {
+        if(privateLess(split->key, first))
+            split = split->right;
+        else if(privateLess(last, split->key))
+            split = split->left;
+        else
+            break;
+    }
+
+    if(split == nullptr)
+        return Augment::identity();
+
+    // Left side: every node >= lo brings itself and its right subtree, all
+    // of it in front of what we picked up above it.
+    auto leftSummary = Augment::identity();
+    for(auto node = split->left; node != nullptr;)
     {
-        if(root->key == key)
+        if(privateLess(node->key, first))
+        {
+            node = node->right;
+        }
+        else
         {
-            return root;
+            leftSummary = Augment::combine(Augment::combine(Augment::fromEntry(node->key, node->data), privateSummary(node->right)), leftSummary);
+            node = node->left;
         }
+    }
 
-        if(root->left != nullptr && root->key > key)
+    // Right side, mirrored.
+    auto rightSummary = Augment::identity();
+    for(auto node = split->right; node != nullptr;)
+    {
+        if(privateLess(last, node->key))
         {
-            return privateSearch(root->left, key);
+            node = node->left;
         }
         else
         {
-            return privateSearch(root->right, key);
+            rightSummary = Augment::combine(rightSummary, Augment::combine(privateSummary(node->left), Augment::fromEntry(node->key, node->data)));
+            node = node->right;
         }
     }
-    else
+
+    return Augment::combine(Augment::combine(leftSummary, Augment::fromEntry(split->key, split->data)), rightSummary);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K, typename Fn> requires LookupKey<K, kType, Compare>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::update(const K& sKey, Fn&& fn)
+{
+    auto node = privateSearch(this->root, privateLookupKey(sKey));
+    if(node == nullptr)
+        return false;
+
+    fn(node->data);
+    privateUpdatePath(node);
+    return true;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::const_iterator
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::findOverlap(const kType& lo, const kType& hi) const requires IntervalAugmentPolicy<Augment, kType, dType>
+{
+    Node<kType, dType, OrderStatistics, Augment>* node = this->root;
+
+    while(node != nullptr)
     {
-        return std::shared_ptr<Node<kType, dType>>(nullptr);
+        if(!privateLess(hi, node->key) && !privateLess(Augment::intervalEnd(node->key, node->data), lo))
+            break;
+
+        // If anything on the left ends at or after lo, the left side either
+        // overlaps or everything there starts after hi, and then so does
+        // everything on the right.
+        if(node->left != nullptr && !privateLess(node->left->summary, lo))
+            node = node->left;
+        else
+            node = node->right;
     }
+
+    return const_iterator(node, this);
 }
 
-template<typename kType, typename dType>
-std::shared_ptr<Node<kType, dType>> RedBlackTree<kType, dType>::privateFindLargest(std::shared_ptr<Node<kType, dType>> root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Visitor>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateVisitOverlaps(Node<kType, dType, OrderStatistics, Augment>* root, const kType& lo, const kType& hi, Visitor& visitor, unsigned long long& visited) const
 {
-    if(root->right != nullptr)
+    // Nothing below ends late enough.
+    if(root == nullptr || privateLess(root->summary, lo))
+        return true;
+
+    if(!privateVisitOverlaps(root->left, lo, hi, visitor, visited))
+        return false;
+
+    // Everything from here on starts after hi.
+    if(privateLess(hi, root->key))
+        return true;
+
+    if(!privateLess(Augment::intervalEnd(root->key, root->data), lo))
     {
-        return privateFindLargest(root->right);
+        visited++;
+
+        if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, const dType&>, bool>)
+        {
+            if(!visitor(static_cast<const kType&>(root->key), static_cast<const dType&>(root->data)))
+                return false;
+        }
+        else
+        {
+            visitor(static_cast<const kType&>(root->key), static_cast<const dType&>(root->data));
+        }
     }
-    else
+
+    return privateVisitOverlaps(root->right, lo, hi, visitor, visited);
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename Visitor>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::overlaps(const kType& lo, const kType& hi, Visitor&& visitor) const requires IntervalAugmentPolicy<Augment, kType, dType>
+{
+    unsigned long long visited = 0;
+    privateVisitOverlaps(this->root, lo, hi, visitor, visited);
+    return visited;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires LookupKey<K, kType, Compare>
+std::pair<typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::iterator, typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::iterator>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::equal_range(const K& sKey)
+{
+    const auto& key = privateLookupKey(sKey);
+    Node<kType, dType, OrderStatistics, Augment>* first = privateLowerBound(this->root, key);
+
+    // Keys are unique, so the range holds first or nothing.
+    if(first == nullptr || privateLess(key, first->key))
+        return {iterator(first, this), iterator(first, this)};
+
+    return {iterator(first, this), iterator(privateSuccessor(first), this)};
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K> requires LookupKey<K, kType, Compare>
+std::pair<typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::const_iterator, typename RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::const_iterator>
+RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::equal_range(const K& sKey) const
+{
+    const auto& key = privateLookupKey(sKey);
+    Node<kType, dType, OrderStatistics, Augment>* first = privateLowerBound(this->root, key);
+
+    // Keys are unique, so the range holds first or nothing.
+    if(first == nullptr || privateLess(key, first->key))
+        return {const_iterator(first, this), const_iterator(first, this)};
+
+    return {const_iterator(first, this), const_iterator(privateSuccessor(first), this)};
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K, typename Visitor> requires LookupKey<K, kType, Compare>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::scan(const K& lo, const K& hi, Visitor&& visitor)
+{
+    const auto& last = privateLookupKey(hi);
+    unsigned long long visited = 0;
+
+    for(auto node = privateLowerBound(this->root, privateLookupKey(lo));
+        node != nullptr && !privateLess(last, node->key);
+        node = privateSuccessor(node))
     {
-        return root;
+        visited++;
+
+        if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, dType&>, bool>)
+        {
+            if(!visitor(static_cast<const kType&>(node->key), node->data))
+                break;
+        }
+        else
+        {
+            visitor(static_cast<const kType&>(node->key), node->data);
+        }
     }
+
+    return visited;
 }
 
-template<typename kType, typename dType>
-std::shared_ptr<Node<kType, dType>> RedBlackTree<kType, dType>::privateFindSmallest(std::shared_ptr<Node<kType, dType>> root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+template<typename K, typename Visitor> requires LookupKey<K, kType, Compare>
+unsigned long long RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::scan(const K& lo, const K& hi, Visitor&& visitor) const
 {
-    if(root->left != nullptr)
+    const auto& last = privateLookupKey(hi);
+    unsigned long long visited = 0;
+
+    for(auto node = privateLowerBound(this->root, privateLookupKey(lo));
+        node != nullptr && !privateLess(last, node->key);
+        node = privateSuccessor(node))
     {
-        return privateFindSmallest(root->left);
+        visited++;
+
+        if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, const dType&>, bool>)
+        {
+            if(!visitor(static_cast<const kType&>(node->key), static_cast<const dType&>(node->data)))
+                break;
+        }
+        else
+        {
+            visitor(static_cast<const kType&>(node->key), static_cast<const dType&>(node->data));
+        }
     }
-    else
+
+    return visited;
+}
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privatePrintInorder(Node<kType, dType, OrderStatistics, Augment>* root) {
+    if(root == nullptr)
+        return;
+
+    Node<kType, dType, OrderStatistics, Augment>* node = privateFindSmallest(root);
+
+    while(node != nullptr)
     {
-        return root;
+        std::cout << node->key << " ";
+
+        if(node->right != nullptr)
+        {
+            node = privateFindSmallest(node->right);
+        }
+        else
+        {
+            // Climb until we come up from a left child, but never above root.
+            while(node != root && node->getParent()->right == node)
+                node = node->getParent();
+
+            node = node == root ? nullptr : node->getParent();
+        }
     }
 }
-
-template<typename kType, typename dType>
-bool RedBlackTree<kType, dType>::search(const kType& sKey, dType* dataPtr)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privateIsValid(const Node<kType, dType, OrderStatistics, Augment>* root, const Node<kType, dType, OrderStatistics, Augment>* low,
+                                                                                    const Node<kType, dType, OrderStatistics, Augment>* high, unsigned& blackHeight, unsigned long long& count) const
 {
-    auto results = privateSearch(this->root, sKey);
-    if(results == nullptr)
+    blackHeight = 0;
+    count = 0;
+    if(root == nullptr)
+        return true;
+
+    if((low != nullptr && !privateLess(low->key, root->key)) || (high != nullptr && !privateLess(root->key, high->key)))
+        return false;
+
+    unsigned leftHeight = 0;
+    unsigned rightHeight = 0;
+    unsigned long long leftCount = 0;
+    unsigned long long rightCount = 0;
+    for(const Node<kType, dType, OrderStatistics, Augment>* child : {root->left, root->right})
     {
+        if(child != nullptr && (child->getParent() != root || (root->getColor() == Color::red && child->getColor() == Color::red)))
+            return false;
+    }
+
+    if(!privateIsValid(root->left, low, root, leftHeight, leftCount) || !privateIsValid(root->right, root, high, rightHeight, rightCount) || leftHeight != rightHeight)
         return false;
+
+    count = leftCount + rightCount + 1;
+    if constexpr(OrderStatistics)
+    {
+        if(root->subtreeSize != count)
+            return false;
     }
-    else
+
+    // Same combine order as privateUpdateNode, so even float sums match.
+    if constexpr(AUGMENTED && std::equality_comparable<typename Augment::summary_type>)
     {
-        *dataPtr = results->data;
-        return true;
+        if(!(root->summary == Augment::combine(Augment::combine(privateSummary(root->left), Augment::fromEntry(root->key, root->data)), privateSummary(root->right))))
+            return false;
     }
+
+    blackHeight = leftHeight + (root->getColor() == Color::black ? 1 : 0);
+    return true;
 }
 
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::privatePrintInorder(std::shared_ptr<Node<kType, dType>> root) {
-    if(root != nullptr) {
-        if(root->left != nullptr)
-        {
-            privatePrintInorder(root->left);
-        }
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+bool RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::isValid() const
+{
+    if(this->root != nullptr && (this->root->getParent() != nullptr || this->root->getColor() != Color::black))
+        return false;
 
-        std::cout << root->key << " ";
+    unsigned blackHeight = 0;
+    unsigned long long count = 0;
+    if(!privateIsValid(this->root, nullptr, nullptr, blackHeight, count))
+        return false;
 
-        if(root->right != nullptr)
-        {
-            privatePrintInorder(root->right);
-        }
-    }
-    return;
+    const unsigned long long known = this->totalNodes.load(std::memory_order_relaxed);
+    return known == UNKNOWN_SIZE || OrderStatistics || known == count;
 }
-template<typename kType, typename dType>
-void RedBlackTree<kType, dType>::printInorder()
+
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::printInorder()
 {
     privatePrintInorder(this->root);
     std::cout << std::endl;
 }
 
-template <typename kType, typename dType>
-void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<kType, dType>> root)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::privatePrintTreeFromRoot(Node<kType, dType, OrderStatistics, Augment>* root)
 {
     const int CENTER_PADDING = 40;
     const int NULL_COLOR = 0x00;
@@ -1463,7 +5470,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING);
-        printInColor("( " + std::to_string(root->key) + " )", root->color == Color::red ? RED : BLACK);
+        printInColor("( " + std::to_string(root->key) + " )", root->getColor() == Color::red ? RED : BLACK);
     }
     else
     {
@@ -1479,7 +5486,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->left != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/2);
-        printInColor("( " + std::to_string(root->left->key) + " )", root->left->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->left->key) + " )", root->left->getColor() == Color::red ? RED : BLACK );
     }
     else
     {
@@ -1490,7 +5497,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->right != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING);
-        printInColor("( " + std::to_string(root->right->key) + " )", root->right->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->right->key) + " )", root->right->getColor() == Color::red ? RED : BLACK );
         std::cout << std::setw(CENTER_PADDING/2);
     }
     else
@@ -1507,7 +5514,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->left != nullptr && root->left->left != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->left->left->key) + " )", root->left->left->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->left->left->key) + " )", root->left->left->getColor() == Color::red ? RED : BLACK );
     }
     else
     {
@@ -1518,7 +5525,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->left != nullptr && root->left->right != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/2);
-        printInColor("( " + std::to_string(root->left->right->key) + " )", root->left->right->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->left->right->key) + " )", root->left->right->getColor() == Color::red ? RED : BLACK );
     }
     else
     {
@@ -1529,7 +5536,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->right != nullptr && root->right->left != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/2);
-        printInColor("( " + std::to_string(root->right->left->key) + " )", root->right->left->color == Color::red ? RED : BLACK);
+        printInColor("( " + std::to_string(root->right->left->key) + " )", root->right->left->getColor() == Color::red ? RED : BLACK);
     }
     else
     {
@@ -1540,7 +5547,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->right != nullptr && root->right->right != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/2);
-        printInColor("( " + std::to_string(root->right->right->key) + " )", root->right->right->color == Color::red ? RED : BLACK);
+        printInColor("( " + std::to_string(root->right->right->key) + " )", root->right->right->getColor() == Color::red ? RED : BLACK);
     }
     else
     {
@@ -1555,7 +5562,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->left != nullptr && root->left->left != nullptr && root->left->left->left != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/8);
-        printInColor("( " + std::to_string(root->left->left->left->key) + " )", root->left->left->left->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->left->left->left->key) + " )", root->left->left->left->getColor() == Color::red ? RED : BLACK );
     }
     else
     {
@@ -1566,7 +5573,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->left != nullptr && root->left->left != nullptr && root->left->left->right != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->left->left->right->key) + " )", root->left->left->right->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->left->left->right->key) + " )", root->left->left->right->getColor() == Color::red ? RED : BLACK );
     }
     else
     {
@@ -1577,7 +5584,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->left != nullptr && root->left->right != nullptr && root->left->right->left != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->left->right->left->key) + " )", root->left->right->left->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->left->right->left->key) + " )", root->left->right->left->getColor() == Color::red ? RED : BLACK );
     }
     else
     {
@@ -1588,7 +5595,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->left != nullptr && root->left->right != nullptr && root->left->right->right != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->left->right->right->key) + " )", root->left->right->right->color == Color::red ? RED : BLACK );
+        printInColor("( " + std::to_string(root->left->right->right->key) + " )", root->left->right->right->getColor() == Color::red ? RED : BLACK );
     }
     else
     {
@@ -1599,7 +5606,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->right != nullptr && root->right->left != nullptr && root->right->left->left != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->right->left->left->key) + " )", root->right->left->left->color == Color::red ? RED : BLACK);
+        printInColor("( " + std::to_string(root->right->left->left->key) + " )", root->right->left->left->getColor() == Color::red ? RED : BLACK);
     }
     else
     {
@@ -1610,7 +5617,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->right != nullptr && root->right->left != nullptr && root->right->left->right != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->right->left->right->key) + " )", root->right->left->right->color == Color::red ? RED : BLACK);
+        printInColor("( " + std::to_string(root->right->left->right->key) + " )", root->right->left->right->getColor() == Color::red ? RED : BLACK);
     }
     else
     {
@@ -1621,7 +5628,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->right != nullptr && root->right->right != nullptr && root->right->right->left != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->right->right->left->key) + " )", root->right->right->left->color == Color::red ? RED : BLACK);
+        printInColor("( " + std::to_string(root->right->right->left->key) + " )", root->right->right->left->getColor() == Color::red ? RED : BLACK);
     }
     else
     {
@@ -1632,7 +5639,7 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
     if(root != nullptr && root->right != nullptr && root->right->right != nullptr && root->right->right->right != nullptr)
     {
         std::cout << std::setw(CENTER_PADDING/4);
-        printInColor("( " + std::to_string(root->right->right->right->key) + " )", root->right->right->right->color == Color::red ? RED : BLACK);
+        printInColor("( " + std::to_string(root->right->right->right->key) + " )", root->right->right->right->getColor() == Color::red ? RED : BLACK);
     }
     else
     {
@@ -1642,14 +5649,14 @@ void RedBlackTree<kType, dType>::privatePrintTreeFromRoot(std::shared_ptr<Node<k
 
 }
 
-template <typename kType, typename dType>
-void RedBlackTree<kType, dType>::printTreeFromRoot()
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::printTreeFromRoot()
 {
     privatePrintTreeFromRoot(this->root);
 }
 
-template <typename kType, typename dType>
-void RedBlackTree<kType, dType>::printTreeFromRoot(kType rootVal)
+template<typename kType, typename dType, typename Compare, bool OrderStatistics, typename Augment>
+void RedBlackTree<kType, dType, Compare, OrderStatistics, Augment>::printTreeFromRoot(kType rootVal)
 {
     auto r = privateSearch(this->root, rootVal);
     privatePrintTreeFromRoot(r);
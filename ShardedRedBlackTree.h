@@ -0,0 +1,719 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "RedBlackTree.h"
+
+#ifndef REDBLACKTREE_SHARDEDREDBLACKTREE_H
+#define REDBLACKTREE_SHARDEDREDBLACKTREE_H
+
+/**
+ * \brief       Thread safe ordered map that splits the key space into
+ *          ranges, each held by its own RedBlackTree behind its own lock.
+ *
+ * \details     Every call locks only the shard(s) whose range it touches:
+ *          insert and remove take one shard exclusively, search and contains
+ *          take one shard shared, so operations on different key ranges run
+ *          in parallel. Finding the shard is a binary search over a table of
+ *          boundary keys that is read without any lock; after locking its
+ *          shard an operation checks that the table is still current and
+ *          starts over if a rebalance replaced it in between.
+ *
+ *          When an insert leaves its shard with more than twice the
+ *          average shard size, the shards are evened out a step at a time,
+ *          each step locking only the shards it changes: an oversized shard
+ *          is split in two at its median, two neighbours that fit in one
+ *          average shard are joined to free a shard for that, and if no
+ *          shard can be freed an oversized shard evens out with its smaller
+ *          neighbour. Each step is O(log n + s) for s shards, since split
+ *          and join move no node and a split half's pool gives back its
+ *          old chunks by itself once they empty. How many shards are in use
+ *          follows the size, one per minShardSize entries up to maxShards.
+ *          The routing table lists the shards in key order, so a new shard
+ *          slots in without moving any other. Tables are shared_ptrs, so
+ *          the one a step replaced is freed once the last reader that
+ *          picked it up before the swap is done.
+ *
+ *          Keys that always grow (timestamps) all land in the last shard;
+ *          range sharding spreads writes only as far as the keys spread.
+ *
+ * @tparam kType Key value type. Must be copyable, boundaries are copies.
+ * @tparam dType Data value type.
+ * @tparam Compare Ordering of the keys, as for RedBlackTree.
+ */
+template<typename kType, typename dType, typename Compare = DefaultCompare<kType>>
+class ShardedRedBlackTree
+{
+private:
+    /**
+     * One key range. Aligned to a cache line so neighbouring shard locks
+     * don't share one.
+     */
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mutex;
+        RedBlackTree<kType, dType, Compare, true> tree;
+
+        /**
+         * tree's size, stored by whoever changes it under mutex, so a
+         * rebalance can weigh shards without locking them.
+         */
+        std::atomic<unsigned long long> size{0};
+
+        /**
+         * Position in shards. Locks on several shards are taken in this
+         * order, whatever order the routing table lists them in.
+         */
+        std::size_t index;
+
+        Shard(const Compare& comp, std::size_t index) : tree(comp), index(index) {}
+    };
+
+    /**
+     * Shards in key order and their boundaries. order[i] holds keys in
+     * [bounds[i - 1], bounds[i]), so bounds.size() + 1 shards are in use.
+     * Never changed once published.
+     */
+    struct Routing
+    {
+        std::vector<kType> bounds;
+        std::vector<Shard*> order;
+
+        /**
+         * Shard size past which an insert triggers a rebalance.
+         */
+        unsigned long long shardLimit;
+    };
+
+    /**
+     * True if comp returns an ordering instead of a bool.
+     */
+    static constexpr bool THREE_WAY = !std::is_convertible_v<std::invoke_result_t<const Compare&, const kType&, const kType&>, bool>;
+
+    /**
+     * Key ordering, takes no space when the comparator is empty.
+     */
+    [[no_unique_address]] Compare comp;
+
+    /**
+     * Fewest entries worth a shard of their own.
+     */
+    unsigned long long minShardSize;
+
+    /**
+     * Every shard that can be used, maxShards of them. Created up front and
+     * never freed before the container, so a shard pointer read from an
+     * old routing table still points at a live mutex.
+     */
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    /**
+     * Shards the routing table doesn't list, all empty. Only touched with
+     * rebalanceMutex held.
+     */
+    std::vector<Shard*> spares;
+
+    /**
+     * Current routing table. A reader copies it under routingMutex and
+     * holds its own reference while it routes, so a rebalance can drop the
+     * old table right away. The mutex only covers the copy, a reference
+     * count increment; std::atomic<std::shared_ptr> would do the same with
+     * a lock bit, but libstdc++ 12 releases that bit too weakly in load.
+     */
+    std::shared_ptr<const Routing> routing;
+    mutable std::mutex routingMutex;
+
+    /**
+     * The table routing points at, as a plain pointer. Lets a reader that
+     * holds a shard lock check its table is still current without touching
+     * the reference count. The reader's reference keeps its table, and so
+     * the address, from being reused meanwhile.
+     */
+    std::atomic<const Routing*> currentRouting;
+
+    /**
+     * Serializes rebalances.
+     */
+    std::mutex rebalanceMutex;
+
+    /**
+     * \brief       a < b under comp.
+     */
+    bool privateLess(const kType& a, const kType& b) const;
+
+    /**
+     * \brief       Reference to the current routing table.
+     */
+    std::shared_ptr<const Routing> privateRouting() const;
+
+    /**
+     * \brief       Position in table of the shard key is routed to.
+     */
+    std::size_t privateShardOf(const Routing& table, const kType& key) const;
+
+    /**
+     * \brief       Locks the shard holding key with a Lock (std::unique_lock
+     *          or std::shared_lock), retrying until the routing table read
+     *          before locking is still current.
+     *
+     * @param key Key to route.
+     * @param table Set to the routing table the shard was found in.
+     * @return The shard and the lock held on it.
+     */
+    template<typename Lock>
+    std::pair<Shard*, Lock> privateLockShard(const kType& key, std::shared_ptr<const Routing>& table) const;
+
+    /**
+     * \brief       Shared locks on the shards of the current routing table
+     *          that lo..hi covers.
+     *
+     * @param lo Smallest key the caller needs, nullptr for the first shard.
+     * @param hi Largest key the caller needs, nullptr for the last shard.
+     * @param table Set to the routing table the shards were found in.
+     * @param first Set to the position of the first locked shard.
+     * @return The locks, one per shard in key order from first on.
+     */
+    std::vector<std::shared_lock<std::shared_mutex>> privateLockRange(const kType* lo, const kType* hi, std::shared_ptr<const Routing>& table, std::size_t& first) const;
+
+    /**
+     * \brief       Exclusive locks on a and b, taken by shard index.
+     */
+    static std::pair<std::unique_lock<std::shared_mutex>, std::unique_lock<std::shared_mutex>> privateLockPair(Shard* a, Shard* b);
+
+    /**
+     * \brief       Rebalances unless another thread already is.
+     */
+    void privateTryRebalance();
+
+    /**
+     * \brief       Rebalance with rebalanceMutex held. Takes steps until
+     *          no shard is oversized and no more shards are in use than the
+     *          size calls for.
+     */
+    void privateRebalance();
+
+    /**
+     * \brief       Publishes next as the routing table. Every shard whose
+     *          range changed must be locked by the caller.
+     */
+    void privatePublish(std::shared_ptr<Routing> next);
+
+    /**
+     * \brief       Splits the shard at position at of table in two at its
+     *          median, the upper half going to a spare.
+     */
+    void privateSplitShard(const Routing& table, std::size_t at);
+
+    /**
+     * \brief       Joins the shard after position at of table into the one
+     *          at it, freeing the upper one.
+     */
+    void privateMergeShards(const Routing& table, std::size_t at);
+
+    /**
+     * \brief       Moves the boundary between the shards at positions at and
+     *          at + 1 of table to the median of both.
+     */
+    void privateEvenShards(const Routing& table, std::size_t at);
+
+public:
+    /**
+     * \brief       Constructs an empty container.
+     *
+     * @param maxShards Most shards to split the keys into, 0 for four per
+     *          hardware thread.
+     * @param minShardSize Fewest entries per shard once there is more than
+     *          one.
+     * @param comp Comparator instance used for every key comparison.
+     */
+    explicit ShardedRedBlackTree(unsigned maxShards = 0, unsigned long long minShardSize = 4096, const Compare& comp = Compare());
+
+    /**
+     * Shards hold mutexes, the container can be neither copied nor moved.
+     */
+    ShardedRedBlackTree(const ShardedRedBlackTree&) = delete;
+    ShardedRedBlackTree& operator=(const ShardedRedBlackTree&) = delete;
+
+    /**
+     * \details     Same as RedBlackTree::insert. Locks one shard.
+     *
+     * @param key Key value of node being inserted.
+     * @param data Data value of node being inserted.
+     * @return Bool if inserting into the tree was successful.
+     */
+    bool insert(kType key, dType data);
+
+    /**
+     * \details     Same as RedBlackTree::remove. Locks one shard.
+     *
+     * @param key Key value of the node being removed.
+     * @return Bool if the key was in the tree and got removed.
+     */
+    bool remove(const kType& key);
+
+    /**
+     * \details     Same as RedBlackTree::search, copying the data out while
+     *          the shard is locked shared.
+     *
+     * @param sKey Search Key to be searched against in the tree.
+     * @param dataPtr Pointer to data type that is to be copied into.
+     * @return Bool depending if search key is in the tree.
+     */
+    bool search(const kType& sKey, dType* dataPtr) const;
+
+    /**
+     * \details     True if sKey is in the container.
+     */
+    bool contains(const kType& sKey) const;
+
+    /**
+     * \details     Calls visitor(key, data) on every entry with
+     *          lo <= key <= hi, in key order across shards. Every shard the
+     *          range covers is locked shared for the whole scan, so the
+     *          visitor sees one consistent state, and writers to those
+     *          shards wait until it is done. If visitor returns bool,
+     *          returning false stops the scan.
+     *
+     * @param lo Smallest key to visit.
+     * @param hi Largest key to visit.
+     * @param visitor Callable taking (const kType&, const dType&).
+     * @return Number of entries visited.
+     */
+    template<typename Visitor>
+    unsigned long long scan(const kType& lo, const kType& hi, Visitor&& visitor) const;
+
+    /**
+     * \details     Calls visitor(key, data) on every entry in key order,
+     *          with every shard locked shared. Same stopping rule as scan.
+     *
+     * @return Number of entries visited.
+     */
+    template<typename Visitor>
+    unsigned long long forEach(Visitor&& visitor) const;
+
+    /**
+     * \brief       Returns the total entries, counted over a consistent
+     *          state of all shards.
+     */
+    unsigned long long getTotalSize() const;
+
+    /**
+     * \brief       Number of shards in use right now.
+     */
+    std::size_t getShardCount() const;
+
+    /**
+     * \brief       Bytes of node memory all shards hold, in use or free.
+     */
+    std::size_t getReservedBytes() const;
+
+    /**
+     * \details     Evens out the shards now. Inserts already do this when a
+     *          shard outgrows the rest, but removes don't, so call it after
+     *          bulk removes in one range. Each step only blocks calls on
+     *          the shards it changes, O(log n + s).
+     */
+    void rebalance();
+};
+
+template<typename kType, typename dType, typename Compare>
+ShardedRedBlackTree<kType, dType, Compare>::ShardedRedBlackTree(unsigned maxShards, unsigned long long minShardSize, const Compare& comp)
+    : comp(comp), minShardSize(std::max(minShardSize, 1ULL))
+{
+    if(maxShards == 0)
+        maxShards = 4 * std::max(std::thread::hardware_concurrency(), 1u);
+
+    this->shards.reserve(maxShards);
+    for(unsigned i = 0; i < maxShards; i++)
+        this->shards.push_back(std::make_unique<Shard>(comp, i));
+
+    for(unsigned i = maxShards; i > 1; i--)
+        this->spares.push_back(this->shards[i - 1].get());
+
+    this->routing = std::make_shared<const Routing>(Routing{{}, {this->shards[0].get()}, 2 * this->minShardSize});
+    this->currentRouting.store(this->routing.get(), std::memory_order_release);
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ShardedRedBlackTree<kType, dType, Compare>::privateLess(const kType& a, const kType& b) const
+{
+    if constexpr(THREE_WAY)
+        return this->comp(a, b) < 0;
+    else
+        return this->comp(a, b);
+}
+
+template<typename kType, typename dType, typename Compare>
+std::shared_ptr<const typename ShardedRedBlackTree<kType, dType, Compare>::Routing> ShardedRedBlackTree<kType, dType, Compare>::privateRouting() const
+{
+    std::lock_guard<std::mutex> lock(this->routingMutex);
+    return this->routing;
+}
+
+template<typename kType, typename dType, typename Compare>
+std::size_t ShardedRedBlackTree<kType, dType, Compare>::privateShardOf(const Routing& table, const kType& key) const
+{
+    return std::upper_bound(table.bounds.begin(), table.bounds.end(), key,
+                            [this](const kType& a, const kType& b) {return privateLess(a, b);}) - table.bounds.begin();
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename Lock>
+std::pair<typename ShardedRedBlackTree<kType, dType, Compare>::Shard*, Lock> ShardedRedBlackTree<kType, dType, Compare>::privateLockShard(const kType& key, std::shared_ptr<const Routing>& table) const
+{
+    for(;;)
+    {
+        table = privateRouting();
+        Shard* shard = table->order[privateShardOf(*table, key)];
+        Lock lock(shard->mutex);
+
+        // A rebalance publishes its table while holding the lock of every
+        // shard it changed, so once ours is held an unchanged pointer means
+        // the route is current.
+        if(this->currentRouting.load(std::memory_order_acquire) == table.get())
+            return {shard, std::move(lock)};
+    }
+}
+
+template<typename kType, typename dType, typename Compare>
+std::vector<std::shared_lock<std::shared_mutex>> ShardedRedBlackTree<kType, dType, Compare>::privateLockRange(const kType* lo, const kType* hi, std::shared_ptr<const Routing>& table, std::size_t& first) const
+{
+    for(;;)
+    {
+        table = privateRouting();
+        first = lo == nullptr ? 0 : privateShardOf(*table, *lo);
+        std::size_t last = hi == nullptr ? table->bounds.size() : privateShardOf(*table, *hi);
+
+        // Positions change with every rebalance, shard indices never do.
+        std::vector<std::size_t> byIndex(last - first + 1);
+        for(std::size_t i = 0; i < byIndex.size(); i++)
+            byIndex[i] = i;
+        std::sort(byIndex.begin(), byIndex.end(), [&](std::size_t a, std::size_t b) {return table->order[first + a]->index < table->order[first + b]->index;});
+
+        std::vector<std::shared_lock<std::shared_mutex>> locks(byIndex.size());
+        for(std::size_t i : byIndex)
+            locks[i] = std::shared_lock<std::shared_mutex>(table->order[first + i]->mutex);
+
+        if(this->currentRouting.load(std::memory_order_acquire) == table.get())
+            return locks;
+    }
+}
+
+template<typename kType, typename dType, typename Compare>
+std::pair<std::unique_lock<std::shared_mutex>, std::unique_lock<std::shared_mutex>> ShardedRedBlackTree<kType, dType, Compare>::privateLockPair(Shard* a, Shard* b)
+{
+    if(a->index > b->index)
+    {
+        std::unique_lock<std::shared_mutex> second(b->mutex);
+        std::unique_lock<std::shared_mutex> first(a->mutex);
+        return {std::move(first), std::move(second)};
+    }
+
+    std::unique_lock<std::shared_mutex> first(a->mutex);
+    std::unique_lock<std::shared_mutex> second(b->mutex);
+    return {std::move(first), std::move(second)};
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ShardedRedBlackTree<kType, dType, Compare>::insert(kType key, dType data)
+{
+    bool overfull = false;
+    bool inserted;
+
+    {
+        std::shared_ptr<const Routing> table;
+        auto [shard, lock] = privateLockShard<std::unique_lock<std::shared_mutex>>(key, table);
+        inserted = shard->tree.insert(std::move(key), std::move(data));
+        shard->size.store(shard->tree.getTotalSize(), std::memory_order_relaxed);
+        overfull = inserted && shard->tree.getTotalSize() > table->shardLimit;
+    }
+
+    if(overfull)
+        privateTryRebalance();
+
+    return inserted;
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ShardedRedBlackTree<kType, dType, Compare>::remove(const kType& key)
+{
+    std::shared_ptr<const Routing> table;
+    auto [shard, lock] = privateLockShard<std::unique_lock<std::shared_mutex>>(key, table);
+    const bool removed = shard->tree.remove(key);
+    shard->size.store(shard->tree.getTotalSize(), std::memory_order_relaxed);
+    return removed;
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ShardedRedBlackTree<kType, dType, Compare>::search(const kType& sKey, dType* dataPtr) const
+{
+    std::shared_ptr<const Routing> table;
+    auto [shard, lock] = privateLockShard<std::shared_lock<std::shared_mutex>>(sKey, table);
+    return shard->tree.search(sKey, dataPtr);
+}
+
+template<typename kType, typename dType, typename Compare>
+bool ShardedRedBlackTree<kType, dType, Compare>::contains(const kType& sKey) const
+{
+    std::shared_ptr<const Routing> table;
+    auto [shard, lock] = privateLockShard<std::shared_lock<std::shared_mutex>>(sKey, table);
+    return shard->tree.contains(sKey);
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename Visitor>
+unsigned long long ShardedRedBlackTree<kType, dType, Compare>::scan(const kType& lo, const kType& hi, Visitor&& visitor) const
+{
+    if(privateLess(hi, lo))
+        return 0;
+
+    std::shared_ptr<const Routing> table;
+    std::size_t first;
+    auto locks = privateLockRange(&lo, &hi, table, first);
+    unsigned long long visited = 0;
+    bool stopped = false;
+
+    for(std::size_t i = 0; i < locks.size() && !stopped; i++)
+    {
+        const auto& tree = table->order[first + i]->tree;
+        visited += tree.scan(lo, hi, [&](const kType& key, const dType& data) {
+            if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, const dType&>, bool>)
+                return !(stopped = !visitor(key, data));
+            else
+                visitor(key, data);
+        });
+    }
+
+    return visited;
+}
+
+template<typename kType, typename dType, typename Compare>
+template<typename Visitor>
+unsigned long long ShardedRedBlackTree<kType, dType, Compare>::forEach(Visitor&& visitor) const
+{
+    std::shared_ptr<const Routing> table;
+    std::size_t first;
+    auto locks = privateLockRange(nullptr, nullptr, table, first);
+    unsigned long long visited = 0;
+
+    for(std::size_t i = 0; i < locks.size(); i++)
+    {
+        for(const auto& [key, data] : table->order[i]->tree)
+        {
+            visited++;
+
+            if constexpr(std::is_same_v<std::invoke_result_t<Visitor&, const kType&, const dType&>, bool>)
+            {
+                if(!visitor(key, data))
+                    return visited;
+            }
+            else
+            {
+                visitor(key, data);
+            }
+        }
+    }
+
+    return visited;
+}
+
+template<typename kType, typename dType, typename Compare>
+unsigned long long ShardedRedBlackTree<kType, dType, Compare>::getTotalSize() const
+{
+    std::shared_ptr<const Routing> table;
+    std::size_t first;
+    auto locks = privateLockRange(nullptr, nullptr, table, first);
+    unsigned long long total = 0;
+
+    for(std::size_t i = 0; i < locks.size(); i++)
+        total += table->order[i]->tree.getTotalSize();
+
+    return total;
+}
+
+template<typename kType, typename dType, typename Compare>
+std::size_t ShardedRedBlackTree<kType, dType, Compare>::getShardCount() const
+{
+    return privateRouting()->bounds.size() + 1;
+}
+
+template<typename kType, typename dType, typename Compare>
+std::size_t ShardedRedBlackTree<kType, dType, Compare>::getReservedBytes() const
+{
+    std::shared_ptr<const Routing> table;
+    std::size_t first;
+    auto locks = privateLockRange(nullptr, nullptr, table, first);
+    std::size_t bytes = 0;
+
+    for(std::size_t i = 0; i < locks.size(); i++)
+        bytes += table->order[i]->tree.getReservedBytes();
+
+    return bytes;
+}
+
+template<typename kType, typename dType, typename Compare>
+void ShardedRedBlackTree<kType, dType, Compare>::rebalance()
+{
+    std::lock_guard<std::mutex> guard(this->rebalanceMutex);
+    privateRebalance();
+}
+
+template<typename kType, typename dType, typename Compare>
+void ShardedRedBlackTree<kType, dType, Compare>::privateTryRebalance()
+{
+    // Whoever is rebalancing already will even this shard out too.
+    std::unique_lock<std::mutex> guard(this->rebalanceMutex, std::try_to_lock);
+    if(guard.owns_lock())
+        privateRebalance();
+}
+
+template<typename kType, typename dType, typename Compare>
+void ShardedRedBlackTree<kType, dType, Compare>::privateRebalance()
+{
+    // Only this thread changes the table, so reading it needs no shard
+    // lock; sizes may move under us, which only makes a step less exact.
+    for(std::size_t step = 0; step < 4 * this->shards.size(); step++)
+    {
+        std::shared_ptr<const Routing> table = privateRouting();
+        const std::size_t used = table->order.size();
+
+        std::vector<unsigned long long> sizes(used);
+        unsigned long long total = 0;
+        for(std::size_t i = 0; i < used; i++)
+            total += sizes[i] = table->order[i]->size.load(std::memory_order_relaxed);
+
+        const std::size_t count = std::clamp<unsigned long long>(total / this->minShardSize, 1, this->shards.size());
+        const unsigned long long average = std::max(total / count, this->minShardSize);
+        const unsigned long long limit = 2 * average;
+
+        const std::size_t biggest = std::max_element(sizes.begin(), sizes.end()) - sizes.begin();
+        std::size_t lightest = used;
+        for(std::size_t i = 0; i + 1 < used; i++)
+            if(lightest == used || sizes[i] + sizes[i + 1] < sizes[lightest] + sizes[lightest + 1])
+                lightest = i;
+        const unsigned long long lightestPair = lightest != used ? sizes[lightest] + sizes[lightest + 1] : limit + 1;
+
+        // Too many shards: join while the result stays small enough not to
+        // be split again right away.
+        if(used > count && lightestPair <= limit)
+            privateMergeShards(*table, lightest);
+        else if(sizes[biggest] <= limit)
+            break;
+        else if(used < count && !this->spares.empty())
+            privateSplitShard(*table, biggest);
+        else if(lightestPair <= average && lightest != biggest && lightest + 1 != biggest)
+            privateMergeShards(*table, lightest);
+        else
+        {
+            const std::size_t below = biggest > 0 ? biggest - 1 : used;
+            const std::size_t above = biggest + 1 < used ? biggest + 1 : used;
+            std::size_t neighbour = below;
+            if(neighbour == used || (above != used && sizes[above] < sizes[below]))
+                neighbour = above;
+
+            if(neighbour == used || 2 * sizes[neighbour] >= sizes[biggest])
+                break;
+            privateEvenShards(*table, std::min(biggest, neighbour));
+        }
+    }
+
+    // Whatever could not be evened out is left until it grows a quarter
+    // more, so inserts into it don't try again every time.
+    std::shared_ptr<const Routing> table = privateRouting();
+    unsigned long long total = 0;
+    unsigned long long biggest = 0;
+    for(Shard* shard : table->order)
+    {
+        const unsigned long long size = shard->size.load(std::memory_order_relaxed);
+        total += size;
+        biggest = std::max(biggest, size);
+    }
+
+    const std::size_t count = std::clamp<unsigned long long>(total / this->minShardSize, 1, this->shards.size());
+    const unsigned long long limit = std::max(2 * std::max(total / count, this->minShardSize), biggest + biggest / 4);
+    if(limit != table->shardLimit)
+    {
+        auto next = std::make_shared<Routing>(*table);
+        next->shardLimit = limit;
+        privatePublish(std::move(next));
+    }
+}
+
+template<typename kType, typename dType, typename Compare>
+void ShardedRedBlackTree<kType, dType, Compare>::privatePublish(std::shared_ptr<Routing> next)
+{
+    // The old table goes once no reader holds it any more.
+    std::shared_ptr<const Routing> previous;
+    std::lock_guard<std::mutex> lock(this->routingMutex);
+    previous = std::exchange(this->routing, std::move(next));
+    this->currentRouting.store(this->routing.get(), std::memory_order_release);
+}
+
+template<typename kType, typename dType, typename Compare>
+void ShardedRedBlackTree<kType, dType, Compare>::privateSplitShard(const Routing& table, std::size_t at)
+{
+    Shard* lower = table.order[at];
+    Shard* upper = this->spares.back();
+    auto locks = privateLockPair(lower, upper);
+
+    const unsigned long long size = lower->tree.getTotalSize();
+    if(size < 2)
+        return;
+
+    auto next = std::make_shared<Routing>(table);
+    next->bounds.insert(next->bounds.begin() + (std::ptrdiff_t)at, lower->tree.select(size / 2)->first);
+    next->order.insert(next->order.begin() + (std::ptrdiff_t)at + 1, upper);
+
+    upper->tree = lower->tree.split(next->bounds[at]);
+    lower->size.store(lower->tree.getTotalSize(), std::memory_order_relaxed);
+    upper->size.store(upper->tree.getTotalSize(), std::memory_order_relaxed);
+    this->spares.pop_back();
+
+    privatePublish(std::move(next));
+}
+
+template<typename kType, typename dType, typename Compare>
+void ShardedRedBlackTree<kType, dType, Compare>::privateMergeShards(const Routing& table, std::size_t at)
+{
+    Shard* lower = table.order[at];
+    Shard* upper = table.order[at + 1];
+    auto locks = privateLockPair(lower, upper);
+
+    auto next = std::make_shared<Routing>(table);
+    next->bounds.erase(next->bounds.begin() + (std::ptrdiff_t)at);
+    next->order.erase(next->order.begin() + (std::ptrdiff_t)at + 1);
+
+    lower->tree.join(std::move(upper->tree));
+    lower->size.store(lower->tree.getTotalSize(), std::memory_order_relaxed);
+    upper->size.store(0, std::memory_order_relaxed);
+    this->spares.push_back(upper);
+
+    privatePublish(std::move(next));
+}
+
+template<typename kType, typename dType, typename Compare>
+void ShardedRedBlackTree<kType, dType, Compare>::privateEvenShards(const Routing& table, std::size_t at)
+{
+    Shard* lower = table.order[at];
+    Shard* upper = table.order[at + 1];
+    auto locks = privateLockPair(lower, upper);
+
+    lower->tree.join(std::move(upper->tree));
+    const unsigned long long size = lower->tree.getTotalSize();
+
+    auto next = std::make_shared<Routing>(table);
+    next->bounds[at] = lower->tree.select(size / 2)->first;
+
+    upper->tree = lower->tree.split(next->bounds[at]);
+    lower->size.store(lower->tree.getTotalSize(), std::memory_order_relaxed);
+    upper->size.store(upper->tree.getTotalSize(), std::memory_order_relaxed);
+
+    privatePublish(std::move(next));
+}
+
+#endif //REDBLACKTREE_SHARDEDREDBLACKTREE_H
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef REDBLACKTREE_THREADPOOL_H
+#define REDBLACKTREE_THREADPOOL_H
+
+/**
+ * \brief       Fixed set of worker threads sharing work by stealing.
+ *
+ * \details     Every worker owns a deque of tasks. A worker pushes the tasks
+ *          it spawns onto the back of its own deque and takes work from the
+ *          back as well, so it keeps going depth first on what is still in
+ *          its cache. An idle worker steals from the front of another
+ *          worker's deque, which is where the oldest and, for divide and
+ *          conquer, the biggest pieces sit. Tasks submitted from outside the
+ *          pool are spread round robin over the deques.
+ *
+ *          Work is handed out through a TaskGroup, whose wait runs queued
+ *          tasks itself until the group is done. Waiting therefore never
+ *          blocks a worker, and groups can nest: a task may start a group of
+ *          its own and wait for it.
+ *
+ * \note        Workers sleep on a condition variable while every deque is
+ *          empty, so an idle pool costs nothing.
+ */
+class ThreadPool
+{
+private:
+    /**
+     * Tasks of one worker. Aligned so two workers' locks never share a
+     * cache line.
+     */
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    /**
+     * Tasks sitting in any deque, checked by sleeping workers.
+     */
+    std::atomic<std::size_t> queued{0};
+    std::atomic<unsigned> nextQueue{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    /**
+     * \brief       Index of the calling thread's deque if it is a worker of
+     *          this pool, else queues.size().
+     */
+    std::size_t privateOwnQueue() const;
+
+    /**
+     * \brief       Pushes task onto the caller's own deque, or the next one
+     *          round robin if the caller is not a worker, and wakes a
+     *          sleeping worker.
+     */
+    void privatePush(std::function<void()> task);
+
+    /**
+     * \brief       Takes one task, the newest of the caller's own deque or
+     *          else the oldest of another one, and runs it.
+     *
+     * @return False if every deque was empty.
+     */
+    bool privateRunOne();
+
+    /**
+     * \brief       Loop of worker index, runs tasks until the pool is
+     *          destroyed.
+     */
+    void privateWorkerLoop(std::size_t index);
+
+public:
+    /**
+     * \brief       Tasks whose completion is waited for together.
+     *
+     * \details     run hands a task to the pool, wait returns once every
+     *          task run so far has finished. If tasks throw, the first
+     *          exception is rethrown by wait after all of them are done.
+     *          The destructor waits as well, dropping any exception, so a
+     *          group left by an exception never outlives its tasks.
+     */
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+        ~TaskGroup();
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        /**
+         * \brief       Queues task on the pool. It may run on any worker or
+         *          on a thread waiting for any group.
+         */
+        template<typename Task>
+        void run(Task&& task);
+
+        /**
+         * \brief       Runs queued tasks until every task of this group has
+         *          finished.
+         *
+         * \details     A worker of the pool keeps looking for tasks, as
+         *          parking it could leave nobody to run them. Any other
+         *          thread only helps for WAIT_SPINS empty rounds and then
+         *          sleeps until the last task is done.
+         */
+        void wait();
+
+    private:
+        /**
+         * Rounds without a task to run before a thread that is not a
+         * worker goes to sleep.
+         */
+        static constexpr unsigned WAIT_SPINS = 1024;
+
+        ThreadPool& pool;
+        std::atomic<std::size_t> pending{0};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        /**
+         * Signalled once pending drops to 0. pending only does so under
+         * doneMutex, which wait takes once more before returning, so the
+         * last task is out of the group before it can be destroyed.
+         */
+        std::mutex doneMutex;
+        std::condition_variable done;
+
+        /**
+         * \brief       Counts one task as finished, waking sleeping waiters
+         *          if it was the last.
+         */
+        void privateFinish();
+    };
+
+    /**
+     * \brief       Starts threads workers, 0 for one per hardware thread.
+     */
+    explicit ThreadPool(unsigned threads = 0);
+
+    /**
+     * \brief       Lets the workers finish the tasks already queued and joins
+     *          them.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned getThreadCount() const {return (unsigned)this->workers.size();}
+
+    /**
+     * \brief       Pool with one worker per hardware thread, started on first
+     *          use and shared by every caller that doesn't bring its own.
+     */
+    static ThreadPool& shared();
+};
+
+inline ThreadPool::ThreadPool(unsigned threads)
+{
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(unsigned i = 0; i < threads; i++)
+        this->queues.push_back(std::make_unique<WorkerQueue>());
+
+    this->workers.reserve(threads);
+    for(unsigned i = 0; i < threads; i++)
+        this->workers.emplace_back([this, i] {privateWorkerLoop(i);});
+}
+
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->stopping = true;
+    }
+    this->wakeUp.notify_all();
+
+    for(std::thread& worker : this->workers)
+        worker.join();
+}
+
+inline ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+/*
+ * Pool and deque of the worker running on this thread, if any. A thread is
+ * a worker of at most one pool.
+ */
+namespace threadpool_detail
+{
+    inline thread_local const ThreadPool* currentPool = nullptr;
+    inline thread_local std::size_t currentQueue = 0;
+}
+
+inline std::size_t ThreadPool::privateOwnQueue() const
+{
+    return threadpool_detail::currentPool == this ? threadpool_detail::currentQueue : this->queues.size();
+}
+
+inline void ThreadPool::privatePush(std::function<void()> task)
+{
+    std::size_t index = privateOwnQueue();
+    if(index == this->queues.size())
+        index = this->nextQueue.fetch_add(1, std::memory_order_relaxed) % this->queues.size();
+
+    {
+        std::lock_guard<std::mutex> lock(this->queues[index]->mutex);
+        this->queues[index]->tasks.push_back(std::move(task));
+    }
+    this->queued.fetch_add(1);
+
+    // Taking the lock orders this against a worker checking queued and
+    // going to sleep, so the wake up can't be lost.
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+    }
+    this->wakeUp.notify_one();
+}
+
+inline bool ThreadPool::privateRunOne()
+{
+    const std::size_t count = this->queues.size();
+    const std::size_t own = privateOwnQueue();
+    std::function<void()> task;
+
+    if(own != count)
+    {
+        std::lock_guard<std::mutex> lock(this->queues[own]->mutex);
+        if(!this->queues[own]->tasks.empty())
+        {
+            task = std::move(this->queues[own]->tasks.back());
+            this->queues[own]->tasks.pop_back();
+        }
+    }
+
+    // Steal, starting next to the own deque so thieves spread out.
+    const std::size_t first = own != count ? own + 1 : this->nextQueue.load(std::memory_order_relaxed);
+    for(std::size_t i = 0; !task && i < count; i++)
+    {
+        WorkerQueue& victim = *this->queues[(first + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if(!task)
+        return false;
+
+    this->queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+inline void ThreadPool::privateWorkerLoop(std::size_t index)
+{
+    threadpool_detail::currentPool = this;
+    threadpool_detail::currentQueue = index;
+
+    while(true)
+    {
+        if(privateRunOne())
+            continue;
+
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        this->wakeUp.wait(lock, [this] {return this->stopping || this->queued.load() > 0;});
+        if(this->stopping && this->queued.load() == 0)
+            return;
+    }
+}
+
+inline ThreadPool::TaskGroup::~TaskGroup()
+{
+    try {
+        wait();
+    }
+    catch(...) {
+        // Whoever let the group go is unwinding already or didn't ask.
+    }
+}
+
+inline void ThreadPool::TaskGroup::privateFinish()
+{
+    std::lock_guard<std::mutex> lock(this->doneMutex);
+    if(this->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        this->done.notify_all();
+}
+
+template<typename Task>
+void ThreadPool::TaskGroup::run(Task&& task)
+{
+    this->pending.fetch_add(1);
+    try {
+        this->pool.privatePush([this, task = std::forward<Task>(task)]() mutable {
+            try {
+                task();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(this->errorMutex);
+                if(!this->error)
+                    this->error = std::current_exception();
+            }
+            privateFinish();
+        });
+    }
+    catch(...) {
+        // Never queued, so nothing will count it as finished.
+        privateFinish();
+        throw;
+    }
+}
+
+inline void ThreadPool::TaskGroup::wait()
+{
+    const bool worker = this->pool.privateOwnQueue() != this->pool.queues.size();
+    unsigned idle = 0;
+
+    while(this->pending.load(std::memory_order_acquire) > 0)
+    {
+        if(this->pool.privateRunOne())
+        {
+            idle = 0;
+            continue;
+        }
+
+        if(worker || ++idle < WAIT_SPINS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->doneMutex);
+        this->done.wait(lock, [this] {return this->pending.load(std::memory_order_acquire) == 0;});
+    }
+
+    // The last task may still be in privateFinish.
+    {
+        std::lock_guard<std::mutex> lock(this->doneMutex);
+    }
+
+    if(this->error)
+    {
+        std::exception_ptr thrown = std::move(this->error);
+        this->error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+#endif //REDBLACKTREE_THREADPOOL_H
@@ -0,0 +1,1130 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RedBlackTree.h"
+#include "ConcurrentRedBlackTree.h"
+#include "FrozenRedBlackTree.h"
+#include "IndexedRedBlackTree.h"
+#include "PersistentRedBlackTree.h"
+#include "ShardedRedBlackTree.h"
+#include "ThreadPool.h"
+
+/*
+ * Counts every trip to the global heap so the benchmarks can report
+ * allocations per operation next to the timings. Atomic since some
+ * benchmarks run threads. Every form of new and delete is replaced, plain,
+ * array, aligned and nothrow, so each delete frees memory the matching new
+ * got from the same place.
+ */
+static std::atomic<unsigned long long> heapAllocations = 0;
+
+static void* countedAllocate(std::size_t bytes, std::size_t alignment) noexcept
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if(bytes == 0)
+        bytes = 1;
+    if(alignment <= alignof(std::max_align_t))
+        return std::malloc(bytes);
+
+    // aligned_alloc wants a multiple of the alignment.
+    return std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+}
+
+void* operator new(std::size_t bytes)
+{
+    if(void* p = countedAllocate(bytes, alignof(std::max_align_t)))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t bytes)
+{
+    return ::operator new(bytes);
+}
+
+void* operator new(std::size_t bytes, std::align_val_t alignment)
+{
+    if(void* p = countedAllocate(bytes, (std::size_t)alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t bytes, std::align_val_t alignment)
+{
+    return ::operator new(bytes, alignment);
+}
+
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(bytes, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(bytes, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(bytes, (std::size_t)alignment);
+}
+
+void* operator new[](std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(bytes, (std::size_t)alignment);
+}
+
+/*
+ * Kept out of line: once GCC inlines a delete into code that got its
+ * pointer from operator new, it takes the free for a mismatched pair
+ * (-Wmismatched-new-delete), not knowing the new above uses malloc.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline))
+#endif
+static void countedFree(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p) noexcept {countedFree(p);}
+void operator delete[](void* p) noexcept {countedFree(p);}
+void operator delete(void* p, std::size_t) noexcept {countedFree(p);}
+void operator delete[](void* p, std::size_t) noexcept {countedFree(p);}
+void operator delete(void* p, std::align_val_t) noexcept {countedFree(p);}
+void operator delete[](void* p, std::align_val_t) noexcept {countedFree(p);}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {countedFree(p);}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {countedFree(p);}
+void operator delete(void* p, const std::nothrow_t&) noexcept {countedFree(p);}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {countedFree(p);}
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {countedFree(p);}
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {countedFree(p);}
+
+/**
+ * \brief       Returns the seconds passed since start.
+ */
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * \brief       Returns n shuffled, unique keys.
+ */
+static std::vector<int> shuffledKeys(unsigned n, unsigned seed)
+{
+    std::vector<int> keys(n);
+    for(unsigned i = 0; i < n; i++)
+        keys[i] = (int)i;
+
+    std::mt19937 rng(seed);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+/**
+ * \brief       Inserts n keys, removes them all and inserts them again,
+ *          reporting heap allocations and time per operation.
+ */
+static void benchmarkAllocations(unsigned n)
+{
+    auto keys = shuffledKeys(n, 1);
+    RedBlackTree<int, int> tree;
+
+    unsigned long long allocationsBefore = heapAllocations;
+    auto start = std::chrono::steady_clock::now();
+
+    for(int key : keys)
+        tree.insert(key, key);
+    for(int key : keys)
+        tree.remove(key);
+    for(int key : keys)
+        tree.insert(key, key);
+
+    double seconds = secondsSince(start);
+    double operations = 3.0 * n;
+
+    std::cout << "insert/remove/insert " << n << " keys: "
+              << (double)(heapAllocations - allocationsBefore) / operations << " allocations/op, "
+              << seconds * 1e9 / operations << " ns/op" << std::endl;
+}
+
+/**
+ * \brief       Builds a tree of n keys, then looks every key up once in a
+ *          different random order.
+ */
+template <typename Tree>
+static void benchmarkSearch(const std::string& name, unsigned n)
+{
+    auto keys = shuffledKeys(n, 2);
+    Tree tree;
+    for(int key : keys)
+        tree.insert(key, key);
+
+    auto lookups = shuffledKeys(n, 3);
+    long long checksum = 0;
+    int data = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int key : lookups)
+    {
+        if(tree.search(key, &data))
+            checksum += data;
+    }
+    double seconds = secondsSince(start);
+
+    std::cout << name << " search " << n << " keys: "
+              << seconds * 1e9 / n << " ns/lookup (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * \brief       Looks n even and odd keys up in batches of 64 and 256 with
+ *          searchBatch vs a loop calling find, in a tree of the n even keys.
+ */
+static void benchmarkSearchBatch(unsigned n)
+{
+    RedBlackTree<int, int> tree;
+    for(int key : shuffledKeys(n, 2))
+        tree.insert(key * 2, key);
+
+    auto lookups = shuffledKeys(2 * n, 3);
+    for(std::size_t width : {64, 256})
+    {
+        std::vector<int> batch;
+        std::vector<const int*> out;
+        long long checksum[2] = {0, 0};
+
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t first = 0; first < lookups.size(); first += width)
+        {
+            for(std::size_t i = first; i < std::min(first + width, lookups.size()); i++)
+            {
+                if(const int* data = tree.find(lookups[i]))
+                    checksum[0] += *data;
+            }
+        }
+        double findSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        for(std::size_t first = 0; first < lookups.size(); first += width)
+        {
+            batch.assign(lookups.begin() + (std::ptrdiff_t)first, lookups.begin() + (std::ptrdiff_t)std::min(first + width, lookups.size()));
+            tree.searchBatch(batch, out);
+            for(const int* data : out)
+            {
+                if(data != nullptr)
+                    checksum[1] += *data;
+            }
+        }
+        double batchSeconds = secondsSince(start);
+
+        std::cout << "batches of " << width << " lookups on " << n << " keys: find " << findSeconds * 1e9 / (double)lookups.size()
+                  << " ns/lookup, searchBatch " << batchSeconds * 1e9 / (double)lookups.size() << " ns/lookup"
+                  << (checksum[0] == checksum[1] ? "" : " (checksums DIFFER)") << std::endl;
+    }
+}
+
+/**
+ * \brief       Freezes a tree of n keys and looks every key, and as many
+ *          missing ones, up in a random order in both, next to 100 key range
+ *          scans.
+ */
+static void benchmarkFrozen(unsigned n)
+{
+    RedBlackTree<int, int> tree;
+    for(int key : shuffledKeys(n, 2))
+        tree.insert(key * 2, key);
+
+    auto start = std::chrono::steady_clock::now();
+    FrozenRedBlackTree<int, int> frozen = tree.freeze();
+    double freezeSeconds = secondsSince(start);
+
+    // Even keys are there, odd ones are not.
+    std::vector<int> lookups;
+    for(int key : shuffledKeys(2 * n, 3))
+        lookups.push_back(key);
+
+    auto run = [&lookups](const auto& searched) {
+        long long checksum = 0;
+        int data = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for(int key : lookups)
+        {
+            if(searched.search(key, &data))
+                checksum += data;
+        }
+        return std::make_pair(secondsSince(begin) * 1e9 / (double)lookups.size(), checksum);
+    };
+
+    auto [treeNs, treeChecksum] = run(tree);
+    auto [frozenNs, frozenChecksum] = run(frozen);
+
+    auto scans = [n](const auto& scanned) {
+        std::mt19937 rng(4);
+        long long checksum = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for(int i = 0; i < 10000; i++)
+        {
+            int lo = (int)(rng() % (2 * n));
+            scanned.scan(lo, lo + 199, [&checksum](const int&, const int& data) {checksum += data;});
+        }
+        return std::make_pair(secondsSince(begin) * 1e9 / 10000, checksum);
+    };
+
+    auto [treeScanNs, treeScanChecksum] = scans(tree);
+    auto [frozenScanNs, frozenScanChecksum] = scans(frozen);
+
+    std::cout << "frozen " << n << " keys: freeze " << freezeSeconds * 1e3 << " ms, search " << treeNs << " vs "
+              << frozenNs << " ns/lookup, 100 key scan " << treeScanNs << " vs " << frozenScanNs << " ns"
+              << (treeChecksum == frozenChecksum && treeScanChecksum == frozenScanChecksum ? "" : " (checksums DIFFER)") << std::endl;
+}
+
+/**
+ * \brief       Walks a tree of n keys in order with its iterators, forward
+ *          and in reverse.
+ */
+static void benchmarkIteration(unsigned n)
+{
+    auto keys = shuffledKeys(n, 2);
+    RedBlackTree<int, int> tree;
+    for(int key : keys)
+        tree.insert(key, key);
+
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto [key, data] : tree)
+        checksum += data;
+    double forwardSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for(auto it = tree.rbegin(); it != tree.rend(); ++it)
+        checksum += it->second;
+    double reverseSeconds = secondsSince(start);
+
+    std::cout << "iterate " << n << " keys: forward " << forwardSeconds * 1e9 / n
+              << " ns/entry, reverse " << reverseSeconds * 1e9 / n << " ns/entry (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * \brief       Runs 10000 scans of 100 consecutive keys each over a tree of
+ *          n keys, next to filtering a full walk for the same ranges.
+ */
+static void benchmarkRangeScan(unsigned n)
+{
+    const unsigned scans = 10000;
+    const int width = 100;
+    auto keys = shuffledKeys(n, 2);
+    RedBlackTree<int, int> tree;
+    for(int key : keys)
+        tree.insert(key, key);
+
+    auto starts = shuffledKeys(n, 6);
+    long long checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < scans; i++)
+        tree.scan(starts[i], starts[i] + width - 1, [&](const int&, int& data) {checksum += data;});
+    double scanSeconds = secondsSince(start);
+
+    // The old way: walk everything, keep what falls in the range. Only a
+    // few rounds, it is that slow.
+    const unsigned walks = 10;
+    start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < walks; i++)
+        for(auto [key, data] : tree)
+            if(key >= starts[i] && key < starts[i] + width)
+                checksum += data;
+    double walkSeconds = secondsSince(start);
+
+    std::cout << "range of " << width << " in " << n << " keys: scan " << scanSeconds * 1e9 / scans
+              << " ns/range, full walk " << walkSeconds * 1e9 / walks << " ns/range (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * \brief       Builds plain and order statistic trees of n keys, then
+ *          times rank and select against finding the k-th entry with an
+ *          in-order walk.
+ */
+static void benchmarkOrderStatistics(unsigned n)
+{
+    auto keys = shuffledKeys(n, 2);
+
+    RedBlackTree<int, int> plain;
+    auto start = std::chrono::steady_clock::now();
+    for(int key : keys)
+        plain.insert(key, key);
+    double plainInsertSeconds = secondsSince(start);
+
+    RedBlackTree<int, int, ThreeWayCompare, true> ranked;
+    start = std::chrono::steady_clock::now();
+    for(int key : keys)
+        ranked.insert(key, key);
+    double rankedInsertSeconds = secondsSince(start);
+
+    auto queries = shuffledKeys(n, 7);
+    long long checksum = 0;
+
+    start = std::chrono::steady_clock::now();
+    for(int key : queries)
+        checksum += (long long)ranked.rank(key);
+    double rankSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for(int key : queries)
+        checksum += ranked.select((unsigned)key)->second;
+    double selectSeconds = secondsSince(start);
+
+    // k-th smallest without sizes: walk k entries.
+    const unsigned walks = 10;
+    start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < walks; i++)
+        checksum += std::next(plain.begin(), queries[i])->second;
+    double walkSeconds = secondsSince(start);
+
+    std::cout << "order statistics " << n << " keys: insert " << plainInsertSeconds * 1e9 / n << " -> "
+              << rankedInsertSeconds * 1e9 / n << " ns/op, rank " << rankSeconds * 1e9 / n
+              << " ns, select " << selectSeconds * 1e9 / n << " ns, walk to k-th " << walkSeconds * 1e9 / walks
+              << " ns (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * \brief       Sums the data of random ranges spanning a tenth of the keys,
+ *          with a summing augment policy and by scanning.
+ */
+static void benchmarkAggregate(unsigned n)
+{
+    auto keys = shuffledKeys(n, 2);
+    RedBlackTree<int, long long, ThreeWayCompare, false, SumAugment<long long>> tree;
+    auto start = std::chrono::steady_clock::now();
+    for(int key : keys)
+        tree.insert(key, key);
+    double insertSeconds = secondsSince(start);
+
+    const unsigned queries = 10000;
+    const int width = (int)n / 10;
+    auto starts = shuffledKeys(n, 8);
+    long long checksum = 0;
+
+    start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < queries; i++)
+        checksum += tree.aggregate(starts[i], starts[i] + width);
+    double aggregateSeconds = secondsSince(start);
+
+    const unsigned scans = 20;
+    start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < scans; i++)
+        tree.scan(starts[i], starts[i] + width, [&](const int&, long long& data) {checksum += data;});
+    double scanSeconds = secondsSince(start);
+
+    std::cout << "range sum over " << width << " of " << n << " keys: insert " << insertSeconds * 1e9 / n
+              << " ns/op, aggregate " << aggregateSeconds * 1e9 / queries << " ns/range, scan "
+              << scanSeconds * 1e9 / scans << " ns/range (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * \brief       Builds a tree of n sorted keys by inserting them one by
+ *          one, with assignSorted, and with assign from shuffled input.
+ */
+static void benchmarkBulkBuild(unsigned n)
+{
+    std::vector<std::pair<int, int>> sorted(n);
+    for(unsigned i = 0; i < n; i++)
+        sorted[i] = {(int)i, (int)i};
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        RedBlackTree<int, int> tree;
+        for(auto [key, data] : sorted)
+            tree.insert(key, data);
+    }
+    double insertSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    {
+        RedBlackTree<int, int> tree;
+        tree.assignSorted(sorted.begin(), sorted.end());
+    }
+    double sortedSeconds = secondsSince(start);
+
+    std::vector<std::pair<int, int>> shuffled;
+    for(int key : shuffledKeys(n, 9))
+        shuffled.emplace_back(key, key);
+
+    start = std::chrono::steady_clock::now();
+    {
+        RedBlackTree<int, int> tree;
+        tree.assign(shuffled.begin(), shuffled.end());
+    }
+    double unsortedSeconds = secondsSince(start);
+
+    std::cout << "build " << n << " keys (incl. teardown): insert " << insertSeconds * 1e3 << " ms, assignSorted "
+              << sortedSeconds * 1e3 << " ms, assign shuffled " << unsortedSeconds * 1e3 << " ms" << std::endl;
+}
+
+/**
+ * \brief       Saves a tree of n shuffled keys to a snapshot and loads it
+ *          back, next to rebuilding it by inserting every key again.
+ */
+static void benchmarkSnapshot(unsigned n)
+{
+    RedBlackTree<int, int> tree;
+    auto keys = shuffledKeys(n, 10);
+    for(int key : keys)
+        tree.insert(key, key);
+
+    const std::string path = (std::filesystem::temp_directory_path() / "redblacktree_benchmark.rbts").string();
+    auto start = std::chrono::steady_clock::now();
+    bool saved = tree.save(path);
+    double saveSeconds = secondsSince(start);
+    double megabytes = saved ? (double)std::filesystem::file_size(path) / (1 << 20) : 0;
+
+    start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> loaded;
+    bool wasLoaded = loaded.load(path);
+    double loadSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> replayed;
+    for(int key : keys)
+        replayed.insert(key, key);
+    double replaySeconds = secondsSince(start);
+
+    std::filesystem::remove(path);
+    std::cout << "snapshot " << n << " keys (" << megabytes << " MB): save " << saveSeconds * 1e3 << " ms, load "
+              << loadSeconds * 1e3 << " ms, insert replay " << replaySeconds * 1e3 << " ms"
+              << (saved && wasLoaded && loaded.getTotalSize() == n ? "" : " (snapshot FAILED)") << std::endl;
+}
+
+/**
+ * \brief       Applies batches of mixed inserts/removes to an n key tree, one
+ *          call per operation vs one applyBatch per batch.
+ */
+static void benchmarkBatch(unsigned n, unsigned batchSize)
+{
+    const unsigned batches = std::max(1u, 262144 / batchSize);
+
+    std::mt19937 rng(11);
+    std::vector<std::vector<RedBlackTree<int, int>::BatchOperation>> work(batches);
+    for(auto& batch : work)
+    {
+        for(unsigned i = 0; i < batchSize; i++)
+        {
+            int key = (int)(rng() % (2 * n));
+            batch.push_back({rng() % 2 ? BatchOpType::insert : BatchOpType::remove, key, key});
+        }
+    }
+
+    RedBlackTree<int, int> single;
+    RedBlackTree<int, int> batched;
+    for(int key : shuffledKeys(n, 1))
+    {
+        single.insert(2 * key, key);
+        batched.insert(2 * key, key);
+    }
+
+    long long singleHits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto& batch : work)
+    {
+        for(auto& op : batch)
+            singleHits += op.type == BatchOpType::insert ? single.insert(op.key, op.data) : single.remove(op.key);
+    }
+    double singleSeconds = secondsSince(start);
+
+    long long batchHits = 0;
+    start = std::chrono::steady_clock::now();
+    for(auto& batch : work)
+    {
+        for(bool hit : batched.applyBatch(std::move(batch)))
+            batchHits += hit;
+    }
+    double batchSeconds = secondsSince(start);
+
+    double ops = (double)batchSize * batches;
+    std::cout << "batches of " << batchSize << " on " << n << " keys: insert/remove " << singleSeconds / ops * 1e9
+              << " ns/op, applyBatch " << batchSeconds / ops * 1e9 << " ns/op (hits " << singleHits << "/"
+              << batchHits << ")" << std::endl;
+}
+
+/**
+ * \brief       Moves the lowest tenth of an n key tree into a tree of its
+ *          own: one remove plus one insert per key vs split, then puts it
+ *          back: one insert per key vs join.
+ */
+static void benchmarkSplitJoin(unsigned n)
+{
+    const int cut = (int)(n / 10);
+
+    RedBlackTree<int, int> single;
+    RedBlackTree<int, int> tree;
+    for(int key : shuffledKeys(n, 1))
+    {
+        single.insert(key, key);
+        tree.insert(key, key);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> archived;
+    for(int key = 0; key < cut; key++)
+    {
+        single.remove(key);
+        archived.insert(key, key);
+    }
+    double moveSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for(int key = 0; key < cut; key++)
+        single.insert(key, key);
+    double backSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> upper = tree.split(cut);
+    double splitSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    tree.join(std::move(upper));
+    double joinSeconds = secondsSince(start);
+
+    std::cout << "move " << cut << " of " << n << " keys: remove+insert " << moveSeconds * 1e3 << " ms, split "
+              << splitSeconds * 1e6 << " us; back: insert " << backSeconds * 1e3 << " ms, join " << joinSeconds * 1e6
+              << " us (" << tree.getTotalSize() << " keys)" << std::endl;
+}
+
+/**
+ * \brief       Reconciles two n key trees sharing half their keys: walking
+ *          one and inserting into the other vs unionWith, on 1 thread and
+ *          on at least 4. Also merges an n/100 key tree in.
+ */
+static void benchmarkSetOperations(unsigned n)
+{
+    // Keys 0 .. n-1 and n/2 .. 3n/2-1.
+    auto build = [n](RedBlackTree<int, int>& tree, int offset) {
+        for(int key : shuffledKeys(n, 1))
+            tree.insert(key + offset, key);
+    };
+
+    RedBlackTree<int, int> target;
+    RedBlackTree<int, int> source;
+    build(target, 0);
+    build(source, (int)n / 2);
+
+    auto start = std::chrono::steady_clock::now();
+    for(auto [key, data] : source)
+        target.insert(key, data);
+    double insertSeconds = secondsSince(start);
+
+    double unionSeconds[2];
+    ThreadPool single(1);
+    ThreadPool wide(std::max(4u, std::thread::hardware_concurrency()));
+    ThreadPool* pools[2] = {&single, &wide};
+    for(int i = 0; i < 2; i++)
+    {
+        RedBlackTree<int, int> a;
+        RedBlackTree<int, int> b;
+        build(a, 0);
+        build(b, (int)n / 2);
+
+        start = std::chrono::steady_clock::now();
+        a.unionWith(std::move(b), *pools[i]);
+        unionSeconds[i] = secondsSince(start);
+    }
+
+    RedBlackTree<int, int> big;
+    RedBlackTree<int, int> small;
+    build(big, 0);
+    for(int key : shuffledKeys(n / 100, 2))
+        small.insert(key * 100 + 50, key);
+
+    start = std::chrono::steady_clock::now();
+    big.unionWith(std::move(small), single);
+    double smallSeconds = secondsSince(start);
+
+    std::cout << "union of two " << n << " key trees: insert loop " << insertSeconds * 1e3 << " ms, unionWith "
+              << unionSeconds[0] * 1e3 << " ms on 1 thread, " << unionSeconds[1] * 1e3 << " ms on " << wide.getThreadCount()
+              << "; " << n / 100 << " keys into " << n << ": " << smallSeconds * 1e3 << " ms" << std::endl;
+}
+
+/**
+ * \brief       Sums, updates and copies a tree of n keys with a sequential
+ *          in-order walk vs parallel_reduce, parallel_for_each and
+ *          parallel_transform on 1 and on at least 4 threads.
+ */
+static void benchmarkParallelTraversal(unsigned n)
+{
+    RedBlackTree<int, int> tree;
+    for(int key : shuffledKeys(n, 1))
+        tree.insert(key, key);
+
+    auto mix = [](const int& key, const int& data) {return (long long)key * 31 + data;};
+
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto [key, data] : tree)
+        checksum += mix(key, data);
+    double sumSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for(auto [key, data] : tree)
+        data += 1;
+    double updateSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    RedBlackTree<int, long long> copy;
+    for(auto [key, data] : tree)
+        copy.append(key, mix(key, data));
+    double copySeconds = secondsSince(start);
+
+    unsigned threads[2] = {1, std::max(4u, std::thread::hardware_concurrency())};
+    for(unsigned t : threads)
+    {
+        ThreadPool pool(t);
+
+        // Undoes the sequential update, so the sums compare.
+        start = std::chrono::steady_clock::now();
+        tree.parallel_for_each([](const int&, int& data) {data -= 1;}, pool);
+        double parallelUpdateSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        long long parallelChecksum = tree.parallel_reduce(0LL, mix, std::plus<long long>(), pool);
+        double parallelSumSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        auto parallelCopy = tree.parallel_transform(mix, pool);
+        double parallelCopySeconds = secondsSince(start);
+
+        std::cout << "traverse " << n << " keys on " << t << " threads: sum " << sumSeconds * 1e3 << " ms vs parallel_reduce "
+                  << parallelSumSeconds * 1e3 << " ms, update " << updateSeconds * 1e3 << " ms vs parallel_for_each "
+                  << parallelUpdateSeconds * 1e3 << " ms, copy " << copySeconds * 1e3 << " ms vs parallel_transform "
+                  << parallelCopySeconds * 1e3 << " ms (checksums " << (parallelChecksum == checksum ? "match" : "DIFFER")
+                  << ", " << parallelCopy.getTotalSize() << " copied)" << std::endl;
+
+        tree.parallel_for_each([](const int&, int& data) {data += 1;}, pool);
+    }
+}
+
+/**
+ * \brief       Derives a tree of the even keys of an n key tree with an
+ *          insert loop vs parallel_filter, and builds a tree from n shuffled
+ *          entries with an insert loop, assign and parallel_assign, on 1
+ *          and on at least 4 threads.
+ */
+static void benchmarkParallelBuild(unsigned n)
+{
+    auto keys = shuffledKeys(n, 1);
+    std::vector<std::pair<int, int>> entries;
+    entries.reserve(n);
+    for(int key : keys)
+        entries.emplace_back(key, key);
+
+    RedBlackTree<int, int> tree;
+    tree.assign(entries.begin(), entries.end());
+    auto even = [](const int& key, const int&) {return key % 2 == 0;};
+
+    auto start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> filtered;
+    for(auto [key, data] : tree)
+    {
+        if(even(key, data))
+            filtered.insert(key, data);
+    }
+    double filterSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> inserted;
+    for(auto [key, data] : entries)
+        inserted.insert(key, data);
+    double insertSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> assigned;
+    assigned.assign(entries.begin(), entries.end());
+    double assignSeconds = secondsSince(start);
+
+    unsigned threads[2] = {1, std::max(4u, std::thread::hardware_concurrency())};
+    for(unsigned t : threads)
+    {
+        ThreadPool pool(t);
+
+        start = std::chrono::steady_clock::now();
+        auto parallelFiltered = tree.parallel_filter(even, pool);
+        double parallelFilterSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        RedBlackTree<int, int> parallelAssigned;
+        parallelAssigned.parallel_assign(entries.begin(), entries.end(), pool);
+        double parallelAssignSeconds = secondsSince(start);
+
+        std::cout << "build from " << n << " keys on " << t << " threads: filter by insert " << filterSeconds * 1e3
+                  << " ms vs parallel_filter " << parallelFilterSeconds * 1e3 << " ms (" << parallelFiltered.getTotalSize() << " of "
+                  << filtered.getTotalSize() << "), unsorted by insert " << insertSeconds * 1e3 << " ms, assign "
+                  << assignSeconds * 1e3 << " ms vs parallel_assign " << parallelAssignSeconds * 1e3 << " ms ("
+                  << parallelAssigned.getTotalSize() << " of " << inserted.getTotalSize() << ")" << std::endl;
+    }
+}
+
+/**
+ * \brief       Mixed load on n keys (half searches, a quarter each inserts
+ *          and removes of random keys) from 1 to 64 threads: one
+ *          RedBlackTree behind a global mutex vs ConcurrentRedBlackTree.
+ */
+static void benchmarkConcurrent(unsigned n)
+{
+    const unsigned operations = n;
+
+    // Runs operations split across threads, op(key, kind) does one.
+    auto run = [operations](unsigned threads, unsigned range, auto&& op) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t] {
+                std::mt19937 rng(t + 1);
+                for(unsigned i = 0; i < operations / threads; i++)
+                {
+                    unsigned value = (unsigned)rng();
+                    op((int)(value % range), (value >> 30) & 3);
+                }
+            });
+        }
+        for(auto& worker : workers)
+            worker.join();
+        return secondsSince(start) * 1e9 / operations;
+    };
+
+    std::mutex mutex;
+    RedBlackTree<int, int> locked;
+    ConcurrentRedBlackTree<int, int> concurrent;
+    for(int key : shuffledKeys(n, 1))
+    {
+        locked.insert(key * 2, key);
+        concurrent.insert(key * 2, key);
+    }
+
+    for(unsigned threads : {1u, 2u, 4u, 8u, 16u, 32u, 64u})
+    {
+        double lockedNs = run(threads, 2 * n, [&](int key, unsigned kind) {
+            std::lock_guard<std::mutex> guard(mutex);
+            int data;
+            if(kind < 2)
+                locked.search(key, &data);
+            else if(kind == 2)
+                locked.insert(key, key);
+            else
+                locked.remove(key);
+        });
+
+        double concurrentNs = run(threads, 2 * n, [&](int key, unsigned kind) {
+            int data;
+            if(kind < 2)
+                concurrent.search(key, &data);
+            else if(kind == 2)
+                concurrent.insert(key, key);
+            else
+                concurrent.remove(key);
+        });
+
+        std::cout << "mixed load on " << n << " keys, " << threads << " threads: global mutex " << lockedNs
+                  << " ns/op, ConcurrentRedBlackTree " << concurrentNs << " ns/op" << std::endl;
+    }
+}
+
+/**
+ * \brief       Point-in-time copies: RedBlackTree copied entry by entry
+ *          into a new tree vs PersistentRedBlackTree::snapshot, and what
+ *          path copying costs per insert/remove.
+ */
+static void benchmarkPersistent(unsigned n)
+{
+    std::vector<int> keys = shuffledKeys(n, 1);
+
+    RedBlackTree<int, int> tree;
+    auto start = std::chrono::steady_clock::now();
+    for(int key : keys)
+        tree.insert(key, key);
+    double treeInsertNs = secondsSince(start) * 1e9 / n;
+
+    PersistentRedBlackTree<int, int> persistent;
+    start = std::chrono::steady_clock::now();
+    for(int key : keys)
+        persistent.insert(key, key);
+    double persistentInsertNs = secondsSince(start) * 1e9 / n;
+
+    start = std::chrono::steady_clock::now();
+    RedBlackTree<int, int> copy;
+    copy.assignSorted(tree.begin(), tree.end());
+    double copyMs = secondsSince(start) * 1e3;
+
+    // Snapshots taken every 1000 removes, all kept alive.
+    const unsigned snapshots = 1000;
+    std::vector<PersistentRedBlackTree<int, int>> versions;
+    versions.reserve(snapshots);
+    double snapshotSeconds = 0;
+    start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < snapshots; i++)
+    {
+        auto snapshotStart = std::chrono::steady_clock::now();
+        versions.push_back(persistent.snapshot());
+        snapshotSeconds += secondsSince(snapshotStart);
+
+        for(unsigned j = 0; j < 1000 && i * 1000 + j < n; j++)
+            persistent.remove(keys[i * 1000 + j]);
+    }
+    double removeNs = (secondsSince(start) - snapshotSeconds) * 1e9 / std::min(n, snapshots * 1000);
+
+    std::cout << "snapshots of " << n << " keys: RedBlackTree copy " << copyMs << " ms, snapshot "
+              << snapshotSeconds * 1e9 / snapshots << " ns; insert RedBlackTree " << treeInsertNs
+              << " ns, PersistentRedBlackTree " << persistentInsertNs << " ns; remove with " << snapshots
+              << " live snapshots " << removeNs << " ns (oldest still has " << versions[0].getTotalSize()
+              << " keys)" << std::endl;
+}
+
+/**
+ * \brief       Mixed load on n keys (half searches, a quarter each inserts
+ *          and removes of random keys) from 1 up to 16 threads: one
+ *          RedBlackTree behind a global mutex vs ShardedRedBlackTree.
+ */
+static void benchmarkSharded(unsigned n)
+{
+    const unsigned operations = n;
+
+    // Runs operations split across threads, op(key, kind) does one.
+    auto run = [operations](unsigned threads, unsigned range, auto&& op) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t] {
+                std::mt19937 rng(t + 1);
+                for(unsigned i = 0; i < operations / threads; i++)
+                {
+                    unsigned value = (unsigned)rng();
+                    op((int)(value % range), (value >> 30) & 3);
+                }
+            });
+        }
+        for(auto& worker : workers)
+            worker.join();
+        return secondsSince(start) * 1e9 / operations;
+    };
+
+    for(unsigned threads : {1u, 4u, 16u})
+    {
+        std::mutex mutex;
+        RedBlackTree<int, int> locked;
+        ShardedRedBlackTree<int, int> sharded;
+        for(int key : shuffledKeys(n, 1))
+        {
+            locked.insert(key * 2, key);
+            sharded.insert(key * 2, key);
+        }
+
+        double lockedNs = run(threads, 2 * n, [&](int key, unsigned kind) {
+            std::lock_guard<std::mutex> guard(mutex);
+            int data;
+            if(kind < 2)
+                locked.search(key, &data);
+            else if(kind == 2)
+                locked.insert(key, key);
+            else
+                locked.remove(key);
+        });
+
+        double shardedNs = run(threads, 2 * n, [&](int key, unsigned kind) {
+            int data;
+            if(kind < 2)
+                sharded.search(key, &data);
+            else if(kind == 2)
+                sharded.insert(key, key);
+            else
+                sharded.remove(key);
+        });
+
+        std::cout << "mixed load on " << n << " keys, " << threads << " threads: global mutex " << lockedNs
+                  << " ns/op, ShardedRedBlackTree " << shardedNs << " ns/op (" << sharded.getShardCount()
+                  << " shards)" << std::endl;
+    }
+}
+
+/**
+ * \brief       Loads n increasing keys (every 8th one a little out of
+ *          order): insert vs append, for int and long std::string keys.
+ */
+static void benchmarkHintedInsert(unsigned n)
+{
+    std::mt19937 rng(13);
+    std::vector<int> keys(n);
+    for(unsigned i = 0; i < n; i++)
+        keys[i] = (int)(i * 4) - (i % 8 == 0 ? (int)(rng() % 16) : 0);
+
+    const std::string prefix = "/var/lib/redBlackTree/keys/";
+    std::vector<std::string> names;
+    for(int key : keys)
+    {
+        std::string digits = std::to_string(key + 100);
+        names.push_back(prefix + std::string(12 - digits.size(), '0') + digits);
+    }
+
+    double seconds[4];
+    for(int mode = 0; mode < 4; mode++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if(mode < 2)
+        {
+            RedBlackTree<int, int> tree;
+            for(int key : keys)
+                mode == 0 ? tree.insert(key, key) : tree.append(key, key);
+        }
+        else
+        {
+            RedBlackTree<std::string, int> tree;
+            for(const std::string& name : names)
+                mode == 2 ? tree.insert(name, 0) : tree.append(name, 0);
+        }
+        seconds[mode] = secondsSince(start);
+    }
+
+    std::cout << "near-sorted load of " << n << " keys (incl. teardown): int insert " << seconds[0] / n * 1e9
+              << " ns, append " << seconds[1] / n * 1e9 << " ns; string insert " << seconds[2] / n * 1e9
+              << " ns, append " << seconds[3] / n * 1e9 << " ns" << std::endl;
+}
+
+/**
+ * \brief       Same as benchmarkSearch, but with std::string keys sharing a
+ *          long prefix, so each key comparison is expensive.
+ */
+template <typename Compare>
+static void benchmarkStringSearch(const std::string& name, unsigned n)
+{
+    const std::string prefix = "/var/lib/redBlackTree/keys/";
+    auto keys = shuffledKeys(n, 2);
+    RedBlackTree<std::string, int, Compare> tree;
+    for(int key : keys)
+        tree.insert(prefix + std::to_string(key), key);
+
+    std::vector<std::string> lookups;
+    for(int key : shuffledKeys(n, 3))
+        lookups.push_back(prefix + std::to_string(key));
+
+    long long checksum = 0;
+    int data = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(const std::string& key : lookups)
+    {
+        if(tree.search(key, &data))
+            checksum += data;
+    }
+    double seconds = secondsSince(start);
+
+    std::cout << name << " string search " << n << " keys: "
+              << seconds * 1e9 / n << " ns/lookup (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * \brief       4KB payload, standing in for large record values.
+ */
+struct Record
+{
+    char bytes[4096];
+
+    explicit Record(int seed) {std::fill(std::begin(bytes), std::end(bytes), (char)seed);}
+};
+
+/**
+ * \brief       Inserts n 4KB records with insert and then with try_emplace,
+ *          every key twice, so half the calls hit an existing key.
+ */
+static void benchmarkRecords(unsigned n)
+{
+    auto keys = shuffledKeys(n, 4);
+
+    RedBlackTree<int, Record> inserted;
+    auto start = std::chrono::steady_clock::now();
+    for(int round = 0; round < 2; round++)
+        for(int key : keys)
+            inserted.insert(key, Record(key));
+    double insertSeconds = secondsSince(start);
+
+    RedBlackTree<int, Record> emplaced;
+    start = std::chrono::steady_clock::now();
+    for(int round = 0; round < 2; round++)
+        for(int key : keys)
+            emplaced.try_emplace(key, key);
+    double emplaceSeconds = secondsSince(start);
+
+    std::cout << "4KB records " << n << " keys: insert " << insertSeconds * 1e9 / (2.0 * n)
+              << " ns/op, try_emplace " << emplaceSeconds * 1e9 / (2.0 * n) << " ns/op" << std::endl;
+
+    auto lookups = shuffledKeys(n, 5);
+    long long checksum = 0;
+    Record copy(0);
+
+    start = std::chrono::steady_clock::now();
+    for(int key : lookups)
+    {
+        if(emplaced.search(key, &copy))
+            checksum += copy.bytes[0];
+    }
+    double searchSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for(int key : lookups)
+    {
+        if(const Record* record = emplaced.find(key))
+            checksum += record->bytes[0];
+    }
+    double findSeconds = secondsSince(start);
+
+    std::cout << "4KB records " << n << " keys: search " << searchSeconds * 1e9 / n
+              << " ns/lookup, find " << findSeconds * 1e9 / n << " ns/lookup (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    // Every argument is a tree size to run, e.g. 1000000 10000000.
+    std::vector<unsigned> sizes;
+    for(int i = 1; i < argc; i++)
+        sizes.push_back((unsigned)std::stoul(argv[i]));
+    if(sizes.empty())
+        sizes.push_back(1000000);
+
+    for(unsigned n : sizes)
+    {
+        benchmarkAllocations(n);
+        benchmarkSearch<RedBlackTree<int, int>>("RedBlackTree", n);
+        benchmarkSearch<IndexedRedBlackTree<int, int>>("IndexedRedBlackTree", n);
+        benchmarkFrozen(n);
+        benchmarkSearchBatch(n);
+        benchmarkIteration(n);
+        benchmarkRangeScan(n);
+        benchmarkOrderStatistics(n);
+        benchmarkAggregate(n);
+        benchmarkBulkBuild(n);
+        benchmarkSnapshot(n);
+        benchmarkBatch(n, 4096);
+        benchmarkBatch(n, n / 4);
+        benchmarkBatch(n, n);
+        benchmarkSplitJoin(n);
+        benchmarkSetOperations(n);
+        benchmarkParallelTraversal(n);
+        benchmarkParallelBuild(n);
+        benchmarkHintedInsert(n);
+        benchmarkSharded(n);
+        benchmarkPersistent(n);
+        benchmarkConcurrent(n);
+        benchmarkStringSearch<std::less<std::string>>("std::less", n);
+        benchmarkStringSearch<ThreeWayCompare>("ThreeWayCompare", n);
+        benchmarkRecords(n / 10);
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+#include "ConcurrentRedBlackTree.h"
+#include "ShardedRedBlackTree.h"
+
+/*
+ * Same checks as test.cpp, counted atomically since every worker thread
+ * checks its own results.
+ */
+static std::atomic<int> failures{0};
+
+#define CHECK(expression) \
+    do { \
+        if(!(expression)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #expression ") failed" << std::endl; \
+            failures++; \
+        } \
+    } while(false)
+
+/*
+ * Every thread owns the keys k with k % THREADS == its index, so threads
+ * interleave all over the tree, but each one knows exactly what its own
+ * keys hold and checks every answer against a std::map of them.
+ */
+static constexpr int THREADS = 8;
+static constexpr int KEYS_PER_THREAD = 2000;
+static constexpr int OPERATIONS_PER_THREAD = 40000;
+
+/**
+ * \brief       Random inserts, removes, searches and scans from one thread
+ *          on its own keys of tree, checked against model.
+ *
+ * \details     A scan may or may not see other threads' keys that change
+ *          during it, but this thread's keys hold still while it scans, so
+ *          the scan has to show exactly the ones in model, in key order.
+ */
+template<typename Tree>
+static void runWorker(Tree& tree, int index, std::map<int, int>& model)
+{
+    std::mt19937 rng((unsigned)index + 1);
+    auto ownKey = [&] {return (int)(rng() % KEYS_PER_THREAD) * THREADS + index;};
+
+    for(int op = 0; op < OPERATIONS_PER_THREAD; op++)
+    {
+        const int key = ownKey();
+        const unsigned kind = rng() % 10;
+
+        if(kind < 4)
+        {
+            const int data = (int)rng();
+            const bool inserted = tree.insert(key, data);
+            CHECK(inserted == (model.count(key) == 0));
+            if(inserted)
+                model[key] = data;
+        }
+        else if(kind < 7)
+        {
+            CHECK(tree.remove(key) == (model.erase(key) == 1));
+        }
+        else if(kind < 9)
+        {
+            int data = 0;
+            const auto found = model.find(key);
+            CHECK(tree.search(key, &data) == (found != model.end()));
+            CHECK(found == model.end() || data == found->second);
+        }
+        else
+        {
+            const int hi = key + 50 * THREADS;
+            auto expected = model.lower_bound(key);
+            int previous = -1;
+            bool ordered = true;
+            bool matches = true;
+
+            tree.scan(key, hi, [&](const int& seen, const int& data) {
+                ordered = ordered && seen > previous;
+                previous = seen;
+                if(seen % THREADS != index)
+                    return;
+
+                matches = matches && expected != model.end() && expected->first == seen && expected->second == data;
+                if(expected != model.end())
+                    ++expected;
+            });
+
+            CHECK(ordered);
+            CHECK(matches);
+            CHECK(expected == model.end() || expected->first > hi);
+        }
+    }
+}
+
+/**
+ * \brief       Runs THREADS workers on tree at once, plus background while
+ *          they are busy, then checks tree holds exactly the union of their
+ *          models.
+ */
+template<typename Tree, typename Background>
+static void runStress(Tree& tree, Background&& background)
+{
+    std::vector<std::map<int, int>> models(THREADS);
+    std::atomic<bool> done{false};
+
+    std::thread other([&] {
+        while(!done.load())
+            background();
+    });
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < THREADS; i++)
+        workers.emplace_back([&tree, &models, i] {runWorker(tree, i, models[i]);});
+    for(std::thread& worker : workers)
+        worker.join();
+
+    done = true;
+    other.join();
+
+    std::map<int, int> expected;
+    for(const auto& model : models)
+        expected.insert(model.begin(), model.end());
+
+    std::map<int, int> contents;
+    tree.scan(0, KEYS_PER_THREAD * THREADS, [&](const int& key, const int& data) {contents.emplace(key, data);});
+
+    CHECK(tree.getTotalSize() == expected.size());
+    CHECK(contents == expected);
+}
+
+int main()
+{
+    {
+        ConcurrentRedBlackTree<int, int> tree;
+        // A reader scanning everything throughout.
+        runStress(tree, [&tree] {
+            unsigned long long count = tree.scan(0, KEYS_PER_THREAD * THREADS, [](const int&, const int&) {});
+            CHECK(count <= (unsigned long long)KEYS_PER_THREAD * THREADS);
+        });
+    }
+
+    {
+        // Small shards, so inserts rebalance on their own too.
+        ShardedRedBlackTree<int, int> tree(16, 64);
+        runStress(tree, [&tree] {
+            tree.rebalance();
+            CHECK(tree.getShardCount() >= 1 && tree.getShardCount() <= 16);
+            std::this_thread::yield();
+        });
+        CHECK(tree.getShardCount() > 1);
+    }
+
+    if(failures > 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,1482 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "RedBlackTree.h"
+#include "IndexedRedBlackTree.h"
+#include "FrozenRedBlackTree.h"
+#include "PersistentRedBlackTree.h"
+#include "ShardedRedBlackTree.h"
+#include "ThreadPool.h"
+
+/*
+ * Checks that report the expression and line on failure and keep going, so
+ * one run lists everything that is broken. They stay on in release builds.
+ */
+static int failures = 0;
+
+#define CHECK(expression) \
+    do { \
+        if(!(expression)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #expression ") failed" << std::endl; \
+            failures++; \
+        } \
+    } while(false)
+
+/**
+ * \brief       Runs random inserts, removes and searches on the 32-bit
+ *          index tree against std::map, so freed slots get reused.
+ */
+static void testIndexedTree()
+{
+    IndexedRedBlackTree<int, int> tree;
+    tree.reserve(1000);
+    std::map<int, int> entries;
+    std::mt19937 rng(41);
+
+    bool same = true;
+    for(int i = 0; i < 200000; i++)
+    {
+        const int key = (int)(rng() % 3000);
+        int data = -1;
+        switch(rng() % 3)
+        {
+            case 0:
+                same = same && tree.insert(key, i) == entries.emplace(key, i).second;
+                break;
+            case 1:
+                same = same && tree.remove(key) == (entries.erase(key) == 1);
+                break;
+            default:
+                same = same && tree.search(key, &data) == entries.contains(key) && (!entries.contains(key) || data == entries.at(key));
+        }
+    }
+    CHECK(same);
+    CHECK(tree.isValid() && tree.getTotalSize() == entries.size());
+
+    // In order and in reverse, where the fix-up carries red up the most.
+    IndexedRedBlackTree<int, int> ascending;
+    IndexedRedBlackTree<int, int> descending;
+    for(int key = 0; key < 50000; key++)
+    {
+        CHECK(ascending.insert(key, key));
+        CHECK(descending.insert(-key, key));
+    }
+    CHECK(ascending.isValid() && ascending.getTotalSize() == 50000);
+    CHECK(descending.isValid() && descending.getTotalSize() == 50000);
+
+    for(const auto& [key, data] : entries)
+        CHECK(tree.remove(key));
+    CHECK(tree.isValid() && tree.getTotalSize() == 0 && !tree.remove(0));
+    CHECK(tree.insert(5, 5) && !tree.insert(5, 6) && tree.isValid());
+}
+
+/**
+ * \brief       Looks int keys up with unsigned and wider integer types. They
+ *          have to be converted to int first, not compared with mixed
+ *          signedness, or every negative key sorts above the rest.
+ */
+static void testMixedSignedness()
+{
+    RedBlackTree<int, int> tree;
+    for(int key : {-5, -1, 3, 7, 10})
+        tree.insert(key, key * 10);
+
+    CHECK(tree.contains((std::size_t)7));
+    CHECK(tree.find(3u) != nullptr && *tree.find(3u) == 30);
+    CHECK(tree.at(10ull) == 100);
+    int data = 0;
+    CHECK(tree.search((unsigned short)3, &data) && data == 30);
+    CHECK(tree.lower_bound((std::size_t)0) != tree.end() && tree.lower_bound((std::size_t)0)->first == 3);
+    CHECK(tree.upper_bound(3u) != tree.end() && tree.upper_bound(3u)->first == 7);
+    CHECK(tree.remove((std::size_t)7));
+    CHECK(!tree.contains(7));
+    CHECK(tree.contains(-5) && tree.contains(-1));
+    CHECK(tree.emplace((std::size_t)8, 80));
+    CHECK(tree.lower_bound(4)->first == 8);
+
+    // Non-numeric transparent lookups still skip the conversion.
+    RedBlackTree<std::string, int> names;
+    names.insert("b", 2);
+    CHECK(names.contains(std::string_view("b")));
+    CHECK(names.contains("b"));
+    CHECK(!names.contains("a"));
+}
+
+/**
+ * \brief       Walks trees forward and backward, with ++, -- from end()
+ *          and the reverse iterators, against a std::map, on an empty tree,
+ *          a single entry and random trees after removes.
+ */
+static void testIterators()
+{
+    RedBlackTree<int, int> tree;
+    CHECK(tree.begin() == tree.end());
+    CHECK(tree.rbegin() == tree.rend());
+    CHECK(std::as_const(tree).crbegin() == std::as_const(tree).crend());
+
+    tree.insert(5, 50);
+    CHECK(tree.begin()->first == 5 && std::next(tree.begin()) == tree.end());
+    CHECK(std::prev(tree.end()) == tree.begin());
+    CHECK(tree.rbegin()->first == 5 && std::next(tree.rbegin()) == tree.rend());
+
+    std::mt19937 rng(41);
+    std::map<int, int> expected{{5, 50}};
+    auto same = [](const auto& entry, const auto& want) {return entry.first == want.first && entry.second == want.second;};
+    for(int round = 0; round < 3; round++)
+    {
+        for(int i = 0; i < 2000; i++)
+        {
+            const int key = (int)(rng() % 5000);
+            tree.insert(key, key * 10);
+            expected.emplace(key, key * 10);
+        }
+        for(int i = 0; i < 1000; i++)
+        {
+            const int key = (int)(rng() % 5000);
+            tree.remove(key);
+            expected.erase(key);
+        }
+
+        CHECK(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), same));
+        CHECK(std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend(), same));
+        CHECK(std::equal(std::as_const(tree).crbegin(), std::as_const(tree).crend(), expected.rbegin(), expected.rend(), same));
+        CHECK((std::size_t)std::distance(tree.begin(), tree.end()) == expected.size());
+
+        // -- from end() reaches the largest key, and every step back is the
+        // one before it.
+        auto at = tree.end();
+        for(auto want = expected.rbegin(); want != expected.rend(); ++want)
+        {
+            --at;
+            CHECK(at->first == want->first);
+        }
+        CHECK(at == tree.begin());
+        CHECK(std::prev(tree.end())->first == expected.rbegin()->first);
+        CHECK(tree.rbegin()->first == expected.rbegin()->first);
+        CHECK(std::prev(tree.rend())->first == expected.begin()->first);
+    }
+
+    // Writes through an iterator land in the tree.
+    for(auto entry = tree.begin(); entry != tree.end(); ++entry)
+        entry->second = -entry->first;
+    for(auto entry = tree.rbegin(); entry != tree.rend(); ++entry)
+        CHECK(entry->second == -entry->first);
+
+    while(!expected.empty())
+    {
+        tree.remove(expected.begin()->first);
+        expected.erase(expected.begin());
+    }
+    CHECK(tree.begin() == tree.end() && tree.rbegin() == tree.rend());
+}
+
+/**
+ * \brief       Checks floor, ceiling, predecessor, successor, lower_bound,
+ *          upper_bound and equal_range against a std::set at every key
+ *          from below the smallest to above the largest, including an empty
+ *          tree and one with a single entry.
+ */
+static void testOrderedLookups()
+{
+    auto check = [](const RedBlackTree<int, int>& tree, const std::set<int>& keys, int lo, int hi) {
+        const auto end = tree.end();
+        auto is = [&end](auto found, std::set<int>::const_iterator want, const std::set<int>& keys) {
+            return want == keys.end() ? found == end : found != end && found->first == *want;
+        };
+        for(int key = lo; key <= hi; key++)
+        {
+            const auto above = keys.upper_bound(key);
+            const auto notBelow = keys.lower_bound(key);
+            const auto notAbove = above == keys.begin() ? keys.end() : std::prev(above);
+            const auto below = notBelow == keys.begin() ? keys.end() : std::prev(notBelow);
+
+            CHECK(is(tree.ceiling(key), notBelow, keys) && is(tree.lower_bound(key), notBelow, keys));
+            CHECK(is(tree.successor(key), above, keys) && is(tree.upper_bound(key), above, keys));
+            CHECK(is(tree.floor(key), notAbove, keys));
+            CHECK(is(tree.predecessor(key), below, keys));
+
+            const auto range = tree.equal_range(key);
+            CHECK(is(range.first, notBelow, keys) && is(range.second, above, keys));
+            CHECK(std::distance(range.first, range.second) == (keys.count(key) == 1 ? 1 : 0));
+        }
+    };
+
+    RedBlackTree<int, int> tree;
+    std::set<int> keys;
+    check(tree, keys, -3, 3);
+
+    tree.insert(0, 0);
+    keys.insert(0);
+    check(tree, keys, -3, 3);
+
+    std::mt19937 rng(43);
+    for(int i = 0; i < 1000; i++)
+    {
+        const int key = (int)(rng() % 4000) * 2 - 4000;
+        tree.insert(key, key);
+        keys.insert(key);
+    }
+    for(int i = 0; i < 300; i++)
+    {
+        const int key = (int)(rng() % 4000) * 2 - 4000;
+        tree.remove(key);
+        keys.erase(key);
+    }
+    check(tree, keys, *keys.begin() - 3, *keys.rbegin() + 3);
+
+    // The non-const overloads find the same entries and can write through.
+    const int smallest = *keys.begin();
+    const int largest = *keys.rbegin();
+    CHECK(tree.floor(smallest - 1) == tree.end() && tree.predecessor(smallest) == tree.end());
+    CHECK(tree.ceiling(largest + 1) == tree.end() && tree.successor(largest) == tree.end());
+    tree.floor(largest + 100)->second = 7;
+    tree.ceiling(smallest - 100)->second = 8;
+    CHECK(*tree.find(largest) == 7 && *tree.find(smallest) == 8);
+    CHECK(tree.equal_range(smallest).first == tree.begin());
+    CHECK(tree.equal_range(largest + 1).first == tree.end() && tree.equal_range(largest + 1).second == tree.end());
+}
+
+/**
+ * \brief       Checks rank, select and count(lo, hi) against the sorted
+ *          keys after random inserts and removes, split and join, and
+ *          applyBatch on both its small and its rebuild path.
+ */
+static void testOrderStatistics()
+{
+    using Tree = RedBlackTree<int, int, DefaultCompare<int>, true>;
+
+    std::mt19937 rng(29);
+    auto check = [&rng](const Tree& tree, const std::set<int>& keys) {
+        const std::vector<int> sorted(keys.begin(), keys.end());
+        CHECK(tree.isValid() && tree.getTotalSize() == sorted.size());
+        for(std::size_t k = 0; k < sorted.size(); k += 1 + sorted.size() / 500)
+        {
+            auto at = tree.select(k);
+            CHECK(at != tree.cend() && at->first == sorted[k]);
+            CHECK(tree.rank(sorted[k]) == k);
+        }
+        CHECK(tree.select(sorted.size()) == tree.cend());
+        CHECK(tree.select(sorted.size() + 1000) == tree.cend());
+        for(int i = 0; i < 200; i++)
+        {
+            const int lo = (int)(rng() % 24000) - 2000;
+            const int hi = lo + (int)(rng() % 6000) - 500;
+            const auto below = std::lower_bound(sorted.begin(), sorted.end(), lo);
+            CHECK(tree.rank(lo) == (unsigned long long)(below - sorted.begin()));
+            const auto above = std::upper_bound(sorted.begin(), sorted.end(), hi);
+            CHECK(tree.count(lo, hi) == (unsigned long long)(lo <= hi ? above - below : 0));
+        }
+    };
+
+    Tree tree;
+    std::set<int> keys;
+    check(tree, keys);
+    for(int round = 0; round < 4; round++)
+    {
+        for(int i = 0; i < 3000; i++)
+        {
+            const int key = (int)(rng() % 20000);
+            CHECK(tree.insert(key, key) == keys.insert(key).second);
+        }
+        for(int i = 0; i < 1500; i++)
+        {
+            const int key = (int)(rng() % 20000);
+            CHECK(tree.remove(key) == (keys.erase(key) == 1));
+        }
+        check(tree, keys);
+    }
+
+    for(int at : {-1, 0, 5000, 12345, 19999, 20000})
+    {
+        Tree upper = tree.split(at);
+        check(tree, std::set<int>(keys.begin(), keys.lower_bound(at)));
+        check(upper, std::set<int>(keys.lower_bound(at), keys.end()));
+        CHECK(tree.join(std::move(upper)));
+        check(tree, keys);
+    }
+
+    // Small batches go through single descents, bigger ones are sorted
+    // first and ones as big as the tree rebuild it.
+    for(std::size_t size : {50, 2000, 20000})
+    {
+        std::vector<Tree::BatchOperation> operations;
+        std::vector<bool> expected;
+        for(std::size_t i = 0; i < size; i++)
+        {
+            const int key = (int)(rng() % 20000);
+            if(rng() % 2 == 0)
+            {
+                operations.push_back({BatchOpType::insert, key, key});
+                expected.push_back(keys.insert(key).second);
+            }
+            else
+            {
+                operations.push_back({BatchOpType::remove, key, 0});
+                expected.push_back(keys.erase(key) == 1);
+            }
+        }
+        CHECK(tree.applyBatch(std::move(operations)) == expected);
+        check(tree, keys);
+    }
+}
+
+/**
+ * \brief       Checks aggregate, aggregate(lo, hi), findOverlap and
+ *          overlaps against brute force over a std::map, after random
+ *          inserts, removes and updates, split and join, and bulk builds.
+ *          isValid recomputes every node's summary from its children.
+ */
+static void testAugmentSummaries()
+{
+    using SumTree = RedBlackTree<int, long long, DefaultCompare<int>, false, SumAugment<long long>>;
+    using MinTree = RedBlackTree<int, int, DefaultCompare<int>, true, MinAugment<int>>;
+    using IntervalTree = RedBlackTree<int, int, DefaultCompare<int>, false, IntervalAugment<int>>;
+
+    std::mt19937 rng(23);
+    auto sumOf = [](const std::map<int, long long>& expected, int lo, int hi) {
+        long long sum = 0;
+        for(auto at = expected.lower_bound(lo); at != expected.end() && at->first <= hi; ++at)
+            sum += at->second;
+        return sum;
+    };
+    auto minOf = [](const std::map<int, int>& expected, int lo, int hi) {
+        int least = std::numeric_limits<int>::max();
+        for(auto at = expected.lower_bound(lo); at != expected.end() && at->first <= hi; ++at)
+            least = std::min(least, at->second);
+        return least;
+    };
+    auto checkSums = [&](const SumTree& tree, const std::map<int, long long>& expected) {
+        CHECK(tree.isValid() && tree.getTotalSize() == expected.size());
+        CHECK(tree.aggregate() == sumOf(expected, std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+        for(int i = 0; i < 200; i++)
+        {
+            const int lo = (int)(rng() % 24000) - 2000;
+            const int hi = lo + (int)(rng() % 6000) - 500;
+            CHECK(tree.aggregate(lo, hi) == sumOf(expected, lo, hi));
+        }
+    };
+    auto checkMins = [&](const MinTree& tree, const std::map<int, int>& expected) {
+        CHECK(tree.isValid() && tree.getTotalSize() == expected.size());
+        CHECK(tree.aggregate() == minOf(expected, std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+        for(int i = 0; i < 200; i++)
+        {
+            const int lo = (int)(rng() % 24000) - 2000;
+            const int hi = lo + (int)(rng() % 6000) - 500;
+            CHECK(tree.aggregate(lo, hi) == minOf(expected, lo, hi));
+        }
+    };
+    auto checkIntervals = [&](const IntervalTree& tree, const std::map<int, int>& expected) {
+        CHECK(tree.isValid() && tree.getTotalSize() == expected.size());
+        for(int i = 0; i < 200; i++)
+        {
+            const int lo = (int)(rng() % 24000) - 2000;
+            const int hi = lo + (int)(rng() % 300);
+            std::vector<std::pair<int, int>> overlapping;
+            for(const auto& [start, end] : expected)
+                if(start <= hi && end >= lo)
+                    overlapping.emplace_back(start, end);
+
+            auto found = tree.findOverlap(lo, hi);
+            if(overlapping.empty())
+                CHECK(found == tree.cend());
+            else
+                CHECK(found != tree.cend() && found->first <= hi && found->second >= lo);
+
+            std::vector<std::pair<int, int>> visited;
+            CHECK(tree.overlaps(lo, hi, [&visited](int start, int end) {visited.emplace_back(start, end);}) == overlapping.size());
+            CHECK(visited == overlapping);
+        }
+    };
+
+    SumTree sums;
+    MinTree mins;
+    IntervalTree intervals;
+    std::map<int, long long> expectedSums;
+    std::map<int, int> expectedMins;
+    std::map<int, int> expectedIntervals;
+    checkSums(sums, expectedSums);
+    checkMins(mins, expectedMins);
+    checkIntervals(intervals, expectedIntervals);
+
+    for(int round = 0; round < 4; round++)
+    {
+        for(int i = 0; i < 3000; i++)
+        {
+            const int key = (int)(rng() % 20000);
+            const int value = (int)(rng() % 2001) - 1000;
+            CHECK(sums.insert(key, value) == expectedSums.emplace(key, value).second);
+            CHECK(mins.emplace(key, value) == expectedMins.emplace(key, value).second);
+            const int end = key + (int)(rng() % 400);
+            CHECK(intervals.insert(key, end) == expectedIntervals.emplace(key, end).second);
+        }
+        for(int i = 0; i < 1500; i++)
+        {
+            const int key = (int)(rng() % 20000);
+            CHECK(sums.remove(key) == (expectedSums.erase(key) == 1));
+            CHECK(mins.remove(key) == (expectedMins.erase(key) == 1));
+            CHECK(intervals.remove(key) == (expectedIntervals.erase(key) == 1));
+        }
+        for(int i = 0; i < 500; i++)
+        {
+            const int key = (int)(rng() % 20000);
+            const int value = (int)(rng() % 2001) - 1000;
+            auto expected = expectedSums.find(key);
+            CHECK(sums.update(key, [value](long long& data) {data = value;}) == (expected != expectedSums.end()));
+            if(expected != expectedSums.end())
+                expected->second = value;
+        }
+        checkSums(sums, expectedSums);
+        checkMins(mins, expectedMins);
+        checkIntervals(intervals, expectedIntervals);
+    }
+
+    // Split and join back at keys inside, below and above the range.
+    for(int at : {-1, 0, 5000, 12345, 19999, 20000})
+    {
+        SumTree upperSums = sums.split(at);
+        MinTree upperMins = mins.split(at);
+        IntervalTree upperIntervals = intervals.split(at);
+        checkSums(sums, std::map<int, long long>(expectedSums.begin(), expectedSums.lower_bound(at)));
+        checkSums(upperSums, std::map<int, long long>(expectedSums.lower_bound(at), expectedSums.end()));
+        checkMins(mins, std::map<int, int>(expectedMins.begin(), expectedMins.lower_bound(at)));
+        checkMins(upperMins, std::map<int, int>(expectedMins.lower_bound(at), expectedMins.end()));
+        checkIntervals(intervals, std::map<int, int>(expectedIntervals.begin(), expectedIntervals.lower_bound(at)));
+        checkIntervals(upperIntervals, std::map<int, int>(expectedIntervals.lower_bound(at), expectedIntervals.end()));
+
+        CHECK(sums.join(std::move(upperSums)));
+        CHECK(mins.join(std::move(upperMins)));
+        CHECK(intervals.join(std::move(upperIntervals)));
+        checkSums(sums, expectedSums);
+        checkMins(mins, expectedMins);
+        checkIntervals(intervals, expectedIntervals);
+    }
+
+    // Joining around a middle entry, then bulk builds.
+    SumTree upperSums = sums.split(10000);
+    expectedSums.erase(10000);
+    expectedSums.emplace(10000, 777);
+    upperSums.remove(10000);
+    CHECK(sums.join(10000, 777, std::move(upperSums)));
+    checkSums(sums, expectedSums);
+
+    sums.assignSorted(expectedSums.begin(), expectedSums.end());
+    checkSums(sums, expectedSums);
+    mins.assignSorted(expectedMins.begin(), expectedMins.end());
+    checkMins(mins, expectedMins);
+    intervals.assignSorted(expectedIntervals.begin(), expectedIntervals.end());
+    checkIntervals(intervals, expectedIntervals);
+
+    std::vector<std::pair<int, int>> shuffled(expectedIntervals.begin(), expectedIntervals.end());
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+    intervals.assign(shuffled.begin(), shuffled.end());
+    checkIntervals(intervals, expectedIntervals);
+
+    // A write that skips update leaves the summaries above it stale.
+    sums.at(expectedSums.begin()->first) += 1;
+    CHECK(!sums.isValid());
+}
+
+/**
+ * \brief       Builds trees with assignSorted, assign and parallel_assign
+ *          and checks they are valid red black trees. Building over and over
+ *          has to give the old nodes' memory back instead of piling up
+ *          chunks, and so does clear.
+ */
+static void testAssignSorted()
+{
+    for(std::size_t count : {0, 1, 2, 3, 7, 8, 100, 1000})
+    {
+        std::vector<std::pair<int, int>> entries;
+        for(std::size_t i = 0; i < count; i++)
+            entries.emplace_back((int)i * 2, (int)i);
+
+        RedBlackTree<int, int, DefaultCompare<int>, true> tree;
+        tree.insert(-1, -1);
+        tree.assignSorted(entries.begin(), entries.end());
+        CHECK(tree.isValid());
+        CHECK(tree.getTotalSize() == count);
+        CHECK(std::equal(tree.begin(), tree.end(), entries.begin(), entries.end(),
+                         [](const auto& entry, const auto& expected) {return entry.first == expected.first && entry.second == expected.second;}));
+    }
+
+    std::vector<std::pair<int, int>> entries;
+    for(int i = 0; i < 100000; i++)
+        entries.emplace_back(i, i);
+
+    RedBlackTree<int, int> tree;
+    tree.assignSorted(entries.begin(), entries.end());
+    const std::size_t reserved = tree.getReservedBytes();
+    CHECK(reserved > 0);
+    for(int round = 0; round < 10; round++)
+    {
+        tree.assignSorted(entries.begin(), entries.end());
+        CHECK(tree.getReservedBytes() == reserved);
+    }
+
+    std::vector<std::pair<int, int>> shuffled = entries;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(3));
+    ThreadPool pool(4);
+    for(int round = 0; round < 5; round++)
+    {
+        tree.assign(shuffled.begin(), shuffled.end());
+        CHECK(tree.getReservedBytes() == reserved);
+        tree.parallel_assign(shuffled.begin(), shuffled.end(), pool);
+        CHECK(tree.getReservedBytes() == reserved);
+    }
+    CHECK(tree.isValid());
+
+    // The rebuild path of a batch as big as the tree.
+    std::vector<RedBlackTree<int, int>::BatchOperation> operations;
+    for(int i = 0; i < 100000; i++)
+        operations.push_back({BatchOpType::remove, i, 0});
+    tree.applyBatch(std::move(operations));
+    CHECK(tree.getTotalSize() == 0);
+    CHECK(tree.getReservedBytes() == 0);
+
+    tree.assignSorted(entries.begin(), entries.end());
+    tree.clear();
+    CHECK(tree.getReservedBytes() == 0);
+    CHECK(tree.insert(1, 1) && tree.isValid());
+
+    // After a split, the old nodes' chunks go once neither half uses them.
+    tree.assignSorted(entries.begin(), entries.end());
+    RedBlackTree<int, int> upper = tree.split(50000);
+    tree.assignSorted(entries.begin(), entries.begin() + 25000);
+    CHECK(tree.isValid() && upper.isValid());
+    CHECK(tree.getTotalSize() == 25000 && upper.getTotalSize() == 50000);
+    CHECK(std::equal(upper.begin(), upper.end(), entries.begin() + 50000, entries.end(), [](const auto& entry, const auto& expected) {return entry.first == expected.first && entry.second == expected.second;}));
+    upper = RedBlackTree<int, int>();
+    for(int i = 0; i < 1000; i++)
+        CHECK(tree.insert(200000 + i, i));
+    RedBlackTree<int, int> fresh;
+    fresh.assignSorted(entries.begin(), entries.begin() + 26000);
+    CHECK(tree.getReservedBytes() <= 2 * fresh.getReservedBytes());
+}
+
+/**
+ * \brief       Data whose copy and move constructors throw once a countdown
+ *          runs out, to fail an operation part way through.
+ */
+struct ThrowingData
+{
+    static inline int copiesLeft = -1;
+
+    int value = 0;
+
+    ThrowingData(int value) : value(value) {}
+    ThrowingData(const ThrowingData& other) : value(other.value) {countDown();}
+    ThrowingData(ThrowingData&& other) : value(other.value) {countDown();}
+    ThrowingData& operator=(const ThrowingData&) = default;
+
+    static void countDown()
+    {
+        if(copiesLeft == 0)
+            throw std::runtime_error("copy failed");
+        if(copiesLeft > 0)
+            copiesLeft--;
+    }
+};
+
+/**
+ * \brief       Comparator that throws once a countdown runs out.
+ */
+struct ThrowingLess
+{
+    static inline int comparesLeft = -1;
+
+    bool operator()(const std::string& a, const std::string& b) const
+    {
+        if(comparesLeft == 0)
+            throw std::runtime_error("compare failed");
+        if(comparesLeft > 0)
+            comparesLeft--;
+        return a < b;
+    }
+};
+
+/**
+ * \brief       Runs mixed batches small, medium and as big as the tree, so
+ *          each of applyBatch's three paths is taken, and checks the
+ *          results, contents and red black rules against std::set.
+ */
+static void testApplyBatch()
+{
+    using Tree = RedBlackTree<int, int, DefaultCompare<int>, true>;
+    std::mt19937 rng(29);
+
+    for(std::size_t batchSize : {10, 2000, 50000})
+    {
+        Tree tree;
+        std::set<int> keys;
+        for(int i = 0; i < 20000; i++)
+        {
+            const int key = (int)(rng() % 40000);
+            tree.insert(key, key);
+            keys.insert(key);
+        }
+
+        std::vector<Tree::BatchOperation> operations;
+        std::vector<bool> expected;
+        for(std::size_t i = 0; i < batchSize; i++)
+        {
+            const int key = (int)(rng() % 40000);
+            if(rng() % 2 == 0)
+            {
+                operations.push_back({BatchOpType::insert, key, key});
+                expected.push_back(keys.insert(key).second);
+            }
+            else
+            {
+                operations.push_back({BatchOpType::remove, key, 0});
+                expected.push_back(keys.erase(key) == 1);
+            }
+        }
+
+        CHECK(tree.applyBatch(std::move(operations)) == expected);
+        CHECK(tree.isValid() && tree.getTotalSize() == keys.size());
+        CHECK(std::equal(tree.begin(), tree.end(), keys.begin(), keys.end(), [](const auto& entry, int key) {return entry.first == key && entry.second == key;}));
+    }
+}
+
+/**
+ * \brief       Fails a batch as big as the tree at every copy or move in
+ *          turn, then at every comparison. The merge path builds the result
+ *          next to the old nodes, so whatever throws the tree has to stay
+ *          exactly as it was.
+ */
+static void testApplyBatchThrowing()
+{
+    using Tree = RedBlackTree<std::string, ThrowingData, ThrowingLess>;
+
+    auto fill = [](Tree& tree, std::vector<Tree::BatchOperation>& operations) {
+        for(int i = 0; i < 10; i++)
+        {
+            tree.insert("key" + std::to_string(100 + i), ThrowingData(i));
+            operations.push_back({BatchOpType::insert, "key" + std::to_string(200 + i), ThrowingData(i)});
+        }
+        operations.push_back({BatchOpType::remove, "key100", ThrowingData(0)});
+    };
+    auto unchanged = [](const Tree& tree) {
+        int i = 0;
+        for(const auto& [key, data] : tree)
+        {
+            if(key != "key" + std::to_string(100 + i) || data.value != i)
+                return false;
+            i++;
+        }
+        return i == 10 && tree.getTotalSize() == 10 && tree.isValid();
+    };
+
+    for(int* countdown : {&ThrowingData::copiesLeft, &ThrowingLess::comparesLeft})
+    {
+        for(int failAt = 0; ; failAt++)
+        {
+            Tree tree;
+            std::vector<Tree::BatchOperation> operations;
+            fill(tree, operations);
+
+            *countdown = failAt;
+            bool threw = false;
+            try {
+                tree.applyBatch(std::move(operations));
+            }
+            catch(const std::runtime_error&) {
+                threw = true;
+            }
+            *countdown = -1;
+
+            if(!threw)
+            {
+                CHECK(tree.getTotalSize() == 19 && tree.isValid());
+                CHECK(!tree.contains("key100") && tree.contains("key101") && tree.contains("key209"));
+                break;
+            }
+
+            CHECK(unchanged(tree));
+            CHECK(tree.insert("key300", ThrowingData(1)) && tree.contains("key300"));
+        }
+    }
+}
+
+/**
+ * \brief       Checks sizes stay right through split, join and the set
+ *          operations, and that a tree whose size is unknown after a split
+ *          can be asked for it from several threads at once (run it under
+ *          -fsanitize=thread to see races).
+ */
+static void testSizeAfterSplit()
+{
+    RedBlackTree<int, int> tree;
+    for(int i = 0; i < 10000; i++)
+        tree.insert(i, i);
+
+    RedBlackTree<int, int> upper = tree.split(4000);
+    const RedBlackTree<int, int>& lower = tree;
+
+    std::vector<unsigned long long> sizes(4, 0);
+    std::vector<std::thread> threads;
+    for(std::size_t t = 0; t < sizes.size(); t++)
+        threads.emplace_back([&lower, &sizes, t] {sizes[t] = lower.getTotalSize();});
+    for(std::thread& thread : threads)
+        thread.join();
+
+    for(unsigned long long size : sizes)
+        CHECK(size == 4000);
+    CHECK(upper.getTotalSize() == 6000);
+
+    // Sizes carry on from a count, and from a split that is not counted yet.
+    tree.insert(-1, -1);
+    CHECK(tree.getTotalSize() == 4001);
+    RedBlackTree<int, int> top = upper.split(9000);
+    upper.remove(5000);
+    CHECK(upper.join(std::move(top)));
+    CHECK(upper.getTotalSize() == 5999);
+    CHECK(top.getTotalSize() == 0);
+
+    RedBlackTree<int, int> evens;
+    for(int i = 0; i < 12000; i += 2)
+        evens.insert(i, i);
+    upper.subtract(std::move(evens));
+    CHECK(upper.getTotalSize() == 3000);
+    CHECK((unsigned long long)std::distance(upper.begin(), upper.end()) == 3000);
+
+    // A batch on a tree of unknown size still gives the right results.
+    RedBlackTree<int, int> rest = upper.split(7001);
+    std::vector<RedBlackTree<int, int>::BatchOperation> operations;
+    for(int i = 4001; i < 4101; i++)
+        operations.push_back({BatchOpType::remove, i, 0});
+    auto results = upper.applyBatch(std::move(operations));
+    CHECK(std::count(results.begin(), results.end(), true) == 50);
+    CHECK(upper.getTotalSize() == 1450);
+    CHECK(rest.getTotalSize() == 1500);
+}
+
+/**
+ * \brief       Splits random trees at every kind of key and joins them back,
+ *          checking both halves stay valid red black trees with the right
+ *          entries. Dropping either half gives back the chunks only it
+ *          used.
+ */
+static void testSplitJoin()
+{
+    std::mt19937 rng(11);
+    std::set<int> keys;
+    while(keys.size() < 5000)
+        keys.insert((int)(rng() % 20000));
+
+    for(int at : {-1, 0, 1, 7000, 9999, 10000, 19999, 20000})
+    {
+        RedBlackTree<int, int, DefaultCompare<int>, true> tree;
+        for(int key : keys)
+            tree.insert(key, key);
+
+        auto upper = tree.split(at);
+        CHECK(tree.isValid() && upper.isValid());
+        CHECK(tree.getTotalSize() == (unsigned long long)std::distance(keys.begin(), keys.lower_bound(at)));
+        CHECK(tree.begin() == tree.end() || std::prev(tree.end())->first < at);
+        CHECK(upper.begin() == upper.end() || upper.begin()->first >= at);
+
+        CHECK(tree.join(std::move(upper)));
+        CHECK(tree.isValid() && upper.isValid());
+        CHECK(tree.getTotalSize() == keys.size());
+        CHECK(std::equal(tree.begin(), tree.end(), keys.begin(), keys.end(), [](const auto& entry, int key) {return entry.first == key;}));
+    }
+
+    RedBlackTree<int, int> lower;
+    RedBlackTree<int, int> upper;
+    CHECK(lower.join(-1, -1, std::move(upper)) && lower.isValid() && lower.getTotalSize() == 1);
+    for(int key : keys)
+        upper.insert(key, key);
+    CHECK(lower.join(std::move(upper)));
+    CHECK(lower.getTotalSize() == keys.size() + 1 && lower.isValid());
+
+    // Archive the upper half: the lower one gives back the chunks only the
+    // archived nodes used on its next allocations.
+    RedBlackTree<int, int> archive;
+    for(int i = 0; i < 100000; i++)
+        archive.insert(i, i);
+    const std::size_t whole = archive.getReservedBytes();
+    {
+        RedBlackTree<int, int> archived = archive.split(50000);
+        CHECK(archived.getReservedBytes() == 0 && archived.getTotalSize() == 50000);
+    }
+    for(int i = 0; i < 1000; i++)
+        CHECK(archive.insert(-1 - i, i));
+    CHECK(archive.getReservedBytes() < whole * 2 / 3);
+    CHECK(archive.isValid() && archive.getTotalSize() == 51000);
+
+    // Archive the lower half: the upper one keeps its nodes in chunks of
+    // the dropped pool, which go once the last of them is removed.
+    RedBlackTree<int, int> live = archive.split(25000);
+    archive = RedBlackTree<int, int>();
+    CHECK(live.getReservedBytes() == 0);
+    CHECK(live.isValid() && live.getTotalSize() == 25000);
+    CHECK(live.begin()->first == 25000 && std::prev(live.end())->first == 49999);
+    for(int i = 25000; i < 50000; i += 2)
+        CHECK(live.remove(i));
+    for(int i = 0; i < 1000; i++)
+        CHECK(live.insert(i, i));
+    CHECK(live.isValid() && live.getTotalSize() == 13500);
+    live.clear();
+    CHECK(live.getReservedBytes() == 0);
+}
+
+/**
+ * \brief       Runs union, intersection and difference of trees big enough to
+ *          be split into tasks on a four thread pool, checked against
+ *          std::set_*.
+ */
+static void testSetOperations()
+{
+    ThreadPool pool(4);
+    std::mt19937 rng(5);
+    auto randomKeys = [&rng](std::size_t count) {
+        std::set<int> keys;
+        while(keys.size() < count)
+            keys.insert((int)(rng() % 1000000));
+        return keys;
+    };
+    auto build = [](const std::set<int>& keys) {
+        RedBlackTree<int, int> tree;
+        for(int key : keys)
+            tree.insert(key, key);
+        return tree;
+    };
+    auto matches = [](const RedBlackTree<int, int>& tree, const std::set<int>& keys) {
+        return tree.getTotalSize() == keys.size() && std::equal(tree.begin(), tree.end(), keys.begin(), keys.end(),
+                                                                 [](const auto& entry, int key) {return entry.first == key;});
+    };
+
+    const std::set<int> aKeys = randomKeys(200000);
+    const std::set<int> bKeys = randomKeys(150000);
+    std::set<int> expected;
+
+    RedBlackTree<int, int> a = build(aKeys);
+    a.unionWith(build(bKeys), pool);
+    std::set_union(aKeys.begin(), aKeys.end(), bKeys.begin(), bKeys.end(), std::inserter(expected, expected.end()));
+    CHECK(matches(a, expected));
+
+    expected.clear();
+    a = build(aKeys);
+    a.intersectWith(build(bKeys), pool);
+    std::set_intersection(aKeys.begin(), aKeys.end(), bKeys.begin(), bKeys.end(), std::inserter(expected, expected.end()));
+    CHECK(matches(a, expected));
+
+    expected.clear();
+    a = build(aKeys);
+    a.subtract(build(bKeys), pool);
+    std::set_difference(aKeys.begin(), aKeys.end(), bKeys.begin(), bKeys.end(), std::inserter(expected, expected.end()));
+    CHECK(matches(a, expected));
+}
+
+/**
+ * \brief       Leaves a TaskGroup by an exception while its tasks still use
+ *          the stack frame. The destructor has to wait for them.
+ */
+static void testTaskGroupUnwinding()
+{
+    ThreadPool pool(4);
+    std::atomic<int> finished{0};
+
+    for(int round = 0; round < 50; round++)
+    {
+        try {
+            std::vector<int> values(64, 1);
+            ThreadPool::TaskGroup group(pool);
+            for(std::size_t i = 0; i < values.size(); i++)
+            {
+                if(i == 32)
+                    throw std::runtime_error("queueing failed");
+
+                group.run([&values, &finished, i] {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    values[i]++;
+                    finished++;
+                });
+            }
+            group.wait();
+        }
+        catch(const std::runtime_error&) {
+        }
+    }
+    CHECK(finished == 50 * 32);
+
+    // A failing task is reported by wait, once, and the group is reusable.
+    ThreadPool::TaskGroup group(pool);
+    group.run([] {throw std::runtime_error("task failed");});
+    group.run([] {});
+    bool threw = false;
+    try {
+        group.wait();
+    }
+    catch(const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    group.run([&finished] {finished++;});
+    group.wait();
+    CHECK(finished == 50 * 32 + 1);
+}
+
+/**
+ * \brief       Fills trees with append and hinted inserts in order, in
+ *          reverse, and at random with the hint in the wrong place. Each has
+ *          to stay a valid red black tree, with sizes and summaries kept
+ *          right, holding exactly the keys inserted.
+ */
+static void testHintedInsert()
+{
+    using Tree = RedBlackTree<int, long long, DefaultCompare<int>, true, SumAugment<long long>>;
+    auto matches = [](const Tree& tree, const std::set<int>& keys) {
+        long long sum = 0;
+        for(int key : keys)
+            sum += key;
+        return tree.isValid() && tree.getTotalSize() == keys.size() && tree.aggregate() == sum
+               && std::equal(tree.begin(), tree.end(), keys.begin(), keys.end(), [](const auto& entry, int key) {return entry.first == key;});
+    };
+
+    Tree tree;
+    std::set<int> keys;
+    for(int key = 0; key < 20000; key += 2)
+    {
+        CHECK(tree.append(key, key));
+        keys.insert(key);
+    }
+    CHECK(!tree.append(100, 100));
+    CHECK(matches(tree, keys));
+
+    // Out of place: below everything, so append falls back to a descent.
+    for(int key = -1; key > -2000; key--)
+    {
+        CHECK(tree.append(key, key));
+        keys.insert(key);
+    }
+    CHECK(matches(tree, keys));
+
+    // Filling the gaps from the top down, each hint right above the key.
+    auto hint = tree.end();
+    for(int key = 19999; key > 0; key -= 2)
+    {
+        hint = tree.insert(hint, key, key);
+        CHECK(hint != tree.end() && hint->first == key);
+        keys.insert(key);
+    }
+    CHECK(matches(tree, keys));
+
+    // Random keys with hints that are mostly wrong.
+    std::mt19937 rng(17);
+    for(int i = 0; i < 20000; i++)
+    {
+        const int key = (int)(rng() % 100000) - 50000;
+        auto at = tree.insert(tree.lower_bound((int)(rng() % 100000) - 50000), key, key);
+        CHECK(at != tree.end() && at->first == key);
+        keys.insert(key);
+    }
+    CHECK(matches(tree, keys));
+
+    RedBlackTree<int, int> plain;
+    for(int key = 0; key < 100000; key++)
+        plain.append(key, key);
+    CHECK(plain.isValid() && plain.getTotalSize() == 100000);
+}
+
+/**
+ * \brief       Key that counts its live copies, to see what a container
+ *          keeps besides its entries.
+ */
+struct CountedKey
+{
+    static inline std::atomic<long long> live{0};
+
+    long long value;
+
+    CountedKey(long long value) : value(value) {live++;}
+    CountedKey(const CountedKey& other) : value(other.value) {live++;}
+    CountedKey& operator=(const CountedKey&) = default;
+    ~CountedKey() {live--;}
+
+    auto operator<=>(const CountedKey& other) const {return this->value <=> other.value;}
+    bool operator==(const CountedKey& other) const {return this->value == other.value;}
+};
+
+/**
+ * \brief       Slides a window of increasing keys through a sharded tree, the
+ *          timestamp case, which rebalances over and over. The routing tables
+ *          it replaces have to be freed, so the keys alive stay at the
+ *          window plus one boundary per shard. Node memory has to stay
+ *          bounded too: chunks the old keys emptied go back, whichever
+ *          shard a split left them with.
+ */
+static void testShardedRoutingReclaimed()
+{
+    const long long window = 20000;
+    const unsigned shards = 16;
+    {
+        ShardedRedBlackTree<CountedKey, int> tree(shards, 1024);
+        std::size_t settled = 0;
+        std::size_t most = 0;
+        for(long long key = 0; key < 20 * window; key++)
+        {
+            tree.insert(key, 0);
+            if(key >= window)
+                tree.remove(key - window);
+
+            if(key == 2 * window)
+                settled = tree.getReservedBytes();
+            else if(key > 2 * window && key % 1000 == 0)
+                most = std::max(most, tree.getReservedBytes());
+        }
+
+        CHECK(tree.getTotalSize() == (unsigned long long)window);
+        CHECK(settled > 0 && most <= 2 * settled);
+        CHECK(CountedKey::live <= window + (long long)shards);
+    }
+    CHECK(CountedKey::live == 0);
+}
+
+/**
+ * \brief       Grows a sharded tree from random keys and shrinks it again,
+ *          checking the shard count follows the size and every entry stays
+ *          reachable through the routing.
+ */
+static void testShardedRebalance()
+{
+    ShardedRedBlackTree<int, int> tree(16, 1024);
+    std::map<int, int> expected;
+    std::mt19937 rng(29);
+    for(int i = 0; i < 100000; i++)
+    {
+        const int key = (int)(rng() % 1000000);
+        CHECK(tree.insert(key, i) == expected.emplace(key, i).second);
+    }
+    CHECK(tree.getShardCount() >= 8);
+
+    auto matches = [&tree, &expected] {
+        std::vector<std::pair<const int, int>> contents;
+        tree.forEach([&contents](const int& key, const int& data) {contents.emplace_back(key, data);});
+        return tree.getTotalSize() == expected.size() && std::equal(contents.begin(), contents.end(), expected.begin(), expected.end());
+    };
+    CHECK(matches());
+
+    for(auto entry = expected.begin(); entry != expected.end();)
+    {
+        if(rng() % 20 != 0)
+        {
+            CHECK(tree.remove(entry->first));
+            entry = expected.erase(entry);
+        }
+        else
+            entry++;
+    }
+    tree.rebalance();
+    CHECK(tree.getShardCount() <= std::max<std::size_t>(expected.size() / 1024, 1));
+    CHECK(matches());
+    for(const auto& [key, data] : expected)
+    {
+        int found = -1;
+        CHECK(tree.search(key, &found) && found == data);
+    }
+}
+
+/**
+ * \brief       Takes snapshots of a persistent tree while it changes and
+ *          checks each one keeps seeing exactly the entries it had, and
+ *          that changing a snapshot doesn't reach the tree it came from.
+ */
+static void testPersistentSnapshots()
+{
+    using Tree = PersistentRedBlackTree<int, int>;
+    auto matches = [](const Tree& tree, const std::map<int, int>& entries) {
+        return tree.getTotalSize() == entries.size()
+               && std::equal(tree.begin(), tree.end(), entries.begin(), entries.end(),
+                             [](const auto& entry, const auto& expected) {return entry.first == expected.first && entry.second == expected.second;});
+    };
+
+    Tree tree;
+    std::map<int, int> entries;
+    std::vector<std::pair<Tree, std::map<int, int>>> versions;
+    std::mt19937 rng(31);
+
+    for(int round = 0; round < 20; round++)
+    {
+        versions.emplace_back(tree.snapshot(), entries);
+        for(int i = 0; i < 500; i++)
+        {
+            const int key = (int)(rng() % 5000);
+            if(rng() % 3 == 0)
+                CHECK(tree.remove(key) == (entries.erase(key) == 1));
+            else
+                CHECK(tree.insert(key, round) == entries.emplace(key, round).second);
+        }
+    }
+
+    CHECK(matches(tree, entries));
+    for(const auto& [version, expected] : versions)
+    {
+        CHECK(matches(version, expected));
+
+        const int probe = (int)(rng() % 5000);
+        auto found = version.lower_bound(probe);
+        auto wanted = expected.lower_bound(probe);
+        CHECK((found == version.end()) == (wanted == expected.end()));
+        CHECK(found == version.end() || found->first == wanted->first);
+
+        int data = -1;
+        CHECK(version.search(probe, &data) == expected.contains(probe));
+        CHECK(!expected.contains(probe) || data == expected.at(probe));
+
+        auto first = expected.lower_bound(1000);
+        auto last = expected.upper_bound(2000);
+        CHECK(version.scan(1000, 2000, [](const int&, const int&) {}) == (unsigned long long)std::distance(first, last));
+    }
+
+    // A pointer into a version lives as long as that version.
+    Tree copy = versions.back().first;
+    const int kept = copy.begin()->first;
+    const int* data = copy.find(kept);
+    versions.clear();
+    CHECK(tree.remove(kept) == (entries.erase(kept) == 1));
+    CHECK(data != nullptr && *data == copy.begin()->second);
+
+    // Changing a snapshot leaves the tree it came from alone.
+    copy.insert(-1, -1);
+    copy.remove(kept);
+    CHECK(!tree.contains(-1) && copy.contains(-1) && !copy.contains(kept));
+    CHECK(matches(tree, entries));
+}
+
+/**
+ * \brief       Compares parallel_for_each, parallel_reduce with a combine
+ *          that isn't commutative and parallel_transform with a sequential
+ *          walk, on trees from empty to big enough to be cut into tasks on a
+ *          four thread pool. A throwing transform has to pass the exception
+ *          on and leave the tree as it was.
+ */
+static void testParallelTraversal()
+{
+    ThreadPool pool(4);
+    std::mt19937 rng(31);
+
+    // Polynomial hash of the keys in order: associative, not commutative.
+    using Hash = std::pair<std::uint64_t, std::uint64_t>;
+    auto map = [](int key, long long) {return Hash{(std::uint64_t)key + 1, 1000003};};
+    auto combine = [](Hash left, Hash right) {return Hash{left.first * right.second + right.first, left.second * right.second};};
+    auto same = [](const auto& entry, const auto& expected) {return entry.first == expected.first && entry.second == expected.second;};
+
+    for(std::size_t count : {0, 1, 100, 5000, 100000})
+    {
+        RedBlackTree<int, long long> tree;
+        std::map<int, long long> expected;
+        while(expected.size() < count)
+        {
+            const int key = (int)(rng() % (count * 4));
+            tree.insert(key, key);
+            expected.emplace(key, key);
+        }
+
+        Hash sequential{0, 1};
+        for(const auto& [key, data] : expected)
+            sequential = combine(sequential, map(key, data));
+        CHECK(tree.parallel_reduce(Hash{0, 1}, map, combine, pool) == sequential);
+
+        tree.parallel_for_each([](int key, long long& data) {data += key;}, pool);
+        std::atomic<long long> sum{0};
+        std::atomic<std::size_t> visited{0};
+        std::as_const(tree).parallel_for_each([&sum, &visited](int, const long long& data) {sum += data; visited++;}, pool);
+        long long expectedSum = 0;
+        for(auto& [key, data] : expected)
+        {
+            data += key;
+            expectedSum += data;
+        }
+        CHECK(visited == count && sum == expectedSum);
+        CHECK(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), same));
+
+        auto transformed = tree.parallel_transform([](int key, long long data) {return std::to_string(data - key);}, pool);
+        CHECK(transformed.isValid() && transformed.getTotalSize() == count);
+        CHECK(std::equal(transformed.begin(), transformed.end(), expected.begin(), expected.end(),
+                         [](const auto& entry, const auto& original) {return entry.first == original.first && entry.second == std::to_string(original.second - original.first);}));
+
+        if(count == 0)
+            continue;
+        const int throwAt = std::next(expected.begin(), (std::ptrdiff_t)(rng() % count))->first;
+        bool threw = false;
+        try {
+            tree.parallel_transform([throwAt](int key, long long data) {
+                if(key == throwAt)
+                    throw std::runtime_error("transform failed");
+                return std::to_string(data);
+            }, pool);
+        }
+        catch(const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        CHECK(tree.isValid() && std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), same));
+    }
+}
+
+/**
+ * \brief       Compares parallel_filter with a sequential filter on trees
+ *          from empty to big enough to be cut into tasks on a four thread
+ *          pool, and parallel_assign with duplicate keys against a map
+ *          keeping the first occurrence of each.
+ */
+static void testParallelFilterAssign()
+{
+    ThreadPool pool(4);
+    std::mt19937 rng(37);
+    auto same = [](const auto& entry, const auto& expected) {return entry.first == expected.first && entry.second == expected.second;};
+
+    for(std::size_t count : {0, 1, 100, 5000, 200000})
+    {
+        RedBlackTree<int, int, DefaultCompare<int>, true> tree;
+        std::map<int, int> entries;
+        while(entries.size() < count)
+        {
+            const int key = (int)(rng() % (count * 4));
+            const int data = (int)(rng() % 1000);
+            tree.insert(key, data);
+            entries.emplace(key, data);
+        }
+
+        for(int keepOneIn : {1, 2, 7, 1000})
+        {
+            auto keep = [keepOneIn](int key, int data) {return (key + data) % keepOneIn == 0;};
+            std::vector<std::pair<int, int>> expected;
+            for(const auto& [key, data] : entries)
+                if(keep(key, data))
+                    expected.emplace_back(key, data);
+
+            auto filtered = tree.parallel_filter(keep, pool);
+            CHECK(filtered.isValid() && filtered.getTotalSize() == expected.size());
+            CHECK(std::equal(filtered.begin(), filtered.end(), expected.begin(), expected.end(), same));
+        }
+        auto none = tree.parallel_filter([](int, int) {return false;}, pool);
+        CHECK(none.isValid() && none.getTotalSize() == 0);
+        CHECK(tree.isValid() && std::equal(tree.begin(), tree.end(), entries.begin(), entries.end(), same));
+    }
+
+    // Every key about three times, with data telling the copies apart.
+    for(std::size_t count : {0, 1, 2, 100, 30000, 300000})
+    {
+        std::vector<std::pair<int, int>> input;
+        std::map<int, int> firsts;
+        for(std::size_t i = 0; i < count; i++)
+        {
+            const int key = (int)(rng() % (count / 3 + 1));
+            input.emplace_back(key, (int)i);
+            firsts.emplace(key, (int)i);
+        }
+
+        RedBlackTree<int, int, DefaultCompare<int>, true> tree;
+        tree.insert(-1, -1);
+        tree.parallel_assign(input.begin(), input.end(), pool);
+        CHECK(tree.isValid() && tree.getTotalSize() == firsts.size());
+        CHECK(std::equal(tree.begin(), tree.end(), firsts.begin(), firsts.end(), same));
+
+        RedBlackTree<int, int, DefaultCompare<int>, true> sequential;
+        sequential.assign(input.begin(), input.end());
+        CHECK(std::equal(sequential.begin(), sequential.end(), firsts.begin(), firsts.end(), same));
+    }
+}
+
+/**
+ * \brief       Freezes trees of every size up to a few levels and checks
+ *          lookups, lower_bound, upper_bound, scan and iteration against
+ *          the tree they came from, for keys in it, between and beyond.
+ *          Runs with int keys (the branchless path) and strings.
+ */
+static void testFrozen()
+{
+    for(int count = 0; count < 130; count++)
+    {
+        RedBlackTree<int, int> tree;
+        for(int i = 0; i < count; i++)
+            tree.insert(i * 3, i);
+
+        FrozenRedBlackTree<int, int> frozen = tree.freeze();
+        CHECK(frozen.getTotalSize() == (unsigned long long)count);
+        CHECK(std::equal(frozen.begin(), frozen.end(), tree.begin(), tree.end(),
+                         [](const auto& a, const auto& b) {return a.first == b.first && a.second == b.second;}));
+
+        for(int key = -2; key <= count * 3 + 2; key++)
+        {
+            const int* data = frozen.find(key);
+            CHECK((data != nullptr) == tree.contains(key));
+            CHECK(data == nullptr || *data == key / 3);
+            CHECK(frozen.contains(key) == tree.contains(key));
+
+            auto lower = frozen.lower_bound(key);
+            auto expected = tree.lower_bound(key);
+            CHECK((lower == frozen.end()) == (expected == tree.end()));
+            CHECK(lower == frozen.end() || lower->first == expected->first);
+
+            auto upper = frozen.upper_bound(key);
+            expected = tree.upper_bound(key);
+            CHECK((upper == frozen.end()) == (expected == tree.end()));
+            CHECK(upper == frozen.end() || upper->first == expected->first);
+        }
+
+        CHECK(frozen.scan(10, 100, [](const int&, const int&) {}) == tree.scan(10, 100, [](const int&, int&) {}));
+    }
+
+    RedBlackTree<std::string, int> names;
+    for(int i = 0; i < 1000; i++)
+        names.insert("key" + std::to_string(i), i);
+    auto frozen = names.freeze();
+    CHECK(frozen.find(std::string("key500")) != nullptr && *frozen.find(std::string("key500")) == 500);
+    CHECK(!frozen.contains(std::string("key")));
+    CHECK(frozen.lower_bound(std::string("key4995"))->first == "key5");
+    CHECK(frozen.upper_bound(std::string("key999")) == frozen.end());
+}
+
+/**
+ * \brief       Looks up batches with hits, misses and repeats, on a tree
+ *          small enough to be searched key by key and one big enough for
+ *          the interleaved descents, and checks every pointer is the one
+ *          find returns.
+ */
+static void testSearchBatch()
+{
+    std::mt19937 rng(37);
+    for(int count : {1000, 400000})
+    {
+        RedBlackTree<int, int> tree;
+        std::vector<std::pair<int, int>> entries;
+        for(int i = 0; i < count; i++)
+            entries.emplace_back(i * 2, i);
+        tree.assignSorted(entries.begin(), entries.end());
+
+        std::vector<int> keys;
+        for(int i = 0; i < 10007; i++)
+            keys.push_back((int)(rng() % (4 * count)) - count);
+        keys.push_back(keys.front());
+
+        std::vector<const int*> out(3, nullptr);
+        const std::size_t found = tree.searchBatch(keys, out);
+        CHECK(out.size() == keys.size());
+
+        std::size_t expected = 0;
+        bool same = true;
+        for(std::size_t i = 0; i < keys.size(); i++)
+        {
+            const int* data = std::as_const(tree).find(keys[i]);
+            same = same && out[i] == data;
+            expected += data != nullptr ? 1 : 0;
+        }
+        CHECK(same);
+        CHECK(found == expected && found > 0 && found < keys.size());
+
+        CHECK(tree.searchBatch({}, out) == 0 && out.empty());
+    }
+}
+
+/**
+ * \brief       Saves a tree and loads it back, into an empty and into a
+ *          full tree. Loading a damaged file, one of another version or
+ *          one cut short has to fail and leave the tree and its memory as
+ *          they were.
+ */
+static void testSaveLoad()
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "redBlackTreeTest.rbts";
+    auto patch = [&path](std::streamoff offset, const void* bytes, std::size_t count) {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(offset);
+        file.write(static_cast<const char*>(bytes), (std::streamsize)count);
+    };
+
+    RedBlackTree<int, double> tree;
+    std::mt19937 rng(23);
+    for(int i = 0; i < 100000; i++)
+        tree.insert((int)(rng() % 1000000), i * 0.5);
+    CHECK(tree.save(path.string()));
+
+    RedBlackTree<int, double> loaded;
+    loaded.insert(-5, 1.0);
+    CHECK(loaded.load(path.string()));
+    CHECK(loaded.isValid() && loaded.getTotalSize() == tree.getTotalSize());
+    CHECK(std::equal(tree.begin(), tree.end(), loaded.begin(), loaded.end()));
+    CHECK(!loaded.contains(-5));
+
+    RedBlackTree<int, double> empty;
+    CHECK(empty.save(path.string()));
+    CHECK(loaded.load(path.string()) && loaded.getTotalSize() == 0 && loaded.getReservedBytes() == 0);
+
+    // Entries that are not in key order are rejected even with a matching
+    // checksum, so only damaged bytes are tried here.
+    CHECK(tree.save(path.string()));
+    loaded.insert(1, 1.0);
+    const std::size_t reserved = loaded.getReservedBytes();
+    const std::uintmax_t size = std::filesystem::file_size(path);
+    const unsigned char flipped = 0x5A;
+    patch((std::streamoff)size / 2, &flipped, 1);
+    CHECK(!loaded.load(path.string()));
+    CHECK(loaded.getTotalSize() == 1 && loaded.contains(1) && loaded.isValid());
+    CHECK(loaded.getReservedBytes() == reserved);
+
+    CHECK(tree.save(path.string()));
+    const std::uint32_t version = 2;
+    patch(4, &version, sizeof(version));
+    CHECK(!loaded.load(path.string()));
+
+    CHECK(tree.save(path.string()));
+    std::filesystem::resize_file(path, size - 1);
+    CHECK(!loaded.load(path.string()));
+    CHECK(!loaded.load((path.string() + ".missing")));
+    CHECK(loaded.getTotalSize() == 1 && loaded.contains(1));
+
+    std::filesystem::remove(path);
+}
+
+int main()
+{
+    testIndexedTree();
+    testMixedSignedness();
+    testIterators();
+    testOrderedLookups();
+    testOrderStatistics();
+    testAugmentSummaries();
+    testAssignSorted();
+    testApplyBatch();
+    testApplyBatchThrowing();
+    testSizeAfterSplit();
+    testSplitJoin();
+    testSetOperations();
+    testTaskGroupUnwinding();
+    testHintedInsert();
+    testShardedRoutingReclaimed();
+    testShardedRebalance();
+    testPersistentSnapshots();
+    testParallelTraversal();
+    testParallelFilterAssign();
+    testFrozen();
+    testSearchBatch();
+    testSaveLoad();
+
+    if(failures > 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}